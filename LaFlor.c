@@ -6,11 +6,181 @@
 #include <windows.h>
 
 #include <shellapi.h>
-#include <shlwapi.h>
+#include <shlobj.h>
 
 #include <assert.h>
 #include <stdbool.h>
-#include <wchar.h>
+
+#include "activity.h"
+#include "backoff.h"
+#include "config.h"
+#include "control.h"
+#include "format.h"
+#include "idletimeout.h"
+#include "layout.h"
+#include "motion.h"
+#include "pathgen.h"
+#include "scheduler.h"
+#include "script.h"
+#include "telemetry.h"
+#include "timerwheel.h"
+#include "trace.h"
+
+#include <wtsapi32.h>
+
+/* the high-resolution flag for CreateWaitableTimerExW() is only defined by
+ * the newer SDKs, and only understood by Windows 10 1803 and newer. */
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+/* not defined by the older SDKs when targeting XP, even though XP supports
+ * it. */
+#ifndef MOUSEEVENTF_VIRTUALDESK
+#define MOUSEEVENTF_VIRTUALDESK 0x4000
+#endif
+
+/* the power setting notifications only exist since Vista, so none of this is
+ * declared when targeting XP. the functions themselves are looked up at
+ * runtime : see registerDisplayNotification(). */
+#ifndef PBT_POWERSETTINGCHANGE
+#define PBT_POWERSETTINGCHANGE 0x8013
+#endif
+#ifndef DEVICE_NOTIFY_WINDOW_HANDLE
+#define DEVICE_NOTIFY_WINDOW_HANDLE 0
+#endif
+
+/* the layout of POWERBROADCAST_SETTING, for the display state settings, whose
+ * data is always a single DWORD : 0 when the display is off, 1 when it's on
+ * and 2 when it's dimmed. */
+struct DisplayStateSetting {
+  GUID powerSetting;
+  DWORD dataLength;
+  DWORD data;
+};
+
+/* GUID_CONSOLE_DISPLAY_STATE, since Windows 8, and GUID_MONITOR_POWER_ON,
+ * since Vista. the former reports the state of the display attached to the
+ * session, while the latter reports the state of any monitor. */
+static const GUID ConsoleDisplayStateGuid = {
+    0x6fe69556,
+    0x704a,
+    0x47a0,
+    {0x8f, 0x24, 0xc2, 0x8d, 0x93, 0x6f, 0xda, 0x47}};
+static const GUID MonitorPowerOnGuid = {
+    0x02731015,
+    0x4510,
+    0x4526,
+    {0x99, 0xe6, 0xe5, 0xa1, 0x7e, 0xbd, 0x1a, 0xea}};
+
+/* GUID_VIDEO_POWERDOWN_TIMEOUT, GUID_STANDBY_TIMEOUT and
+ * GUID_ACTIVE_POWERSCHEME : the power plan settings which the idle timeouts
+ * come from, and the power plan itself. see readIdleTimeouts(). */
+static const GUID VideoPowerdownTimeoutGuid = {
+    0x3c0bc021,
+    0xc8a8,
+    0x4e07,
+    {0xa9, 0x73, 0x6b, 0x14, 0xcb, 0xcb, 0x2b, 0x7e}};
+static const GUID StandbyTimeoutGuid = {
+    0x29f6c1db,
+    0x86da,
+    0x48c5,
+    {0x9f, 0xdb, 0xf2, 0xb6, 0x7b, 0x1f, 0x44, 0xda}};
+static const GUID ActivePowerSchemeGuid = {
+    0x31f9f286,
+    0x5084,
+    0x42fe,
+    {0xb7, 0x20, 0x2b, 0x02, 0x64, 0x99, 0x37, 0x63}};
+
+/* power requests only exist since Windows 7, so none of this is declared when
+ * targeting XP. this is the layout of REASON_CONTEXT, whose union is as large
+ * as its "detailed" variant, even though only the simple string is ever used
+ * here. see updatePowerRequest(). */
+struct ReasonContext {
+  ULONG version;
+  DWORD flags;
+  union {
+    struct {
+      HMODULE module;
+      ULONG resourceId;
+      ULONG stringCount;
+      wchar_t **strings;
+    } detailed;
+    const wchar_t *simpleString;
+  } reason;
+};
+#ifndef POWER_REQUEST_CONTEXT_VERSION
+#define POWER_REQUEST_CONTEXT_VERSION 0
+#endif
+#ifndef POWER_REQUEST_CONTEXT_SIMPLE_STRING
+#define POWER_REQUEST_CONTEXT_SIMPLE_STRING 0x1
+#endif
+/* the values of POWER_REQUEST_TYPE. */
+#define POWER_REQUEST_DISPLAY_REQUIRED 0
+#define POWER_REQUEST_SYSTEM_REQUIRED 1
+typedef HANDLE(WINAPI *PowerCreateRequestFn)(struct ReasonContext *);
+typedef BOOL(WINAPI *PowerRequestFn)(HANDLE, int);
+
+/* PROCESS_QUERY_LIMITED_INFORMATION and QueryFullProcessImageNameW() only
+ * exist since Vista : see isWatchedProcess(). */
+#ifndef PROCESS_QUERY_LIMITED_INFORMATION
+#define PROCESS_QUERY_LIMITED_INFORMATION 0x1000
+#endif
+typedef BOOL(WINAPI *QueryFullProcessImageNameFn)(HANDLE, DWORD, wchar_t *,
+                                                  DWORD *);
+
+/* CallNtPowerInformation() lives in powrprof.dll, which La Flor doesn't link
+ * to, since it only needs it once in a while : see readIdleTimeouts(). */
+typedef LONG(WINAPI *CallNtPowerInformationFn)(POWER_INFORMATION_LEVEL,
+                                               void *, ULONG, void *, ULONG);
+
+/* SetWaitableTimerEx() only exists since Windows 7 : see initTickWorker(). */
+typedef BOOL(WINAPI *SetWaitableTimerExFn)(HANDLE, const LARGE_INTEGER *, LONG,
+                                           PTIMERAPCROUTINE, LPVOID, void *,
+                                           ULONG);
+
+/* background mode : see updateBackground(). a thread can lower its own I/O
+ * and memory priority since Vista, which XP just refuses. */
+#ifndef THREAD_MODE_BACKGROUND_BEGIN
+#define THREAD_MODE_BACKGROUND_BEGIN 0x00010000
+#endif
+#ifndef THREAD_MODE_BACKGROUND_END
+#define THREAD_MODE_BACKGROUND_END 0x00020000
+#endif
+/* SetProcessInformation() and SetThreadInformation() only exist since Windows
+ * 8, and power throttling, which Windows 11 calls EcoQoS, since Windows 10
+ * 1709 : none of this is declared when targeting XP. these are the values of
+ * PROCESS_INFORMATION_CLASS and THREAD_INFORMATION_CLASS which are used, and
+ * the layout shared by PROCESS_POWER_THROTTLING_STATE and
+ * THREAD_POWER_THROTTLING_STATE. a "controlMask" of 0 leaves it up to the
+ * system again. */
+#define PROCESS_INFO_MEMORY_PRIORITY 0
+#define PROCESS_INFO_POWER_THROTTLING 4
+#define THREAD_INFO_MEMORY_PRIORITY 0
+#define THREAD_INFO_POWER_THROTTLING 3
+#ifndef MEMORY_PRIORITY_LOW
+#define MEMORY_PRIORITY_LOW 2
+#endif
+#ifndef MEMORY_PRIORITY_NORMAL
+#define MEMORY_PRIORITY_NORMAL 5
+#endif
+struct PowerThrottlingState {
+  ULONG version;
+  ULONG controlMask;
+  ULONG stateMask;
+};
+#define POWER_THROTTLING_VERSION 1
+#define POWER_THROTTLING_EXECUTION_SPEED 0x1
+typedef BOOL(WINAPI *SetProcessInformationFn)(HANDLE, int, void *, DWORD);
+typedef BOOL(WINAPI *SetThreadInformationFn)(HANDLE, int, void *, DWORD);
+
+/* the default for how late the system may fire the tick timer, in order to
+ * coalesce its expiration with other timers. see armTickTimer(). */
+#define DEFAULT_TIMER_TOLERANCE_MS 50
+
+/* the slots of the injection thread's timer wheel, at the lowest level, are a
+ * millisecond wide. the deadlines themselves are exact : see timerwheel.h. */
+#define WHEEL_RESOLUTION_US 1000
 
 /* define for the custom message that's sent when some user input is directed at
  * our application's notification icon. since the message identifier namespace
@@ -19,6 +189,27 @@
  * 0xBFFF. */
 #define NOTIFYICON_ID WM_APP
 
+/* sent by the control pipe thread, with a pointer to the ControlRequest to be
+ * handled by the UI thread as lParam. */
+#define WM_CONTROL_REQUEST (WM_APP + 1)
+
+/* posted by the configuration file watcher whenever something changed in the
+ * file's directory. see startConfigWatcher(). */
+#define WM_CONFIG_CHANGED (WM_APP + 2)
+
+/* posted by the injection thread whenever its input stops getting through, or
+ * gets through again, so that the tooltip can say so. */
+#define WM_INJECTION_CHANGED (WM_APP + 3)
+
+/* the timers of the UI thread. the settings are saved SAVE_DELAY_MS after the
+ * last change, so that a burst of changes only leads to a single write, and
+ * the configuration file is reloaded RELOAD_DELAY_MS after the last change
+ * notification, so that it's not read while it's still being written. */
+#define TIMER_SAVE 1
+#define TIMER_RELOAD 2
+#define SAVE_DELAY_MS 2000
+#define RELOAD_DELAY_MS 250
+
 /* command identifiers for menu items. the IDM_ prefix is customary, since the
  * Resource Compiler uses them when defining resource-based menus. this
  * convention is preserved here for readability. */
@@ -29,9 +220,14 @@
  * the number of entires in respective arrays : therefore, a pair of _START and
  * _END defines is created for each of these instead of a hardcoded set. */
 #define IDM_INTERVAL_START 3
-static const int predefIntervals[] = {1000, 5000, 10000, 30000, 60000};
+static const int predefIntervals[] = {250,   500,   1000, 5000,
+                                      10000, 30000, 60000};
+#define DEFAULT_INTERVAL 1000
 #define IDM_INTERVAL_END (IDM_INTERVAL_START + ARRAYSIZE(predefIntervals))
 #define IDM_INTERVAL_CUSTOM IDM_INTERVAL_END
+/* the interval is worked out from the system's idle timeouts instead : see
+ * updateAutoInterval(). */
+#define IDM_INTERVAL_AUTO (IDM_INTERVAL_CUSTOM + 1)
 
 #define SEEK_PREDEF_MACRO(arr, val)                                            \
   for (int i__ = 0; i__ < ARRAYSIZE(arr); ++i__) {                             \
@@ -45,28 +241,345 @@ static int seekPredefInterval(int val) {
   SEEK_PREDEF_MACRO(predefIntervals, val);
 }
 
-#define IDM_DELTA_START (IDM_INTERVAL_CUSTOM + 1)
+#define IDM_DELTA_START (IDM_INTERVAL_AUTO + 1)
 static const int predefDeltas[] = {1, 5, 10, 30, 60};
 #define IDM_DELTA_END (IDM_DELTA_START + ARRAYSIZE(predefDeltas))
 #define IDM_DELTA_CUSTOM IDM_DELTA_END
 
 static int seekPredefDelta(int val) { SEEK_PREDEF_MACRO(predefDeltas, val); }
 
-/* the timer ID of the main timer that's created when a timer is associated with
- * the application's main (and only) window handle. */
-#define TIMER_EVENT_ID 1
+#define IDM_PRECISE (IDM_DELTA_CUSTOM + 1)
+#define IDM_STATS (IDM_PRECISE + 1)
+#define IDM_PAUSE_WHILE_ACTIVE (IDM_STATS + 1)
+#define IDM_SMOOTH (IDM_PAUSE_WHILE_ACTIVE + 1)
+#define IDM_ABSOLUTE (IDM_SMOOTH + 1)
+#define IDM_WAKEUPS (IDM_ABSOLUTE + 1)
+#define IDM_RECORD (IDM_WAKEUPS + 1)
+#define IDM_REPLAY (IDM_RECORD + 1)
+/* the first item of the pattern submenu is the plain bouncing done by the
+ * motion engine, the following ones are the patterns of the path generator,
+ * in the order of enum PathPattern, and the last one runs the motion script. */
+#define PATTERN_SCRIPT (1 + PATHGEN_PATTERN_COUNT)
+#define IDM_PATTERN_START (IDM_REPLAY + 1)
+#define IDM_PATTERN_END (IDM_PATTERN_START + 1 + PATTERN_SCRIPT)
+#define IDM_KEEP_AWAKE IDM_PATTERN_END
+#define IDM_BACKGROUND (IDM_KEEP_AWAKE + 1)
+
+static const wchar_t *const patternLabels[] = {
+    L"Bounce", L"Hand strokes", L"Noisy arcs", L"Sweeping curve", L"Script"};
+
+/* how many pixels the box that the path generator's patterns are drawn in
+ * spans on each side of its center, for every pixel of delta. */
+#define PATTERN_SCALE_PER_DELTA 10
+
+/* the positions of the items in the top-level menu which open submenus, as
+ * such items don't have an ID of their own. */
+#define MENU_POS_INTERVAL 2
+#define MENU_POS_DELTA 3
+
+/* the name of the file mapping which the telemetry is exported through, i.e.
+ * TELEMETRY_NAME in the session's namespace. this is where
+ * tools/LaFlorStats.c looks for it by default. */
+static const wchar_t TelemetryMappingName[] = L"Local\\LaFlorTelemetry";
+
+/* the mutex which tells whether La Flor is already running in this session.
+ * the name of the control pipe is built by controlPipeName(). */
+static const wchar_t InstanceMutexName[] = L"Local\\LaFlorInstance";
+
+/* the class of the root window, which is also how the hook procedures find
+ * it. */
+static const wchar_t RootWindowClass[] = CONTROL_WINDOW_CLASS;
+
+/* how long the control pipe waits for a client to send its commands or read
+ * the response, and how long a client waits for the pipe to become free. */
+#define CONTROL_CLIENT_TIMEOUT_MS 2000
+
+/* everything that the Windows motion backend needs in order to inject input :
+ * preallocated input records for smooth moves, which are sent to the system
+ * with a single SendInput() call, and the bounds of the virtual screen, which
+ * absolute coordinates are normalized against. the number of records passed
+ * to the last SendInput() call and its return value are kept for telemetry. */
+struct Win32Injector {
+  INPUT inputs[MOTION_MAX_PATH_STEPS];
+  struct ScreenRect virtualScreen;
+  UINT lastRequested;
+  UINT lastSent;
+};
+
+/* the settings that the UI thread publishes for the injection thread. the UI
+ * thread only ever stores new values and signals the worker's wake event,
+ * while the worker picks them up in applySettings() : neither of them ever
+ * waits for the other one. see atomicLoad() and atomicStore(). */
+struct SharedSettings {
+  volatile LONG interval;
+  volatile LONG delta;
+  volatile LONG enabled;
+  volatile LONG precise;
+  volatile LONG pauseWhileActive;
+  volatile LONG smooth;
+  volatile LONG absolute;
+  volatile LONG reconcileEvery;
+  volatile LONG timerToleranceMs;
+  volatile LONG scrollEvery;
+  volatile LONG spread;
+  /* nonzero once the process has gone into background mode : see
+   * updateBackground(). */
+  volatile LONG background;
+  /* nonzero while ticking would be pointless : see setParked(). this is
+   * separate from "enabled", which is the user's choice. */
+  volatile LONG parked;
+  volatile LONG replay;
+  /* 0 for bouncing, 1 + an enum PathPattern, or PATTERN_SCRIPT. */
+  volatile LONG pattern;
+  /* set once a new trace has been recorded : see commitRecordedTrace(). */
+  volatile LONG traceRecorded;
+  volatile LONG layoutChanged;
+  volatile LONG quit;
+};
+
+/* the statistics that the injection thread publishes for the menu. */
+struct WorkerStats {
+  struct TickStats ticks;
+  unsigned long skippedTicks;
+  /* the number of times that the injection thread woke up, for any reason,
+   * since it was started at "startUs". */
+  unsigned long wakeups;
+  /* the number of ticks whose input didn't get through, and whether the last
+   * one's did : see struct InjectionBackoff. */
+  unsigned long failedTicks;
+  bool injectionBlocked;
+};
+
+/* "seq" is the sequence number of a seqlock : see publishStats() and
+ * readStats(). */
+struct SharedStats {
+  volatile LONG seq;
+  struct WorkerStats data;
+};
+
+/* the injection thread and everything that it owns. the thread has its own
+ * wait loop, so ticks keep coming on time no matter what the UI thread is
+ * busy with : the modal loops run by TrackPopupMenuEx() and
+ * DialogBoxIndirectW(), the shell being slow to answer Shell_NotifyIconW(),
+ * or anything else.
+ *
+ * apart from the two shared structs and the handles, which are created before
+ * the thread is started, all the members are only ever touched by the
+ * injection thread itself. */
+struct TickWorker {
+  HANDLE thread;
+  /* an auto-reset event signaled by the UI thread whenever it has published
+   * new settings. */
+  HANDLE wakeEvent;
+  /* the waitable timer used for ticking in precise mode, and for coalescable
+   * ticks outside of it. this is 0 if no waitable timer could be created. */
+  HANDLE tickTimer;
+  bool highResTimer;
+  /* 0 if the system doesn't support coalescable timers. */
+  SetWaitableTimerExFn setWaitableTimerEx;
+  /* 0 before Windows 8. */
+  SetThreadInformationFn setThreadInformation;
+  /* in background mode, the thread is "urgent" while it waits for the next
+   * action and while it runs it, and only then : see setWorkerUrgent(). */
+  bool background;
+  bool urgent;
+  long long qpcFrequency;
+  long long startUs;
+  struct SharedSettings settings;
+  struct SharedStats stats;
+
+  /* every periodic action of the thread is a timer of "wheel", and the thread
+   * only ever waits for the earliest one, whatever the number of actions :
+   * the ticks, which follow "scheduler", and the scroll nudges, every
+   * "scrollEvery" seconds if that's not 0. */
+  struct TimerWheel wheel;
+  struct WheelTimer tickAction;
+  struct WheelTimer scrollAction;
+  int scrollEvery;
+  struct TickScheduler scheduler;
+  int interval;
+  /* the ticks of the instances in the other sessions are spread over the
+   * interval, with the session ID telling them apart : see
+   * schedulerSetSpread(). */
+  DWORD sessionId;
+  struct MotionBackend motionBackend;
+  /* the monitor layout is cached here and only rebuilt when the system tells
+   * us that something's changed, instead of being queried on every tick. */
+  struct ScreenLayout layout;
+  struct MotionState motion;
+  struct Win32Injector injector;
+  struct InjectionBackoff backoff;
+  /* set by onTick() when injection stops or starts working again : the UI
+   * thread is told about it once the new stats are published. */
+  bool injectionChanged;
+  /* the window which WM_INJECTION_CHANGED is posted to. */
+  HWND notifyWnd;
+  struct ActivityTracker activity;
+  /* the telemetry ring lives in a named file mapping, which other processes
+   * can map as well in order to read the records straight from it : see
+   * tools/LaFlorStats.c. "telemetry.header" is 0 if the mapping couldn't be
+   * created. */
+  HANDLE telemetryMapping;
+  struct TelemetryRing telemetry;
+  /* the paths of the trace that's replayed, and of the one being recorded.
+   * they're set up before the thread is started, and empty if there's nowhere
+   * to keep a trace. "traceMapping" is 0 unless a trace is being replayed. */
+  wchar_t tracePath[MAX_PATH];
+  wchar_t recordPath[MAX_PATH];
+  HANDLE traceMapping;
+  const void *traceView;
+  struct TraceReader trace;
+  /* "pattern" is 0 when bouncing, in which case "pathgen" is unused. the
+   * script is compiled whenever PATTERN_SCRIPT gets selected, from the file
+   * at "scriptPath" : "scriptLoaded" is false if that didn't work out, in
+   * which case the cursor just keeps bouncing. */
+  int pattern;
+  struct PathGen pathgen;
+  wchar_t scriptPath[MAX_PATH];
+  bool scriptLoaded;
+  struct ScriptProgram scriptProgram;
+  struct ScriptVm script;
+  unsigned long wakeups;
+  unsigned long timerToleranceMs;
+  bool ticking;
+  bool precise;
+  /* true when ticking outside of precise mode with a coalescable timer,
+   * instead of with the timeout of the wait. */
+  bool coalesce;
+  bool pauseWhileActive;
+};
+
+/* a dialog template, built in memory. DLGTEMPLATEEX needs to be DWORD-aligned,
+ * hence the type of the buffer. */
+struct DialogTemplate {
+  DWORD data[256];
+};
+
+/* a batch of commands received through the control pipe. the UI thread runs
+ * it and fills in the response. */
+struct ControlRequest {
+  char text[CONTROL_MAX_MESSAGE];
+  DWORD textLen;
+  char response[CONTROL_MAX_MESSAGE];
+  int responseLen;
+};
+
+/* the control plane : a named pipe through which other processes, most notably
+ * other instances of La Flor started with command line arguments, can change
+ * the settings. the pipe is served by a thread of its own, so that neither
+ * the UI thread nor the injection thread ever wait on a client. */
+struct ControlServer {
+  HANDLE thread;
+  HANDLE stopEvent;
+  HANDLE pipe;
+  HWND wnd;
+  struct ControlRequest request;
+};
+
+/* the thread which watches the directory of the configuration file, and
+ * "change", the change notification handle which it waits on. */
+struct ConfigWatcher {
+  HANDLE thread;
+  HANDLE stopEvent;
+  HANDLE change;
+  HWND wnd;
+};
+
+/* the reasons for which the ticks can be parked. injected input does nothing
+ * useful in any of these states, so the ticks are stopped entirely rather than
+ * waking the processor up for nothing. */
+#define PARK_LOCKED 0x1
+#define PARK_DISCONNECTED 0x2
+#define PARK_DISPLAY_OFF 0x4
+#define PARK_SUSPENDED 0x8
+/* in keep-awake mode, the ticks are parked unless one of the watched
+ * applications is in the foreground : see updateKeepAwake(). */
+#define PARK_KEEP_AWAKE 0x10
 
 /* the main application state struct that's associated with the given window
- * handle. */
+ * handle. the settings here are the UI thread's own copy, which the menu is
+ * built from and which is saved to the registry, or to the configuration
+ * file.
+ *
+ * the menu and the dialog templates are only built once, at startup : see
+ * createMenu() and buildInputDialogs(). */
 struct AppState {
   HINSTANCE app;
   HWND wnd;
-  UINT_PTR timerId;
+  struct TickWorker worker;
+  struct ControlServer control;
+  /* the configuration file which the settings are kept in instead of the
+   * registry, if any, and the settings as they were last read from or written
+   * to wherever they're kept. */
+  wchar_t configPath[MAX_PATH];
+  struct ConfigWatcher configWatcher;
+  struct ConfigValues saved;
+  HMENU menu;
+  HMENU intervalMenu;
+  HMENU deltaMenu;
+#ifndef NDEBUG
+  /* the performance counter value when the menu was requested, for measuring
+   * how long it takes to show up. this is only done in debug builds. */
+  long long menuRequestQpc;
+#endif
+  struct DialogTemplate intervalDialog;
+  struct DialogTemplate deltaDialog;
   int interval;
   int delta;
-  int currentDeltaX;
-  int currentDeltaY;
+  int pattern;
+  /* when "autoInterval" is set, the ticks come every "autoIntervalMs" instead
+   * of every "interval", which is just the longest that still beats all of
+   * "idleTimeouts". "appTimeout" is the one of those which the user declares
+   * themselves, in seconds, and 0 when there's none. */
+  bool autoInterval;
+  int autoIntervalMs;
+  int appTimeout;
+  struct IdleTimeouts idleTimeouts;
+  int reconcileEvery;
+  int timerToleranceMs;
+  int scrollEvery;
+  bool spreadTicks;
+  /* background mode, which "inBackground" tells whether the process is in :
+   * it only goes there once it's "running", and "priorityClass" is what it
+   * goes back to. "setProcessInformation" is 0 before Windows 8. */
+  bool background;
+  bool inBackground;
+  bool running;
+  DWORD priorityClass;
+  SetProcessInformationFn setProcessInformation;
+  /* the reasons for which the ticks are currently parked : see setParked(). */
+  unsigned parkReasons;
+  /* returned by RegisterPowerSettingNotification(), if it exists, for the
+   * display state, and for the power plan settings which the idle timeouts
+   * come from. */
+  void *displayNotification;
+  void *planNotifications[3];
+  /* keep-awake mode : the display and the system are kept on with a power
+   * request, or with SetThreadExecutionState() before Windows 7, and input is
+   * only injected while one of the applications of "watchedApps", a list of
+   * executable names separated with semicolons, is in the foreground. which
+   * application that is only gets checked when the foreground window
+   * changes. */
+  bool keepAwake;
+  bool awakeHeld;
+  HANDLE powerRequest;
+  wchar_t watchedApps[256];
+  HWINEVENTHOOK foregroundHook;
+  DWORD foregroundPid;
+  bool watchedForeground;
+  /* what the tooltip currently says about injection : see updateTooltip(). */
+  unsigned long tooltipFailedTicks;
+  bool tooltipBlocked;
+  /* the file that the user's own mouse movement is being recorded into, or 0
+   * when not recording. */
+  HANDLE recordFile;
+  struct TraceWriter recorder;
+  bool replay;
   bool active;
+  bool precise;
+  bool pauseWhileActive;
+  bool smooth;
+  bool absolute;
   bool inputDialogActive;
 };
 
@@ -104,226 +617,1318 @@ static void changeNotificationIcon(HINSTANCE app, HWND wnd, bool active) {
   Shell_NotifyIconW(NIM_MODIFY, &data);
 }
 
-static void getNewDelta(struct AppState *state, int newval, int maxval,
-                        int *delta) {
-  const int wantedDelta = state->delta;
-  if (newval >= maxval) {
-    *delta = (-1 * wantedDelta);
-  } else if (newval <= 0) {
-    *delta = wantedDelta;
+static void win32GetCursorPos(void *ctx, int *x, int *y) {
+  POINT p;
+  GetCursorPos(&p);
+  *x = p.x;
+  *y = p.y;
+}
+
+static void win32SendMove(void *ctx, int dx, int dy) {
+  /* just synthesize user input moving the mouse by the given number of
+   * pixels. */
+  struct Win32Injector *injector = ctx;
+  INPUT inp;
+  memset(&inp, 0, sizeof(inp));
+  inp.type = INPUT_MOUSE;
+  inp.mi.dx = dx;
+  inp.mi.dy = dy;
+  inp.mi.dwFlags = MOUSEEVENTF_MOVE;
+  injector->lastRequested = 1;
+  injector->lastSent = SendInput(1, &inp, sizeof(inp));
+}
+
+static void win32SendPath(void *ctx, const struct MotionStep *steps,
+                          int count) {
+  /* SendInput() accepts an array of input records, and inserts all of them
+   * into the input stream in one go : this costs a single transition into
+   * kernel mode regardless of the number of records. the records were already
+   * initialized in initInjector(), so only the deltas and flags need to be
+   * filled in here.
+   *
+   * note that every step is a separate relative move, so each one is subject
+   * to pointer acceleration on its own : with "Enhance pointer precision"
+   * enabled, the total distance might not be exactly the same as when the whole
+   * move is made at once. */
+  struct Win32Injector *injector = ctx;
+  INPUT *inputs = injector->inputs;
+  for (int i = 0; i < count; ++i) {
+    inputs[i].mi.dx = steps[i].dx;
+    inputs[i].mi.dy = steps[i].dy;
+    inputs[i].mi.dwFlags = MOUSEEVENTF_MOVE;
   }
+  injector->lastRequested = count;
+  injector->lastSent = SendInput(count, inputs, sizeof(*inputs));
 }
 
-static void getNewDeltas(struct AppState *state) {
-  POINT p;
-  GetCursorPos(&p);
-  const int newx = p.x + state->currentDeltaX;
-  const int newy = p.y + state->currentDeltaY;
+static LONG normalizeCoordinate(int value, int origin, int size) {
+  /* absolute coordinates are given in the range of 0 to 65535 across the whole
+   * virtual screen, and the system maps them back to pixels as
+   * (normalized * size) / 65536, rounding down. rounding up here is what makes
+   * this map back to exactly the pixel that we asked for. */
+  return (LONG)(((long long)(value - origin) * 65536 + size - 1) / size);
+}
 
-  const int width = GetSystemMetrics(SM_CXVIRTUALSCREEN);
-  const int height = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+static void setAbsoluteInput(const struct Win32Injector *injector, INPUT *inp,
+                             int x, int y) {
+  const struct ScreenRect *screen = &injector->virtualScreen;
+  inp->mi.dx =
+      normalizeCoordinate(x, screen->left, screen->right - screen->left);
+  inp->mi.dy =
+      normalizeCoordinate(y, screen->top, screen->bottom - screen->top);
+  inp->mi.dwFlags =
+      MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK;
+}
 
-  getNewDelta(state, newx, width, &state->currentDeltaX);
-  getNewDelta(state, newy, height, &state->currentDeltaY);
+static void win32SendMoveTo(void *ctx, int x, int y) {
+  /* absolute moves are not subject to pointer acceleration, so the cursor
+   * lands exactly where we want it to. MOUSEEVENTF_VIRTUALDESK makes the
+   * coordinates span all monitors instead of just the primary one. */
+  struct Win32Injector *injector = ctx;
+  INPUT *inp = &injector->inputs[0];
+  setAbsoluteInput(injector, inp, x, y);
+  injector->lastRequested = 1;
+  injector->lastSent = SendInput(1, inp, sizeof(*inp));
 }
 
-static void setNewDelta(struct AppState *state, int wantedDelta) {
-  state->delta = wantedDelta;
-  if (state->currentDeltaX < 0) {
-    state->currentDeltaX = state->currentDeltaY = (-1 * wantedDelta);
+static void win32SendPathTo(void *ctx, int fromX, int fromY,
+                            const struct MotionStep *steps, int count) {
+  struct Win32Injector *injector = ctx;
+  INPUT *inputs = injector->inputs;
+  int x = fromX, y = fromY;
+  for (int i = 0; i < count; ++i) {
+    x += steps[i].dx;
+    y += steps[i].dy;
+    setAbsoluteInput(injector, &inputs[i], x, y);
+  }
+  injector->lastRequested = count;
+  injector->lastSent = SendInput(count, inputs, sizeof(*inputs));
+}
+
+static void win32SendWheel(void *ctx, int notches) {
+  struct Win32Injector *injector = ctx;
+  INPUT inp;
+  memset(&inp, 0, sizeof(inp));
+  inp.type = INPUT_MOUSE;
+  inp.mi.mouseData = (DWORD)(notches * WHEEL_DELTA);
+  inp.mi.dwFlags = MOUSEEVENTF_WHEEL;
+  injector->lastRequested = 1;
+  injector->lastSent = SendInput(1, &inp, sizeof(inp));
+}
+
+static void initInjector(struct Win32Injector *injector) {
+  memset(injector, 0, sizeof(*injector));
+  for (int i = 0; i < ARRAYSIZE(injector->inputs); ++i) {
+    injector->inputs[i].type = INPUT_MOUSE;
+    injector->inputs[i].mi.dwFlags = MOUSEEVENTF_MOVE;
+  }
+}
+
+static void initMotionBackend(struct MotionBackend *backend,
+                              struct Win32Injector *injector) {
+  /* the motion engine's view of the Windows API. the functions which inject
+   * input get the injector as their context. */
+  backend->ctx = injector;
+  backend->getCursorPos = win32GetCursorPos;
+  backend->sendMove = win32SendMove;
+  backend->sendPath = win32SendPath;
+  backend->sendMoveTo = win32SendMoveTo;
+  backend->sendPathTo = win32SendPathTo;
+  backend->sendWheel = win32SendWheel;
+}
+
+static BOOL CALLBACK addMonitorToLayout(HMONITOR monitor, HDC dc, LPRECT rect,
+                                        LPARAM param) {
+  /* when EnumDisplayMonitors() is called without a device context, the
+   * rectangle passed to the callback is the monitor's rectangle in virtual
+   * screen coordinates. returning FALSE stops the enumeration, which is what's
+   * needed once the layout is full. */
+  struct ScreenLayout *layout = (void *)param;
+  return layoutAddMonitor(layout, rect->left, rect->top, rect->right,
+                          rect->bottom);
+}
+
+static LONG atomicLoad(volatile LONG *ptr) {
+  /* aligned 32-bit reads and writes are atomic on their own, but the
+   * Interlocked functions also act as full memory barriers, for both the
+   * compiler and the CPU. a compare-exchange which never changes anything is
+   * the usual way of doing an atomic load with what's available on XP. */
+  return InterlockedCompareExchange(ptr, 0, 0);
+}
+
+static void atomicStore(volatile LONG *ptr, LONG val) {
+  InterlockedExchange(ptr, val);
+}
+
+static void rebuildScreenLayout(struct TickWorker *worker) {
+  struct ScreenRect *screen = &worker->injector.virtualScreen;
+  screen->left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+  screen->top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+  screen->right = screen->left + GetSystemMetrics(SM_CXVIRTUALSCREEN);
+  screen->bottom = screen->top + GetSystemMetrics(SM_CYVIRTUALSCREEN);
+
+  layoutInit(&worker->layout);
+  EnumDisplayMonitors(0, 0, addMonitorToLayout, (LPARAM)&worker->layout);
+  if (worker->layout.count == 0) {
+    /* this shouldn't ever happen, but if it does, the whole virtual screen is
+     * the next best thing. */
+    layoutAddMonitor(&worker->layout, screen->left, screen->top,
+                     screen->right, screen->bottom);
+  }
+  motionSetLayout(&worker->motion, &worker->layout);
+}
+
+static long long qpcNow(void) {
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return now.QuadPart;
+}
+
+static long long qpcToUs(const struct TickWorker *worker, long long qpc) {
+  /* split into whole seconds and the remainder, so that multiplying by a
+   * million doesn't overflow after the machine's been up for long enough. */
+  const long long secs = qpc / worker->qpcFrequency;
+  const long long rem = qpc % worker->qpcFrequency;
+  return secs * 1000000 + rem * 1000000 / worker->qpcFrequency;
+}
+
+static long long nowUs(const struct TickWorker *worker) {
+  return qpcToUs(worker, qpcNow());
+}
+
+static HANDLE createTickTimer(bool *highRes) {
+  /* CreateWaitableTimerExW() only exists since Vista, so it needs to be looked
+   * up at runtime in order not to prevent the whole program from loading on
+   * XP. on top of that, the high-resolution flag is only supported since
+   * Windows 10 1803, and older versions just fail with ERROR_INVALID_PARAMETER
+   * when it's passed : in both cases, we fall back to a plain waitable timer,
+   * which still fires at the standard timer resolution but never drifts, as
+   * each tick is scheduled in absolute time. */
+  typedef HANDLE(WINAPI * CreateWaitableTimerExWFn)(void *, LPCWSTR, DWORD,
+                                                    DWORD);
+  CreateWaitableTimerExWFn createEx = (CreateWaitableTimerExWFn)GetProcAddress(
+      GetModuleHandleW(L"kernel32.dll"), "CreateWaitableTimerExW");
+  if (createEx) {
+    HANDLE rv =
+        createEx(0, 0, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (rv) {
+      *highRes = true;
+      return rv;
+    }
+  }
+  *highRes = false;
+  return CreateWaitableTimerW(0, FALSE, 0);
+}
+
+/* the time left until the earliest action is due, never negative, or -1 if
+ * there's none. */
+static long long wakeupDelayUs(struct TickWorker *worker) {
+  const long long deadlineUs = wheelNextDeadlineUs(&worker->wheel);
+  if (deadlineUs < 0) {
+    return -1;
+  }
+  const long long delayUs = deadlineUs - nowUs(worker);
+  return delayUs > 0 ? delayUs : 0;
+}
+
+static void armTickTimer(struct TickWorker *worker) {
+  /* the due time is converted from the earliest absolute deadline of the
+   * wheel to a relative one (negative values, in 100ns units) right before
+   * arming the timer. an absolute due time for waitable timers is expressed in
+   * system time, which jumps around whenever the clock is adjusted, while
+   * relative due times are not affected by that. since the deadline itself is
+   * absolute, no drift is accumulated this way either. */
+  const long long delayUs = wakeupDelayUs(worker);
+  if (delayUs < 0) {
+    CancelWaitableTimer(worker->tickTimer);
+    return;
+  }
+  LARGE_INTEGER due;
+  due.QuadPart = -10 * delayUs;
+  if (due.QuadPart == 0) {
+    due.QuadPart = -1;
+  }
+  /* outside of precise mode, nobody cares about a tick being a bit late, so
+   * the system is allowed to delay it in order to fire it together with other
+   * timers, which saves the processor from waking up just for us. */
+  if (worker->coalesce) {
+    worker->setWaitableTimerEx(worker->tickTimer, &due, 0, 0, 0, 0,
+                               worker->timerToleranceMs);
   } else {
-    state->currentDeltaX = state->currentDeltaY = wantedDelta;
+    SetWaitableTimer(worker->tickTimer, &due, 0, 0, 0, FALSE);
+  }
+}
+
+/* whether ticks come from the tick timer rather than from the timeout of the
+ * wait. */
+static bool timerDriven(const struct TickWorker *worker) {
+  return worker->precise || worker->coalesce;
+}
+
+static DWORD waitTimeoutMs(struct TickWorker *worker) {
+  /* outside of precise mode, ticks are timed by the timeout of the wait
+   * itself, which has the same resolution as SetTimer(). the delay is rounded
+   * up, so that the wait never ends before the deadline. */
+  if (!worker->ticking || timerDriven(worker)) {
+    return INFINITE;
   }
-  getNewDeltas(state);
+  const long long delayUs = wakeupDelayUs(worker);
+  return delayUs < 0 ? INFINITE : (DWORD)((delayUs + 999) / 1000);
 }
 
-static void setTimerEnabled(struct AppState *state, bool enabled) {
-  /* enable or disable the timer, according to the value of the "enabled"
-   * parameter. TimerProc is not used here, which means that the timer ticks
-   * will be sent to the main message loop as WM_TIMER messages and reach the
-   * window function, where the state struct pointer can be accessed via the
-   * associated window handle. */
-  setNewDelta(state, state->delta);
-  if (enabled) {
-    assert(state->timerId == 0);
-    state->timerId = SetTimer(state->wnd, TIMER_EVENT_ID, state->interval, 0);
+static void scheduleScroll(struct TickWorker *worker) {
+  if (worker->scrollEvery > 0) {
+    wheelSchedule(&worker->wheel, &worker->scrollAction,
+                  nowUs(worker) + worker->scrollEvery * 1000000LL);
   } else {
-    assert(state->timerId);
-    KillTimer(state->wnd, TIMER_EVENT_ID);
-    state->timerId = 0;
+    wheelCancel(&worker->wheel, &worker->scrollAction);
   }
 }
 
-static void restartTimer(struct AppState *state) {
-  assert(state->timerId);
-  state->timerId = SetTimer(state->wnd, TIMER_EVENT_ID, state->interval, 0);
+/* the timer isn't armed by any of these : applySettings() does it once,
+ * after everything that changed has been taken care of. */
+static void startTicking(struct TickWorker *worker) {
+  motionSetDelta(&worker->motion, worker->motion.delta);
+  backoffReset(&worker->backoff);
+  schedulerStart(&worker->scheduler, nowUs(worker), worker->interval * 1000LL);
+  wheelSchedule(&worker->wheel, &worker->tickAction,
+                worker->scheduler.nextDeadlineUs);
+  scheduleScroll(worker);
+  worker->ticking = true;
 }
 
-static void setNewInterval(struct AppState *state, int interval) {
-  state->interval = interval;
-  if (state->timerId) {
-    restartTimer(state);
+static void stopTicking(struct TickWorker *worker) {
+  if (timerDriven(worker)) {
+    CancelWaitableTimer(worker->tickTimer);
   }
+  wheelCancel(&worker->wheel, &worker->tickAction);
+  wheelCancel(&worker->wheel, &worker->scrollAction);
+  worker->ticking = false;
 }
 
-static void moveMouse(struct AppState *state) {
-  /* just synthesize user input moving the mouse by the given number of pixels :
-   * currentDelta{X,Y} are updated in order to bounce back by helper functions
-   * when reaching the horizontal/vertical end of the screen. */
-  INPUT inp;
-  memset(&inp, 0, sizeof(inp));
-  inp.type = INPUT_MOUSE;
-  inp.mi.dx = state->currentDeltaX;
-  inp.mi.dy = state->currentDeltaY;
-  inp.mi.dwFlags = MOUSEEVENTF_MOVE;
-  getNewDeltas(state);
-  SendInput(1, &inp, sizeof(inp));
+static void restartTicking(struct TickWorker *worker) {
+  assert(worker->ticking);
+  /* the phase is preserved here : the next tick happens one new interval
+   * after the previous one, and not one interval after the change, which
+   * would postpone the next tick every time that the interval is set from a
+   * script. */
+  schedulerSetPeriod(&worker->scheduler, nowUs(worker),
+                     worker->interval * 1000LL);
+  wheelSchedule(&worker->wheel, &worker->tickAction,
+                worker->scheduler.nextDeadlineUs);
 }
 
-static void commonAppendMenuItem(HMENU menu, int extraFlags,
-                                 UINT_PTR menuItemId, const wchar_t *label) {
-  AppendMenuW(menu, MF_STRING | extraFlags, menuItemId, label);
+static void openTrace(struct TickWorker *worker) {
+  /* the whole file is mapped, and checked once by traceReaderInit() : after
+   * that, replaying it never needs to read, parse or allocate anything. if
+   * there's no valid trace, the cursor just keeps bouncing. */
+  if (worker->tracePath[0] == 0) {
+    return;
+  }
+  HANDLE file = CreateFileW(worker->tracePath, GENERIC_READ, FILE_SHARE_READ,
+                            0, OPEN_EXISTING, 0, 0);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  /* the mapping keeps the file open by itself. */
+  const DWORD size = GetFileSize(file, 0);
+  HANDLE mapping = size == 0 || size == INVALID_FILE_SIZE
+                       ? 0
+                       : CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+  CloseHandle(file);
+  if (mapping == 0) {
+    return;
+  }
+  const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == 0 || !traceReaderInit(&worker->trace, view, size)) {
+    if (view) {
+      UnmapViewOfFile(view);
+    }
+    CloseHandle(mapping);
+    return;
+  }
+  worker->traceMapping = mapping;
+  worker->traceView = view;
 }
 
-static HMENU commonCreateMenu(const int *vals, int numVals, int extraFlags,
-                              int currentSelected, int idmStart,
-                              void (*formatFn)(wchar_t *, int, int)) {
-  HMENU rv = CreatePopupMenu();
-  for (int i = 0; i < numVals; ++i) {
-    wchar_t buf[256];
-    formatFn(buf, ARRAYSIZE(buf), vals[i]);
-    const int checkedFlag = (currentSelected == i) ? MF_CHECKED : MF_UNCHECKED;
-    commonAppendMenuItem(rv, extraFlags | checkedFlag, (UINT_PTR)idmStart + i,
-                         buf);
+static void closeTrace(struct TickWorker *worker) {
+  if (worker->traceMapping) {
+    UnmapViewOfFile(worker->traceView);
+    CloseHandle(worker->traceMapping);
+    worker->traceMapping = 0;
   }
-  const int checkedFlag = (currentSelected == -1) ? MF_CHECKED : MF_UNCHECKED;
-  commonAppendMenuItem(rv, checkedFlag, (UINT_PTR)idmStart + numVals,
-                       L"Custom...");
-  return rv;
 }
 
-static void intervalFormat(wchar_t *buf, int bufLen, int value) {
-  wnsprintfW(buf, bufLen, L"%d s", value / 1000);
+static void commitRecordedTrace(struct TickWorker *worker) {
+  /* a recording goes to a file of its own, which only replaces the replayed
+   * trace once it's complete. this is done by the injection thread, which
+   * owns the mapping of the old trace : the file can't be replaced while it's
+   * mapped. applySettings() maps the new trace right afterwards, if needed.
+   * if the trace can't be replaced, the old one stays, and so does the
+   * recording, under its own name, rather than being thrown away : that's
+   * reported to the debugger. */
+  closeTrace(worker);
+  if (!MoveFileExW(worker->recordPath, worker->tracePath,
+                   MOVEFILE_REPLACE_EXISTING)) {
+    wchar_t buf[MAX_PATH + 64];
+    formatW(buf, ARRAYSIZE(buf), L"La Flor : error %lu keeping %s\n",
+            GetLastError(), worker->recordPath);
+    OutputDebugStringW(buf);
+  }
 }
 
-static HMENU createIntervalsMenu(const struct AppState *state, int extraFlags) {
-  int selectedIntervalIdx = seekPredefInterval(state->interval);
-  return commonCreateMenu(predefIntervals, ARRAYSIZE(predefIntervals),
-                          extraFlags, selectedIntervalIdx, IDM_INTERVAL_START,
-                          intervalFormat);
+static void loadScript(struct TickWorker *worker) {
+  /* the script is compiled straight from the mapped file, once : running it
+   * afterwards only ever reads the bytecode. whatever is wrong with the
+   * script is reported to the debugger, with the line it's on. */
+  worker->scriptLoaded = false;
+  if (worker->scriptPath[0] == 0) {
+    return;
+  }
+  HANDLE file = CreateFileW(worker->scriptPath, GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+                            OPEN_EXISTING, 0, 0);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  const DWORD size = GetFileSize(file, 0);
+  HANDLE mapping = size == 0 || size > SCRIPT_MAX_SOURCE
+                       ? 0
+                       : CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+  CloseHandle(file);
+  if (mapping == 0) {
+    return;
+  }
+  const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view) {
+    struct ScriptError err;
+    worker->scriptLoaded =
+        scriptCompile(view, size, &worker->scriptProgram, &err);
+    if (!worker->scriptLoaded) {
+      wchar_t buf[128];
+      wchar_t message[64];
+      MultiByteToWideChar(CP_UTF8, 0, err.message, -1, message,
+                          ARRAYSIZE(message));
+      formatW(buf, ARRAYSIZE(buf), L"La Flor : script line %d : %s\n",
+              err.line, message);
+      OutputDebugStringW(buf);
+    }
+    UnmapViewOfFile(view);
+  }
+  CloseHandle(mapping);
+  if (worker->scriptLoaded) {
+    scriptInit(&worker->script, &worker->scriptProgram,
+               &worker->motionBackend, GetTickCount());
+  }
 }
 
-static void deltaFormat(wchar_t *buf, int bufLen, int value) {
-  wnsprintfW(buf, bufLen, L"%d px", value);
+static void applySettings(struct TickWorker *worker) {
+  /* every setting is re-read and compared against what the worker currently
+   * uses, so it doesn't matter how many changes were published before the
+   * worker got to see them : only the latest values count. */
+  struct SharedSettings *settings = &worker->settings;
+  struct MotionState *motion = &worker->motion;
+  if (InterlockedExchange(&settings->layoutChanged, 0)) {
+    rebuildScreenLayout(worker);
+  }
+  if (InterlockedExchange(&settings->traceRecorded, 0)) {
+    commitRecordedTrace(worker);
+  }
+  const bool replay = atomicLoad(&settings->replay);
+  if (replay && !worker->traceMapping) {
+    openTrace(worker);
+  } else if (!replay) {
+    closeTrace(worker);
+  }
+  /* the generator, or the script, starts over whenever the pattern
+   * changes. selecting the script again is what reloads it. */
+  const int pattern = atomicLoad(&settings->pattern);
+  if (pattern != worker->pattern) {
+    worker->pattern = pattern;
+    if (pattern == PATTERN_SCRIPT) {
+      loadScript(worker);
+    } else if (pattern) {
+      pathgenInit(&worker->pathgen, (enum PathPattern)(pattern - 1),
+                  GetTickCount());
+    }
+  }
+  const int delta = atomicLoad(&settings->delta);
+  if (delta != motion->delta) {
+    motionSetDelta(motion, delta);
+  }
+  const bool absolute = atomicLoad(&settings->absolute);
+  if (absolute != motion->absolute) {
+    motion->absolute = absolute;
+    motionInvalidatePosition(motion);
+  }
+  motion->smooth = atomicLoad(&settings->smooth);
+  motion->reconcileEvery = atomicLoad(&settings->reconcileEvery);
+  worker->pauseWhileActive = atomicLoad(&settings->pauseWhileActive);
+  /* a new tolerance is simply used the next time that the timer is armed,
+   * and spreading with the next deadline. */
+  worker->timerToleranceMs = atomicLoad(&settings->timerToleranceMs);
+  const bool spread = atomicLoad(&settings->spread);
+  if (spread != worker->scheduler.spread) {
+    schedulerSetSpread(&worker->scheduler, spread, worker->sessionId);
+  }
+  /* the thread's priority follows in tickWorkerMain(), once it's about to
+   * wait again. */
+  worker->background = atomicLoad(&settings->background);
+
+  const bool enabled =
+      atomicLoad(&settings->enabled) && !atomicLoad(&settings->parked);
+  const bool precise = atomicLoad(&settings->precise) && worker->tickTimer;
+  const bool coalesce = !precise && worker->timerToleranceMs > 0 &&
+                        worker->setWaitableTimerEx && worker->tickTimer;
+  const int interval = atomicLoad(&settings->interval);
+  const int scrollEvery = atomicLoad(&settings->scrollEvery);
+  if (worker->ticking && (!enabled || precise != worker->precise ||
+                          coalesce != worker->coalesce)) {
+    stopTicking(worker);
+  }
+  worker->precise = precise;
+  worker->coalesce = coalesce;
+  bool rearm = false;
+  if (!worker->ticking) {
+    worker->interval = interval;
+    worker->scrollEvery = scrollEvery;
+    if (enabled) {
+      startTicking(worker);
+      rearm = true;
+    }
+  } else {
+    if (interval != worker->interval) {
+      worker->interval = interval;
+      restartTicking(worker);
+      rearm = true;
+    }
+    if (scrollEvery != worker->scrollEvery) {
+      worker->scrollEvery = scrollEvery;
+      scheduleScroll(worker);
+      rearm = true;
+    }
+  }
+  /* outside of timer-driven mode, the wait timeout is computed from the new
+   * deadlines anyway. */
+  if (rearm && timerDriven(worker)) {
+    armTickTimer(worker);
+  }
 }
 
-static HMENU createDeltasMenu(const struct AppState *state, int extraFlags) {
-  int selectedDeltaIdx = seekPredefDelta(state->delta);
-  return commonCreateMenu(predefDeltas, ARRAYSIZE(predefDeltas), extraFlags,
-                          selectedDeltaIdx, IDM_DELTA_START, deltaFormat);
+static void publishStats(struct TickWorker *worker) {
+  /* the sequence number is odd while the stats are being written. the reader
+   * copies the stats and retries whenever the number was odd or changed in the
+   * meantime, which means that the worker never has to wait for the reader. */
+  struct SharedStats *stats = &worker->stats;
+  InterlockedIncrement(&stats->seq);
+  stats->data.ticks = worker->scheduler.stats;
+  stats->data.skippedTicks = worker->activity.skippedTicks;
+  stats->data.wakeups = worker->wakeups;
+  stats->data.failedTicks = worker->backoff.failedTicks;
+  stats->data.injectionBlocked = backoffBlocked(&worker->backoff);
+  InterlockedIncrement(&stats->seq);
 }
 
-static HMENU createMenu(const struct AppState *state) {
-  HMENU rv = CreatePopupMenu();
-  AppendMenuW(rv, (state->active ? MF_CHECKED : MF_UNCHECKED) | MF_STRING,
-              IDM_ENABLED, L"Enabled");
-  AppendMenuW(rv, MF_SEPARATOR, 0, 0);
+static void readStats(struct TickWorker *worker, struct WorkerStats *out) {
+  struct SharedStats *stats = &worker->stats;
+  for (;;) {
+    const LONG seq = atomicLoad(&stats->seq);
+    if ((seq & 1) == 0) {
+      *out = stats->data;
+      if (atomicLoad(&stats->seq) == seq) {
+        return;
+      }
+    }
+    /* the worker was preempted in the middle of writing : let it finish. */
+    SwitchToThread();
+  }
+}
 
-  /* the top-level menu takes ownership of submenus : see the comment around
-   * DestroyMenu() about that. */
-  const int grayFlag = state->active ? 0 : MF_GRAYED;
-  HMENU intervalSubmenu = createIntervalsMenu(state, grayFlag);
-  AppendMenuW(rv, MF_POPUP | MF_STRING | grayFlag, (UINT_PTR)intervalSubmenu,
-              L"Interval");
+static void replayTrace(struct TickWorker *worker) {
+  /* the records are decoded straight from the mapped file, and a whole
+   * segment is sent with a single SendInput() call, just like a smooth move.
+   * the motion engine's idea of where the cursor is doesn't hold anymore
+   * afterwards. */
+  struct MotionStep steps[MOTION_MAX_PATH_STEPS];
+  const int count = traceNextSegment(&worker->trace, worker->interval, steps,
+                                     MOTION_MAX_PATH_STEPS);
+  worker->motionBackend.sendPath(worker->motionBackend.ctx, steps, count);
+  motionInvalidatePosition(&worker->motion);
+}
 
-  HMENU deltaSubmenu = createDeltasMenu(state, grayFlag);
-  AppendMenuW(rv, MF_POPUP | MF_STRING | grayFlag, (UINT_PTR)deltaSubmenu,
-              L"Delta");
+static void followPattern(struct TickWorker *worker) {
+  /* a whole chunk of the pattern is generated, lazily, on every tick, and
+   * sent with a single SendInput() call. the pattern is drawn relative to
+   * where the cursor was when it started, and the motion engine's idea of
+   * where the cursor is doesn't hold anymore afterwards, just like when
+   * replaying a trace. */
+  struct MotionStep steps[PATHGEN_CHUNK];
+  pathgenSteps(&worker->pathgen,
+               (float)worker->motion.delta * PATTERN_SCALE_PER_DELTA, steps);
+  worker->motionBackend.sendPath(worker->motionBackend.ctx, steps,
+                                 PATHGEN_CHUNK);
+  motionInvalidatePosition(&worker->motion);
+}
 
-  AppendMenuW(rv, MF_SEPARATOR, 0, 0);
-  AppendMenuW(rv, MF_STRING, IDM_QUIT, L"Quit");
-  return rv;
+static long runScript(struct TickWorker *worker) {
+  /* the script sends its moves relative to where the cursor is, just like
+   * the patterns do. */
+  const long waitMs = scriptTick(&worker->script);
+  motionInvalidatePosition(&worker->motion);
+  return waitMs;
 }
 
-#define ID_EDIT 200
+static long moveMouse(struct TickWorker *worker) {
+  /* the actual bouncing logic lives in the platform-independent motion engine
+   * : currentDelta{X,Y} are updated in order to bounce back when reaching the
+   * horizontal/vertical end of the screen. returns how long until the next
+   * tick, if a script decided so, or -1 otherwise. */
+  if (worker->pauseWhileActive || worker->motion.absolute) {
+    activityOnInjected(&worker->activity, GetTickCount());
+  }
+  if (worker->traceMapping) {
+    replayTrace(worker);
+  } else if (worker->pattern == PATTERN_SCRIPT && worker->scriptLoaded) {
+    return runScript(worker);
+  } else if (worker->pattern && worker->pattern != PATTERN_SCRIPT) {
+    followPattern(worker);
+  } else {
+    motionTick(&worker->motion);
+  }
+  return -1;
+}
 
-static BOOL CALLBACK inputDialogProc(HWND hwndDlg, UINT message, WPARAM wParam,
-                                     LPARAM lParam) {
-  switch (message) {
-  case WM_COMMAND:
-    switch (LOWORD(wParam)) {
-    case IDOK: {
-      wchar_t valBuf[32];
-      GetDlgItemTextW(hwndDlg, ID_EDIT, valBuf, ARRAYSIZE(valBuf));
-      int value;
-      if (swscanf(valBuf, L"%d", &value) == 1 && value > 0) {
-        EndDialog(hwndDlg, value);
-      } else {
-        EndDialog(hwndDlg, -1);
-      }
-      return TRUE;
+static void checkForeignInput(struct TickWorker *worker) {
+  /* in absolute mode, the engine assumes that the cursor is still where it
+   * left it. if anybody else has generated any input since, this might not be
+   * true anymore, so the real position needs to be queried. */
+  LASTINPUTINFO info;
+  info.cbSize = sizeof(info);
+  if (!GetLastInputInfo(&info) ||
+      activityForeignInput(&worker->activity, info.dwTime)) {
+    motionInvalidatePosition(&worker->motion);
+  }
+}
+
+static uint32_t getActivityPostponeMs(struct TickWorker *worker) {
+  /* GetLastInputInfo() is cheap : it just returns a value that the system
+   * keeps updated anyway, and doesn't need any hooks to be installed. note
+   * that it reports the last input for the whole session, not only our
+   * application, which is exactly what's needed here. */
+  LASTINPUTINFO info;
+  info.cbSize = sizeof(info);
+  if (!GetLastInputInfo(&info)) {
+    return 0;
+  }
+  return activityPostponeMs(&worker->activity, GetTickCount(), info.dwTime,
+                            worker->interval);
+}
+
+static void recordTick(struct TickWorker *worker, long long scheduledUs,
+                       long long actualUs, long long startQpc, bool postponed,
+                       unsigned long long cursorQueries) {
+  /* recording a tick is just filling in a record in memory that's already
+   * mapped and publishing it, without any locks or system calls apart from
+   * reading the performance counter once more. */
+  if (worker->telemetry.header == 0) {
+    return;
+  }
+  const struct Win32Injector *injector = &worker->injector;
+  const struct MotionState *motion = &worker->motion;
+  struct TelemetryRecord *rec = telemetryNext(&worker->telemetry);
+  rec->scheduledUs = scheduledUs;
+  rec->actualUs = actualUs;
+  rec->requested = (uint16_t)injector->lastRequested;
+  rec->sent = (uint16_t)injector->lastSent;
+  rec->x = motion->x;
+  rec->y = motion->y;
+  rec->flags = (postponed ? TELEMETRY_POSTPONED : 0) |
+               (motion->cursorQueries != cursorQueries
+                    ? TELEMETRY_CURSOR_QUERIED
+                    : 0);
+  rec->reserved = 0;
+  rec->pathNs =
+      (uint32_t)((qpcNow() - startQpc) * 1000000000 / worker->qpcFrequency);
+  telemetryCommit(&worker->telemetry);
+}
+
+static long long checkInjection(struct TickWorker *worker) {
+  /* SendInput() returns the number of events which were actually inserted
+   * into the input stream : anything less than what was asked for means that
+   * the input was blocked, by UIPI or by a secure desktop, and the error code
+   * doesn't tell those apart. ticks which didn't inject anything, such as a
+   * script's waits, leave the back-off as it is. */
+  const struct Win32Injector *injector = &worker->injector;
+  if (injector->lastRequested == 0) {
+    return 0;
+  }
+  const bool wasBlocked = backoffBlocked(&worker->backoff);
+  const long long delayUs =
+      backoffOnTick(&worker->backoff,
+                    injector->lastSent == injector->lastRequested,
+                    worker->interval * 1000LL);
+  if (backoffBlocked(&worker->backoff) != wasBlocked) {
+    worker->injectionChanged = true;
+  }
+  return delayUs;
+}
+
+static void onTick(struct TickWorker *worker) {
+  /* the lateness of every tick is recorded in both modes. outside of precise
+   * mode, the next tick is always scheduled relative to the current one, just
+   * like SetTimer() does, so the scheduler is restarted from the current time
+   * in order to match. with phase spreading, this only brings the next tick
+   * back onto the grid, within a period of the current one.
+   *
+   * if the user is currently active, the tick is skipped and the timer is
+   * re-armed to fire when the user will have been idle for a whole interval,
+   * rather than polling on every interval until that happens. */
+  const long long startQpc = qpcNow();
+  const long long now = qpcToUs(worker, startQpc);
+  const long long scheduledUs = worker->scheduler.nextDeadlineUs;
+  const unsigned long long cursorQueries = worker->motion.cursorQueries;
+  worker->injector.lastRequested = worker->injector.lastSent = 0;
+  schedulerOnFire(&worker->scheduler, now);
+  const uint32_t postponeMs =
+      worker->pauseWhileActive ? getActivityPostponeMs(worker) : 0;
+  if (postponeMs) {
+    schedulerPostpone(&worker->scheduler, now, postponeMs * 1000LL);
+  } else if (!worker->precise) {
+    schedulerStart(&worker->scheduler, now, worker->interval * 1000LL);
+  }
+
+  if (!postponeMs) {
+    if (worker->motion.absolute) {
+      checkForeignInput(worker);
     }
-    case IDCANCEL:
-      EndDialog(hwndDlg, -1);
-      return TRUE;
+    /* a script's wait replaces the interval, from when the tick started, and
+     * so does backing off when the input didn't get through, whichever is
+     * longer. */
+    const long waitMs = moveMouse(worker);
+    const long long backoffUs = checkInjection(worker);
+    if (waitMs >= 0 || backoffUs) {
+      const long long waitUs = waitMs * 1000LL;
+      schedulerPostpone(&worker->scheduler, now,
+                        waitUs > backoffUs ? waitUs : backoffUs);
     }
   }
-  return FALSE;
+  recordTick(worker, scheduledUs, now, startQpc, postponeMs != 0,
+             cursorQueries);
 }
 
-static void *dwordAlign(void *ptr) {
-  uintptr_t p = (uintptr_t)ptr;
-  p += 3;
-  p >>= 2;
-  p <<= 2;
-  return (void *)p;
+static void onTickDue(void *ctx, struct WheelTimer *timer) {
+  struct TickWorker *worker = ctx;
+  onTick(worker);
+  wheelSchedule(&worker->wheel, timer, worker->scheduler.nextDeadlineUs);
 }
 
-static void *memcpy_incr(void *dst, const void *src, size_t len) {
-  memcpy(dst, src, len);
-  return ((char *)dst) + len;
+static void onScrollDue(void *ctx, struct WheelTimer *timer) {
+  /* the wheel is turned by a notch and right back, which some applications
+   * notice while ignoring the cursor moving around. it goes through the same
+   * gate as the ticks : while the user is active, the nudge waits until
+   * they'll have been idle for a whole interval, and it's marked as our own
+   * input, so that the next tick doesn't take it for the user's. it's also
+   * skipped while Ctrl is held down, which would turn it into a zoom. */
+  struct TickWorker *worker = ctx;
+  const uint32_t postponeMs =
+      worker->pauseWhileActive ? getActivityPostponeMs(worker) : 0;
+  if (postponeMs) {
+    wheelSchedule(&worker->wheel, timer, nowUs(worker) + postponeMs * 1000LL);
+    return;
+  }
+  if (GetAsyncKeyState(VK_CONTROL) < 0) {
+    scheduleScroll(worker);
+    return;
+  }
+  if (worker->pauseWhileActive || worker->motion.absolute) {
+    activityOnInjected(&worker->activity, GetTickCount());
+  }
+  worker->motionBackend.sendWheel(worker->motionBackend.ctx, 1);
+  worker->motionBackend.sendWheel(worker->motionBackend.ctx, -1);
+  scheduleScroll(worker);
 }
 
-static void *initDLGTEMPLATEEX(unsigned char *buf, DWORD helpID, DWORD exStyle,
-                               DWORD style, WORD cDlgItems, short x, short y,
-                               short cx, short cy, const wchar_t *title) {
-  const WORD dlgVer = 1;
-  const WORD signature = 0xFFFF;
-  style |= (DS_SETFONT | DS_SHELLFONT);
-  buf = memcpy_incr(buf, &dlgVer, sizeof(dlgVer));
-  buf = memcpy_incr(buf, &signature, sizeof(signature));
-  buf = memcpy_incr(buf, &helpID, sizeof(helpID));
-  buf = memcpy_incr(buf, &exStyle, sizeof(exStyle));
-  buf = memcpy_incr(buf, &style, sizeof(style));
-  buf = memcpy_incr(buf, &cDlgItems, sizeof(cDlgItems));
-  buf = memcpy_incr(buf, &x, sizeof(x));
-  buf = memcpy_incr(buf, &y, sizeof(y));
-  buf = memcpy_incr(buf, &cx, sizeof(cx));
-  buf = memcpy_incr(buf, &cy, sizeof(cy));
-  memset(buf, 0, 4); /* no menu, default window class */
-  buf += 4;
-  buf = memcpy_incr(buf, title, (wcslen(title) + 1) * sizeof(*title));
+static void runDueActions(struct TickWorker *worker) {
+  /* the timeout of the wait, and the waitable timer, don't follow the same
+   * clock as the performance counter, and may end a tiny bit before the
+   * deadline they were meant for : whatever is due at that deadline runs
+   * anyway, rather than waiting again for a few microseconds. the timer is
+   * only armed once every action has run, and the next deadlines are known
+   * for sure. they're absolute, so arming the timer afterwards doesn't make
+   * the ticks drift. */
+  const long long now = nowUs(worker);
+  const long long deadlineUs = wheelNextDeadlineUs(&worker->wheel);
+  wheelAdvance(&worker->wheel, deadlineUs > now ? deadlineUs : now);
+  if (timerDriven(worker)) {
+    armTickTimer(worker);
+  }
+}
 
-  /* the values here are based on the default values when creating dialogs via
-   * MSVC's resource editor. not using DS_SETFONT and DS_SHELLFONT and not
-   * appending font data to the dialog template results in an ugly Fixedsys-like
-   * font being used, which makes it look like Windows 3.1. */
-  const WORD pointsize = 8;
-  const WORD weight = FW_NORMAL;
-  const BYTE italic = 0;
-  const BYTE charset = DEFAULT_CHARSET;
-  const wchar_t typeface[] = L"MS Shell Dlg";
-  buf = memcpy_incr(buf, &pointsize, sizeof(pointsize));
-  buf = memcpy_incr(buf, &weight, sizeof(weight));
-  buf = memcpy_incr(buf, &italic, sizeof(italic));
-  buf = memcpy_incr(buf, &charset, sizeof(charset));
-  buf = memcpy_incr(buf, typeface, sizeof(typeface));
-  return dwordAlign(buf);
+static void setWorkerUrgent(struct TickWorker *worker, bool urgent) {
+  /* in background mode, the rest of the process runs at idle priority, and
+   * is throttled, which is fine for anything but the ticks : a tick that has
+   * to wait for a busy machine to be idle can come seconds late. this thread
+   * is only urgent while it waits, which costs nothing, and while it runs
+   * the actions which are due : the priority that it waits with is what
+   * decides how soon it runs once the timer fires. within the idle priority
+   * class, anything short of time critical would still leave it behind every
+   * thread of a normal application. anything else, such as applying new
+   * settings, which may compile a script or map a trace, happens at the same
+   * priority as the rest of the process.
+   *
+   * this only changes anything when the mode is switched or the settings
+   * change, never around a tick. the pages which the ticks touch keep their
+   * normal memory priority, so that they're not the first ones to go. */
+  if (urgent == worker->urgent) {
+    return;
+  }
+  worker->urgent = urgent;
+  SetThreadPriority(GetCurrentThread(), urgent ? THREAD_PRIORITY_TIME_CRITICAL
+                                               : THREAD_PRIORITY_NORMAL);
+  if (worker->setThreadInformation) {
+    struct PowerThrottlingState throttling;
+    throttling.version = POWER_THROTTLING_VERSION;
+    throttling.controlMask = urgent ? POWER_THROTTLING_EXECUTION_SPEED : 0;
+    throttling.stateMask = 0;
+    worker->setThreadInformation(GetCurrentThread(),
+                                 THREAD_INFO_POWER_THROTTLING, &throttling,
+                                 sizeof(throttling));
+    ULONG memoryPriority = MEMORY_PRIORITY_NORMAL;
+    worker->setThreadInformation(GetCurrentThread(),
+                                 THREAD_INFO_MEMORY_PRIORITY, &memoryPriority,
+                                 sizeof(memoryPriority));
+  }
 }
 
-static void *initDLGITEMTEMPLATEEX(unsigned char *buf, DWORD helpID,
-                                   DWORD exStyle, DWORD style, short x, short y,
-                                   short cx, short cy, DWORD id,
+static DWORD WINAPI tickWorkerMain(void *param) {
+  /* the timer, if there is one, is passed as the first handle, which means
+   * that a pending tick always takes priority over newly published settings.
+   * the settings are applied once right away, which also builds the initial
+   * screen layout. */
+  struct TickWorker *worker = param;
+  HANDLE handles[2];
+  DWORD handleCount = 0;
+  if (worker->tickTimer) {
+    handles[handleCount++] = worker->tickTimer;
+  }
+  handles[handleCount++] = worker->wakeEvent;
+
+  applySettings(worker);
+  for (;;) {
+    setWorkerUrgent(worker, worker->background);
+    const DWORD waitRv = WaitForMultipleObjects(handleCount, handles, FALSE,
+                                                waitTimeoutMs(worker));
+    /* every wakeup is counted, whatever its reason : this is the number that
+     * parking and coalescing are meant to bring down. */
+    ++worker->wakeups;
+    const bool timerFired = worker->tickTimer && waitRv == WAIT_OBJECT_0;
+    if (waitRv == WAIT_TIMEOUT || timerFired) {
+      /* the timer might have already been signaled right before the timer
+       * was switched off, or ticking itself was. */
+      if (worker->ticking && timerDriven(worker) == timerFired) {
+        runDueActions(worker);
+      }
+    } else if (waitRv == WAIT_OBJECT_0 + handleCount - 1) {
+      if (atomicLoad(&worker->settings.quit)) {
+        return 0;
+      }
+      setWorkerUrgent(worker, false);
+      applySettings(worker);
+    } else {
+      return 1;
+    }
+    publishStats(worker);
+    if (worker->injectionChanged) {
+      worker->injectionChanged = false;
+      PostMessageW(worker->notifyWnd, WM_INJECTION_CHANGED, 0, 0);
+    }
+  }
+}
+
+static void openTelemetry(struct TickWorker *worker) {
+  /* the mapping is backed by the paging file and lives in the session's
+   * namespace, so each logged in user gets their own. if it already exists,
+   * another instance of La Flor is already producing records into it : there
+   * can only be a single producer, so this instance just doesn't record
+   * anything. */
+  const DWORD size = (DWORD)telemetrySize(TELEMETRY_DEFAULT_CAPACITY);
+  HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE,
+                                      0, size, TelemetryMappingName);
+  if (mapping == 0) {
+    return;
+  }
+  void *view = 0;
+  if (GetLastError() != ERROR_ALREADY_EXISTS) {
+    view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  }
+  if (view == 0 || !telemetryInit(&worker->telemetry, view, size,
+                                  TELEMETRY_DEFAULT_CAPACITY)) {
+    if (view) {
+      UnmapViewOfFile(view);
+    }
+    CloseHandle(mapping);
+    return;
+  }
+  worker->telemetryMapping = mapping;
+}
+
+static void initDataPaths(struct TickWorker *worker) {
+  /* the traces live in the user's local application data : they can get
+   * fairly big, and have no business roaming around with the profile. the
+   * script lives right next to them. */
+  wchar_t dir[MAX_PATH];
+  if (SHGetFolderPathW(0, CSIDL_LOCAL_APPDATA, 0, 0, dir) != S_OK ||
+      lstrlenW(dir) + 32 > MAX_PATH) {
+    return;
+  }
+  formatW(worker->tracePath, MAX_PATH, L"%s\\LaFlor.trace", dir);
+  formatW(worker->recordPath, MAX_PATH, L"%s\\LaFlor.trace.new", dir);
+  formatW(worker->scriptPath, MAX_PATH, L"%s\\LaFlor.script", dir);
+}
+
+static bool initTickWorker(struct TickWorker *worker) {
+  memset(worker, 0, sizeof(*worker));
+  initInjector(&worker->injector);
+  initMotionBackend(&worker->motionBackend, &worker->injector);
+  motionInit(&worker->motion, &worker->motionBackend, predefDeltas[0]);
+  schedulerInit(&worker->scheduler);
+  wheelTimerInit(&worker->tickAction, onTickDue, worker);
+  wheelTimerInit(&worker->scrollAction, onScrollDue, worker);
+  activityInit(&worker->activity);
+  backoffInit(&worker->backoff);
+  worker->interval = DEFAULT_INTERVAL;
+  ProcessIdToSessionId(GetCurrentProcessId(), &worker->sessionId);
+
+  LARGE_INTEGER freq;
+  QueryPerformanceFrequency(&freq);
+  worker->qpcFrequency = freq.QuadPart;
+  worker->startUs = nowUs(worker);
+  wheelInit(&worker->wheel, worker->startUs, WHEEL_RESOLUTION_US);
+  worker->tickTimer = createTickTimer(&worker->highResTimer);
+  worker->setWaitableTimerEx = (SetWaitableTimerExFn)GetProcAddress(
+      GetModuleHandleW(L"kernel32.dll"), "SetWaitableTimerEx");
+  worker->setThreadInformation = (SetThreadInformationFn)GetProcAddress(
+      GetModuleHandleW(L"kernel32.dll"), "SetThreadInformation");
+  worker->wakeEvent = CreateEventW(0, FALSE, FALSE, 0);
+  openTelemetry(worker);
+  initDataPaths(worker);
+  return worker->wakeEvent != 0;
+}
+
+static bool startTickWorker(struct TickWorker *worker) {
+  /* CreateThread() is enough here, as the thread doesn't use any of the C
+   * runtime's per-thread state. */
+  worker->thread = CreateThread(0, 0, tickWorkerMain, worker, 0, 0);
+  return worker->thread != 0;
+}
+
+static void stopTickWorker(struct TickWorker *worker) {
+  if (worker->thread) {
+    atomicStore(&worker->settings.quit, 1);
+    SetEvent(worker->wakeEvent);
+    WaitForSingleObject(worker->thread, INFINITE);
+    CloseHandle(worker->thread);
+  }
+  /* a recording which was stopped right before quitting might not have been
+   * picked up by the thread. */
+  if (atomicLoad(&worker->settings.traceRecorded)) {
+    commitRecordedTrace(worker);
+  }
+  closeTrace(worker);
+  if (worker->tickTimer) {
+    CloseHandle(worker->tickTimer);
+  }
+  if (worker->wakeEvent) {
+    CloseHandle(worker->wakeEvent);
+  }
+  if (worker->telemetryMapping) {
+    UnmapViewOfFile(worker->telemetry.header);
+    CloseHandle(worker->telemetryMapping);
+  }
+}
+
+/* the interval that the ticks actually come at. */
+static int tickInterval(const struct AppState *state) {
+  return state->autoInterval ? state->autoIntervalMs : state->interval;
+}
+
+static void publishSettings(struct AppState *state) {
+  /* everything is published every time : it's just a handful of stores, and
+   * the worker only acts on the values which actually changed. */
+  struct SharedSettings *settings = &state->worker.settings;
+  atomicStore(&settings->interval, tickInterval(state));
+  atomicStore(&settings->delta, state->delta);
+  atomicStore(&settings->enabled, state->active);
+  atomicStore(&settings->precise, state->precise);
+  atomicStore(&settings->pauseWhileActive, state->pauseWhileActive);
+  atomicStore(&settings->smooth, state->smooth);
+  atomicStore(&settings->absolute, state->absolute);
+  atomicStore(&settings->reconcileEvery, state->reconcileEvery);
+  atomicStore(&settings->timerToleranceMs, state->timerToleranceMs);
+  atomicStore(&settings->scrollEvery, state->scrollEvery);
+  atomicStore(&settings->spread, state->spreadTicks);
+  atomicStore(&settings->background, state->inBackground);
+  atomicStore(&settings->parked, state->parkReasons != 0);
+  atomicStore(&settings->replay, state->replay);
+  atomicStore(&settings->pattern, state->pattern);
+  SetEvent(state->worker.wakeEvent);
+  /* whatever changed gets saved, which happens a little later, so that every
+   * change made in the meantime is saved along with it. setting the timer
+   * again just pushes it back. */
+  if (state->wnd) {
+    SetTimer(state->wnd, TIMER_SAVE, SAVE_DELAY_MS, 0);
+  }
+}
+
+static void commonAppendMenuItem(HMENU menu, int extraFlags,
+                                 UINT_PTR menuItemId, const wchar_t *label) {
+  AppendMenuW(menu, MF_STRING | extraFlags, menuItemId, label);
+}
+
+static HMENU commonCreateMenu(const int *vals, int numVals, int idmStart,
+                              void (*formatFn)(wchar_t *, int, int)) {
+  HMENU rv = CreatePopupMenu();
+  if (rv == 0) {
+    return 0;
+  }
+  for (int i = 0; i < numVals; ++i) {
+    wchar_t buf[256];
+    formatFn(buf, ARRAYSIZE(buf), vals[i]);
+    commonAppendMenuItem(rv, 0, (UINT_PTR)idmStart + i, buf);
+  }
+  commonAppendMenuItem(rv, 0, (UINT_PTR)idmStart + numVals, L"Custom...");
+  return rv;
+}
+
+static void commonCheckMenuValue(HMENU menu, int numVals, int currentSelected,
+                                 int idmStart) {
+  /* the "Custom..." item comes right after the predefined values, and is the
+   * one that's selected whenever the current value isn't one of them. */
+  const UINT selected = idmStart + (currentSelected == -1 ? numVals
+                                                          : currentSelected);
+  CheckMenuRadioItem(menu, idmStart, idmStart + numVals, selected,
+                     MF_BYCOMMAND);
+}
+
+static void intervalFormat(wchar_t *buf, int bufLen, int value) {
+  if (value < 1000) {
+    formatW(buf, bufLen, L"%d ms", value);
+  } else {
+    formatW(buf, bufLen, L"%d s", value / 1000);
+  }
+}
+
+static void deltaFormat(wchar_t *buf, int bufLen, int value) {
+  formatW(buf, bufLen, L"%d px", value);
+}
+
+static void statsFormat(wchar_t *buf, int bufLen,
+                        const struct TickStats *stats) {
+  /* formatW() doesn't support floating point, so the milliseconds are
+   * printed as two separate integers. */
+  const long long avg = stats->ticks ? stats->jitterSumUs / stats->ticks : 0;
+  const long long p99 = schedulerJitterPercentileUs(stats, 99);
+  const long long max = stats->jitterMaxUs;
+  formatW(buf, bufLen,
+          L"Jitter : avg %d.%02d ms, p99 %d.%02d ms, max %d.%02d ms, "
+          L"%d missed",
+          (int)(avg / 1000), (int)(avg % 1000 / 10), (int)(p99 / 1000),
+          (int)(p99 % 1000 / 10), (int)(max / 1000), (int)(max % 1000 / 10),
+          (int)stats->missed);
+}
+
+/* the menu is built only once, in createMenu(), and then kept up to date by
+ * the functions below, each of which only touches the items affected by a
+ * single setting. this is a lot cheaper than building the whole menu tree
+ * again every time that it's shown. */
+
+static void updateIntervalItems(struct AppState *state) {
+  /* the automatic interval is compared to the one picked by hand, which is
+   * what the ticks would come at otherwise. */
+  wchar_t intervalBuf[16];
+  intervalFormat(intervalBuf, ARRAYSIZE(intervalBuf), state->autoIntervalMs);
+  const long saved =
+      idleTicksSavedPerHour(state->interval, state->autoIntervalMs);
+  wchar_t autoBuf[96];
+  formatW(autoBuf, ARRAYSIZE(autoBuf), L"Auto : %s, %ld %s ticks per hour",
+          intervalBuf, saved < 0 ? -saved : saved,
+          saved < 0 ? L"more" : L"fewer");
+  ModifyMenuW(state->intervalMenu, IDM_INTERVAL_AUTO, MF_BYCOMMAND | MF_STRING,
+              IDM_INTERVAL_AUTO, autoBuf);
+  /* the automatic item comes after "Custom...", and the radio check covers
+   * both, which is why commonCheckMenuValue() isn't enough here. */
+  const int predef = seekPredefInterval(state->interval);
+  const UINT selected =
+      state->autoInterval
+          ? IDM_INTERVAL_AUTO
+          : IDM_INTERVAL_START +
+                (predef == -1 ? ARRAYSIZE(predefIntervals) : predef);
+  CheckMenuRadioItem(state->intervalMenu, IDM_INTERVAL_START,
+                     IDM_INTERVAL_AUTO, selected, MF_BYCOMMAND);
+}
+
+static void updateDeltaItems(struct AppState *state) {
+  commonCheckMenuValue(state->deltaMenu, ARRAYSIZE(predefDeltas),
+                       seekPredefDelta(state->delta), IDM_DELTA_START);
+}
+
+static void updatePatternItems(struct AppState *state) {
+  CheckMenuRadioItem(state->menu, IDM_PATTERN_START, IDM_PATTERN_END - 1,
+                     IDM_PATTERN_START + state->pattern, MF_BYCOMMAND);
+}
+
+static void updateCheckedItem(struct AppState *state, UINT itemId,
+                              bool checked) {
+  CheckMenuItem(state->menu, itemId,
+                MF_BYCOMMAND | (checked ? MF_CHECKED : MF_UNCHECKED));
+}
+
+static void updateEnabledItems(struct AppState *state) {
+  /* the items opening submenus don't have any IDs, so they're referred to by
+   * their position. */
+  updateCheckedItem(state, IDM_ENABLED, state->active);
+  const UINT grayFlag = state->active ? MF_ENABLED : MF_GRAYED;
+  EnableMenuItem(state->menu, MENU_POS_INTERVAL, MF_BYPOSITION | grayFlag);
+  EnableMenuItem(state->menu, MENU_POS_DELTA, MF_BYPOSITION | grayFlag);
+}
+
+static unsigned long wakeupsPerHour(const struct TickWorker *worker,
+                                    unsigned long wakeups) {
+  /* averaged over the whole time that the injection thread has been running,
+   * parked or not. */
+  const long long elapsedUs = nowUs(worker) - worker->startUs;
+  if (elapsedUs <= 0) {
+    return wakeups;
+  }
+  return (unsigned long)(wakeups * 3600000000ULL / elapsedUs);
+}
+
+static void updateTooltip(struct AppState *state) {
+  /* the tooltip only mentions injection once some of it failed. it's updated
+   * whenever injection stops or starts working again, and whenever the cursor
+   * hovers over the icon, which keeps the count current without bothering
+   * the shell on every failed tick. */
+  struct WorkerStats stats;
+  readStats(&state->worker, &stats);
+  if (stats.failedTicks == state->tooltipFailedTicks &&
+      stats.injectionBlocked == state->tooltipBlocked) {
+    return;
+  }
+  state->tooltipFailedTicks = stats.failedTicks;
+  state->tooltipBlocked = stats.injectionBlocked;
+  NOTIFYICONDATAW data;
+  notifyIconDataCommonInit(&data, state->wnd);
+  data.uFlags |= NIF_TIP;
+  formatW(data.szTip, ARRAYSIZE(data.szTip), L"La Flor\n%s%lu failed ticks",
+          stats.injectionBlocked ? L"Input blocked, " : L"",
+          stats.failedTicks);
+  Shell_NotifyIconW(NIM_MODIFY, &data);
+}
+
+static void updateStatsItems(struct AppState *state) {
+  /* the statistics are the only part of the menu which changes without the
+   * user doing anything, so their labels are refreshed right before the menu
+   * is shown. */
+  struct WorkerStats stats;
+  readStats(&state->worker, &stats);
+  wchar_t statsBuf[128];
+  statsFormat(statsBuf, ARRAYSIZE(statsBuf), &stats.ticks);
+  ModifyMenuW(state->menu, IDM_STATS, MF_BYCOMMAND | MF_STRING | MF_GRAYED,
+              IDM_STATS, statsBuf);
+
+  wchar_t wakeupsBuf[64];
+  formatW(wakeupsBuf, ARRAYSIZE(wakeupsBuf), L"Wakeups : %lu per hour%s",
+          wakeupsPerHour(&state->worker, stats.wakeups),
+          state->parkReasons ? L" (parked)" : L"");
+  ModifyMenuW(state->menu, IDM_WAKEUPS, MF_BYCOMMAND | MF_STRING | MF_GRAYED,
+              IDM_WAKEUPS, wakeupsBuf);
+
+  wchar_t pauseBuf[64];
+  formatW(pauseBuf, ARRAYSIZE(pauseBuf),
+          L"Pause while in use (%lu ticks skipped)", stats.skippedTicks);
+  ModifyMenuW(state->menu, IDM_PAUSE_WHILE_ACTIVE,
+              MF_BYCOMMAND | MF_STRING |
+                  (state->pauseWhileActive ? MF_CHECKED : MF_UNCHECKED),
+              IDM_PAUSE_WHILE_ACTIVE, pauseBuf);
+}
+
+static bool createMenu(struct AppState *state) {
+  HMENU rv = CreatePopupMenu();
+  if (rv == 0) {
+    return false;
+  }
+  AppendMenuW(rv, MF_STRING, IDM_ENABLED, L"Enabled");
+  AppendMenuW(rv, MF_SEPARATOR, 0, 0);
+
+  /* the top-level menu takes ownership of submenus : see the comment around
+   * DestroyMenu() about that. */
+  state->intervalMenu =
+      commonCreateMenu(predefIntervals, ARRAYSIZE(predefIntervals),
+                       IDM_INTERVAL_START, intervalFormat);
+  state->deltaMenu = commonCreateMenu(predefDeltas, ARRAYSIZE(predefDeltas),
+                                      IDM_DELTA_START, deltaFormat);
+  HMENU patternMenu = CreatePopupMenu();
+  if (state->intervalMenu == 0 || state->deltaMenu == 0 || patternMenu == 0) {
+    DestroyMenu(state->intervalMenu);
+    DestroyMenu(state->deltaMenu);
+    DestroyMenu(patternMenu);
+    DestroyMenu(rv);
+    return false;
+  }
+  for (int i = 0; i < ARRAYSIZE(patternLabels); ++i) {
+    AppendMenuW(patternMenu, MF_STRING, IDM_PATTERN_START + i,
+                patternLabels[i]);
+  }
+  /* the label of the automatic interval is filled in by
+   * updateIntervalItems(). */
+  AppendMenuW(state->intervalMenu, MF_SEPARATOR, 0, 0);
+  AppendMenuW(state->intervalMenu, MF_STRING, IDM_INTERVAL_AUTO, L"");
+  AppendMenuW(rv, MF_POPUP | MF_STRING, (UINT_PTR)state->intervalMenu,
+              L"Interval");
+  AppendMenuW(rv, MF_POPUP | MF_STRING, (UINT_PTR)state->deltaMenu,
+              L"Delta");
+  AppendMenuW(rv, MF_POPUP | MF_STRING, (UINT_PTR)patternMenu, L"Pattern");
+
+  AppendMenuW(rv, MF_SEPARATOR, 0, 0);
+  AppendMenuW(rv, (state->worker.tickTimer ? 0 : MF_GRAYED) | MF_STRING,
+              IDM_PRECISE,
+              state->worker.highResTimer ? L"Precise timing (high resolution)"
+                                         : L"Precise timing");
+  /* the labels of these three are filled in by updateStatsItems(). */
+  AppendMenuW(rv, MF_STRING | MF_GRAYED, IDM_STATS, L"");
+  AppendMenuW(rv, MF_STRING | MF_GRAYED, IDM_WAKEUPS, L"");
+  AppendMenuW(rv, MF_STRING, IDM_PAUSE_WHILE_ACTIVE, L"");
+  AppendMenuW(rv, MF_STRING, IDM_SMOOTH, L"Smooth motion");
+  AppendMenuW(rv, MF_STRING, IDM_ABSOLUTE, L"Exact positioning");
+  const UINT traceFlag = state->worker.tracePath[0] ? 0 : MF_GRAYED;
+  AppendMenuW(rv, MF_STRING | traceFlag, IDM_RECORD, L"Record my movement");
+  AppendMenuW(rv, MF_STRING | traceFlag, IDM_REPLAY,
+              L"Replay recorded movement");
+  AppendMenuW(rv, MF_STRING, IDM_KEEP_AWAKE, L"Keep awake without moving");
+  AppendMenuW(rv, MF_STRING, IDM_BACKGROUND, L"Low priority");
+
+  AppendMenuW(rv, MF_SEPARATOR, 0, 0);
+  AppendMenuW(rv, MF_STRING, IDM_QUIT, L"Quit");
+  state->menu = rv;
+
+  updateEnabledItems(state);
+  updateIntervalItems(state);
+  updateDeltaItems(state);
+  updatePatternItems(state);
+  updateCheckedItem(state, IDM_PRECISE, state->precise);
+  updateCheckedItem(state, IDM_SMOOTH, state->smooth);
+  updateCheckedItem(state, IDM_ABSOLUTE, state->absolute);
+  updateCheckedItem(state, IDM_REPLAY, state->replay);
+  updateCheckedItem(state, IDM_KEEP_AWAKE, state->keepAwake);
+  updateCheckedItem(state, IDM_BACKGROUND, state->background);
+  updateStatsItems(state);
+  return true;
+}
+
+static void setNewDelta(struct AppState *state, int wantedDelta) {
+  state->delta = wantedDelta;
+  publishSettings(state);
+  updateDeltaItems(state);
+}
+
+static void setNewInterval(struct AppState *state, int interval) {
+  state->interval = interval;
+  state->autoInterval = false;
+  publishSettings(state);
+  updateIntervalItems(state);
+}
+
+static void setPreciseTiming(struct AppState *state, bool precise) {
+  state->precise = precise && state->worker.tickTimer;
+  publishSettings(state);
+  updateCheckedItem(state, IDM_PRECISE, state->precise);
+}
+
+#define ID_EDIT 200
+
+static BOOL CALLBACK inputDialogProc(HWND hwndDlg, UINT message, WPARAM wParam,
+                                     LPARAM lParam) {
+  switch (message) {
+  case WM_INITDIALOG:
+    /* the templates are built once and reused, so the initial value isn't
+     * part of them : it's passed to DialogBoxIndirectParamW() instead, which
+     * hands it over here. */
+    SetDlgItemInt(hwndDlg, ID_EDIT, (UINT)lParam, FALSE);
+    break;
+  case WM_COMMAND:
+    switch (LOWORD(wParam)) {
+    case IDOK: {
+      wchar_t valBuf[32];
+      GetDlgItemTextW(hwndDlg, ID_EDIT, valBuf, ARRAYSIZE(valBuf));
+      int value;
+      if (parseIntW(valBuf, &value) && value > 0) {
+        EndDialog(hwndDlg, value);
+      } else {
+        EndDialog(hwndDlg, -1);
+      }
+      return TRUE;
+    }
+    case IDCANCEL:
+      EndDialog(hwndDlg, -1);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+static void *dwordAlign(void *ptr) {
+  uintptr_t p = (uintptr_t)ptr;
+  p += 3;
+  p >>= 2;
+  p <<= 2;
+  return (void *)p;
+}
+
+static void *memcpy_incr(void *dst, const void *src, size_t len) {
+  memcpy(dst, src, len);
+  return ((char *)dst) + len;
+}
+
+static void *initDLGTEMPLATEEX(unsigned char *buf, DWORD helpID, DWORD exStyle,
+                               DWORD style, WORD cDlgItems, short x, short y,
+                               short cx, short cy, const wchar_t *title) {
+  const WORD dlgVer = 1;
+  const WORD signature = 0xFFFF;
+  style |= (DS_SETFONT | DS_SHELLFONT);
+  buf = memcpy_incr(buf, &dlgVer, sizeof(dlgVer));
+  buf = memcpy_incr(buf, &signature, sizeof(signature));
+  buf = memcpy_incr(buf, &helpID, sizeof(helpID));
+  buf = memcpy_incr(buf, &exStyle, sizeof(exStyle));
+  buf = memcpy_incr(buf, &style, sizeof(style));
+  buf = memcpy_incr(buf, &cDlgItems, sizeof(cDlgItems));
+  buf = memcpy_incr(buf, &x, sizeof(x));
+  buf = memcpy_incr(buf, &y, sizeof(y));
+  buf = memcpy_incr(buf, &cx, sizeof(cx));
+  buf = memcpy_incr(buf, &cy, sizeof(cy));
+  memset(buf, 0, 4); /* no menu, default window class */
+  buf += 4;
+  buf = memcpy_incr(buf, title, (lstrlenW(title) + 1) * sizeof(*title));
+
+  /* the values here are based on the default values when creating dialogs via
+   * MSVC's resource editor. not using DS_SETFONT and DS_SHELLFONT and not
+   * appending font data to the dialog template results in an ugly Fixedsys-like
+   * font being used, which makes it look like Windows 3.1. */
+  const WORD pointsize = 8;
+  const WORD weight = FW_NORMAL;
+  const BYTE italic = 0;
+  const BYTE charset = DEFAULT_CHARSET;
+  const wchar_t typeface[] = L"MS Shell Dlg";
+  buf = memcpy_incr(buf, &pointsize, sizeof(pointsize));
+  buf = memcpy_incr(buf, &weight, sizeof(weight));
+  buf = memcpy_incr(buf, &italic, sizeof(italic));
+  buf = memcpy_incr(buf, &charset, sizeof(charset));
+  buf = memcpy_incr(buf, typeface, sizeof(typeface));
+  return dwordAlign(buf);
+}
+
+static void *initDLGITEMTEMPLATEEX(unsigned char *buf, DWORD helpID,
+                                   DWORD exStyle, DWORD style, short x, short y,
+                                   short cx, short cy, DWORD id,
                                    WORD windowClass, const wchar_t *text) {
   buf = memcpy_incr(buf, &helpID, sizeof(helpID));
   buf = memcpy_incr(buf, &exStyle, sizeof(exStyle));
@@ -338,154 +1943,1465 @@ static void *initDLGITEMTEMPLATEEX(unsigned char *buf, DWORD helpID,
   memcpy(buf + 2, &windowClass, sizeof(windowClass));
   buf += 4;
 
-  buf = memcpy_incr(buf, text, (wcslen(text) + 1) * sizeof(*text));
-  memset(buf, 0, 2); /* zero size of extra data */
-  buf += 2;
-  return dwordAlign(buf);
+  buf = memcpy_incr(buf, text, (lstrlenW(text) + 1) * sizeof(*text));
+  memset(buf, 0, 2); /* zero size of extra data */
+  buf += 2;
+  return dwordAlign(buf);
+}
+
+static void buildInputDialog(struct DialogTemplate *out, const wchar_t *title,
+                             const wchar_t *label, const wchar_t *units) {
+  unsigned char *buf = (unsigned char *)out->data;
+  memset(buf, 0, sizeof(out->data));
+
+  const WORD buttonControl = 0x0080;
+  const WORD editControl = 0x0081;
+  const WORD staticControl = 0x0082;
+
+  void *dlg = initDLGTEMPLATEEX(buf, 0, 0,
+                                WS_POPUP | WS_SYSMENU | WS_CAPTION |
+                                    DS_MODALFRAME | DS_CENTERMOUSE,
+                                5, 10, 10, 100, 80, title);
+
+  dlg = initDLGITEMTEMPLATEEX(dlg, 0, 0, WS_CHILD | WS_VISIBLE | SS_CENTER, 10,
+                              10, 80, 10, 0xdeadbeef, staticControl, label);
+  dlg = initDLGITEMTEMPLATEEX(dlg, 0, 0, WS_CHILD | WS_VISIBLE | ES_NUMBER, 10,
+                              30, 60, 10, ID_EDIT, editControl, L"");
+  dlg = initDLGITEMTEMPLATEEX(dlg, 0, 0, WS_CHILD | WS_VISIBLE | SS_LEFT, 75,
+                              30, 15, 10, 0xdeadc0de, staticControl, units);
+  dlg =
+      initDLGITEMTEMPLATEEX(dlg, 0, 0, WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON,
+                            10, 50, 20, 20, IDOK, buttonControl, L"OK");
+  dlg =
+      initDLGITEMTEMPLATEEX(dlg, 0, 0, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+                            50, 50, 30, 20, IDCANCEL, buttonControl, L"Cancel");
+  assert((unsigned char *)dlg - buf <= (ptrdiff_t)sizeof(out->data));
+}
+
+static void buildInputDialogs(struct AppState *state) {
+  buildInputDialog(&state->intervalDialog, L"Custom interval",
+                   L"Please enter the new interval", L"ms");
+  buildInputDialog(&state->deltaDialog, L"Custom delta",
+                   L"Please enter the new delta", L"px");
+}
+
+static LRESULT displayInputDialog(struct AppState *state,
+                                  const struct DialogTemplate *dialog,
+                                  int initialValue) {
+  state->inputDialogActive = true;
+  LRESULT rv = DialogBoxIndirectParamW(state->app,
+                                       (const DLGTEMPLATE *)dialog->data,
+                                       state->wnd, inputDialogProc,
+                                       initialValue);
+  state->inputDialogActive = false;
+  return rv;
+}
+
+static int getCustomInterval(struct AppState *state) {
+  /* in ms, like the presets, some of which are less than a second. an
+   * interval which is too short is dropped, just like one which isn't a
+   * number. */
+  const int interval =
+      (int)displayInputDialog(state, &state->intervalDialog, state->interval);
+  return interval < SCHEDULER_MIN_INTERVAL_MS ? -1 : interval;
+}
+
+static int getCustomDelta(struct AppState *state) {
+  return displayInputDialog(state, &state->deltaDialog, state->delta);
+}
+
+static void updatePowerRequest(struct AppState *state) {
+  /* the system is only kept awake while La Flor is enabled, and while the
+   * ticks wouldn't be parked for any other reason : keeping a locked
+   * workstation awake is no more useful than moving its cursor. */
+  const bool hold = state->active && state->keepAwake &&
+                    (state->parkReasons & ~PARK_KEEP_AWAKE) == 0;
+  if (hold == state->awakeHeld) {
+    return;
+  }
+  state->awakeHeld = hold;
+  HMODULE kernel32 = GetModuleHandleW(L"kernel32.dll");
+  PowerCreateRequestFn createFn =
+      (PowerCreateRequestFn)GetProcAddress(kernel32, "PowerCreateRequest");
+  PowerRequestFn setFn =
+      (PowerRequestFn)GetProcAddress(kernel32, "PowerSetRequest");
+  PowerRequestFn clearFn =
+      (PowerRequestFn)GetProcAddress(kernel32, "PowerClearRequest");
+  /* power requests show up in "powercfg /requests", along with their reason,
+   * which makes it obvious who keeps the system awake. */
+  if (createFn && setFn && clearFn && state->powerRequest == 0) {
+    struct ReasonContext context;
+    memset(&context, 0, sizeof(context));
+    context.version = POWER_REQUEST_CONTEXT_VERSION;
+    context.flags = POWER_REQUEST_CONTEXT_SIMPLE_STRING;
+    context.reason.simpleString = L"La Flor keep-awake mode";
+    state->powerRequest = createFn(&context);
+    if (state->powerRequest == INVALID_HANDLE_VALUE) {
+      state->powerRequest = 0;
+    }
+  }
+  if (state->powerRequest) {
+    PowerRequestFn fn = hold ? setFn : clearFn;
+    fn(state->powerRequest, POWER_REQUEST_DISPLAY_REQUIRED);
+    fn(state->powerRequest, POWER_REQUEST_SYSTEM_REQUIRED);
+  } else {
+    /* the execution state belongs to the UI thread, which lives for as long
+     * as La Flor does. */
+    SetThreadExecutionState(
+        hold ? ES_CONTINUOUS | ES_DISPLAY_REQUIRED | ES_SYSTEM_REQUIRED
+             : ES_CONTINUOUS);
+  }
+}
+
+/* parks or unparks the ticks for one of the PARK_ reasons. the ticks only
+ * resume once all the reasons are gone : unlocking the workstation while the
+ * display is still off doesn't resume anything yet. */
+static void setParked(struct AppState *state, unsigned reason, bool parked) {
+  const unsigned reasons =
+      parked ? state->parkReasons | reason : state->parkReasons & ~reason;
+  if (reasons != state->parkReasons) {
+    state->parkReasons = reasons;
+    updatePowerRequest(state);
+    publishSettings(state);
+  }
+}
+
+/* whether the name of the executable at "path" is one of the semicolon
+ * separated names of "list", ignoring case. */
+static bool isInAppList(const wchar_t *list, const wchar_t *path) {
+  const wchar_t *name = path;
+  for (const wchar_t *c = path; *c; ++c) {
+    if (*c == L'\\') {
+      name = c + 1;
+    }
+  }
+  while (*list) {
+    wchar_t entry[MAX_PATH];
+    int len = 0;
+    for (; *list && *list != L';'; ++list) {
+      if (len < MAX_PATH - 1 && (len || *list != L' ')) {
+        entry[len++] = *list;
+      }
+    }
+    while (len && entry[len - 1] == L' ') {
+      --len;
+    }
+    entry[len] = 0;
+    if (len && lstrcmpiW(entry, name) == 0) {
+      return true;
+    }
+    if (*list) {
+      ++list;
+    }
+  }
+  return false;
+}
+
+static bool isWatchedProcess(struct AppState *state, DWORD pid) {
+  /* QueryFullProcessImageNameW() only exists since Vista : on XP, keep-awake
+   * mode never injects anything. */
+  QueryFullProcessImageNameFn queryFn =
+      (QueryFullProcessImageNameFn)GetProcAddress(
+          GetModuleHandleW(L"kernel32.dll"), "QueryFullProcessImageNameW");
+  if (queryFn == 0) {
+    return false;
+  }
+  HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+  if (process == 0) {
+    return false;
+  }
+  wchar_t path[MAX_PATH];
+  DWORD len = ARRAYSIZE(path);
+  const bool rv = queryFn(process, 0, path, &len) &&
+                  isInAppList(state->watchedApps, path);
+  CloseHandle(process);
+  return rv;
+}
+
+static void checkForeground(struct AppState *state, HWND wnd) {
+  /* switching between the windows of the same application doesn't change
+   * anything, so the name of the application is only looked up when it's a
+   * different process. */
+  DWORD pid = 0;
+  if (wnd) {
+    GetWindowThreadProcessId(wnd, &pid);
+  }
+  if (pid == state->foregroundPid) {
+    return;
+  }
+  state->foregroundPid = pid;
+  state->watchedForeground = pid && isWatchedProcess(state, pid);
+  setParked(state, PARK_KEEP_AWAKE,
+            state->keepAwake && !state->watchedForeground);
+}
+
+static void CALLBACK onForegroundChanged(HWINEVENTHOOK hook, DWORD event,
+                                         HWND wnd, LONG object, LONG child,
+                                         DWORD thread, DWORD time) {
+  /* WinEvent hooks don't take any context, so the state is found through the
+   * root window, the same way that windowProc() finds it. out of context
+   * hooks are called by the UI thread itself, from its message loop, so
+   * there's nothing to synchronize either. */
+  HWND root = FindWindowW(RootWindowClass, 0);
+  struct AppState *state =
+      root ? (void *)GetWindowLongPtrW(root, GWLP_USERDATA) : 0;
+  if (state) {
+    checkForeground(state, wnd);
+  }
+}
+
+/* brings keep-awake mode in line with the settings : the power request is
+ * held or released, the ticks are parked or not, and the foreground window
+ * is only watched while there's anything to watch it for. nothing at all
+ * happens periodically in keep-awake mode, unless a watched application is in
+ * the foreground. */
+static void updateKeepAwake(struct AppState *state) {
+  const bool watch = state->active && state->keepAwake && state->watchedApps[0];
+  if (watch && !state->foregroundHook) {
+    state->foregroundHook = SetWinEventHook(
+        EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, 0,
+        onForegroundChanged, 0, 0, WINEVENT_OUTOFCONTEXT);
+    state->foregroundPid = 0;
+    state->watchedForeground = false;
+    checkForeground(state, GetForegroundWindow());
+  } else if (!watch && state->foregroundHook) {
+    UnhookWinEvent(state->foregroundHook);
+    state->foregroundHook = 0;
+    state->watchedForeground = false;
+  }
+  setParked(state, PARK_KEEP_AWAKE,
+            state->keepAwake && !state->watchedForeground);
+  updatePowerRequest(state);
+}
+
+static void stopKeepAwake(struct AppState *state) {
+  if (state->foregroundHook) {
+    UnhookWinEvent(state->foregroundHook);
+    state->foregroundHook = 0;
+  }
+  if (state->powerRequest) {
+    CloseHandle(state->powerRequest);
+    state->powerRequest = 0;
+  }
+}
+
+static void updateBackground(struct AppState *state) {
+  /* background mode : the whole process gets out of the way of whatever the
+   * machine is busy with, with the idle priority class, a low I/O and memory
+   * priority, and power throttling, so that it runs on the efficient cores,
+   * and as slowly as the system likes. only the injection thread makes up
+   * for it, while it's waiting for the next tick and ticking : see
+   * setWorkerUrgent(). the priority class works everywhere, the I/O priority
+   * since Vista and the rest since Windows 8, or Windows 10 1709 for the
+   * throttling : whatever the system doesn't support is just left alone.
+   *
+   * the process only goes there once it's done starting up, so that a busy
+   * machine, e.g. at logon, doesn't hold up the first tick. I/O is mostly
+   * done by the UI thread, which reads and writes the settings, so that's the
+   * only one that needs its I/O priority lowered. */
+  const bool background = state->background && state->running;
+  if (background == state->inBackground) {
+    return;
+  }
+  state->inBackground = background;
+  HANDLE process = GetCurrentProcess();
+  if (background) {
+    state->priorityClass = GetPriorityClass(process);
+  }
+  SetPriorityClass(process,
+                   background ? IDLE_PRIORITY_CLASS : state->priorityClass);
+  SetThreadPriority(GetCurrentThread(), background
+                                            ? THREAD_MODE_BACKGROUND_BEGIN
+                                            : THREAD_MODE_BACKGROUND_END);
+  if (state->setProcessInformation) {
+    ULONG memoryPriority =
+        background ? MEMORY_PRIORITY_LOW : MEMORY_PRIORITY_NORMAL;
+    state->setProcessInformation(process, PROCESS_INFO_MEMORY_PRIORITY,
+                                 &memoryPriority, sizeof(memoryPriority));
+    struct PowerThrottlingState throttling;
+    throttling.version = POWER_THROTTLING_VERSION;
+    throttling.controlMask = background ? POWER_THROTTLING_EXECUTION_SPEED : 0;
+    throttling.stateMask = throttling.controlMask;
+    state->setProcessInformation(process, PROCESS_INFO_POWER_THROTTLING,
+                                 &throttling, sizeof(throttling));
+  }
+}
+
+static void toggleEnabled(struct AppState *state) {
+  state->active ^= 1;
+  publishSettings(state);
+  updateEnabledItems(state);
+  changeNotificationIcon(state->app, state->wnd, state->active);
+  updateKeepAwake(state);
+}
+
+static void onSessionChange(struct AppState *state, WPARAM event,
+                            DWORD sessionId) {
+  /* the connect and disconnect events are also sent about other sessions
+   * being attached to the console, which isn't any of our business. */
+  DWORD ourSession = 0;
+  ProcessIdToSessionId(GetCurrentProcessId(), &ourSession);
+  if (sessionId != ourSession) {
+    return;
+  }
+  switch (event) {
+  case WTS_SESSION_LOCK:
+  case WTS_SESSION_UNLOCK:
+    setParked(state, PARK_LOCKED, event == WTS_SESSION_LOCK);
+    break;
+  case WTS_CONSOLE_DISCONNECT:
+  case WTS_REMOTE_DISCONNECT:
+    setParked(state, PARK_DISCONNECTED, true);
+    break;
+  case WTS_CONSOLE_CONNECT:
+  case WTS_REMOTE_CONNECT:
+    setParked(state, PARK_DISCONNECTED, false);
+    break;
+  }
+}
+
+/* reads the idle timeouts which are in effect right now : the screen saver's,
+ * the power plan's for the current power source, the machine inactivity
+ * limit, which is a group policy, and the user's own. */
+static void readIdleTimeouts(struct AppState *state,
+                             struct IdleTimeouts *out) {
+  memset(out, 0, sizeof(*out));
+  BOOL screenSaverActive = FALSE;
+  int screenSaverTimeout = 0;
+  if (SystemParametersInfoW(SPI_GETSCREENSAVEACTIVE, 0, &screenSaverActive,
+                            0) &&
+      screenSaverActive &&
+      SystemParametersInfoW(SPI_GETSCREENSAVETIMEOUT, 0, &screenSaverTimeout,
+                            0)) {
+    out->screenSaver = screenSaverTimeout;
+  }
+
+  /* SystemPowerPolicyCurrent is the policy for whichever power source is in
+   * use, and still works with the power plans which replaced the power
+   * schemes of XP. the system only goes to sleep when idle if the idle action
+   * is to do anything at all. */
+  HMODULE powrprof = LoadLibraryW(L"powrprof.dll");
+  CallNtPowerInformationFn powerInformationFn =
+      powrprof ? (CallNtPowerInformationFn)GetProcAddress(
+                     powrprof, "CallNtPowerInformation")
+               : 0;
+  SYSTEM_POWER_POLICY policy;
+  if (powerInformationFn &&
+      powerInformationFn(SystemPowerPolicyCurrent, 0, 0, &policy,
+                         sizeof(policy)) == 0) {
+    out->displayOff = (int)policy.VideoTimeout;
+    out->sleep =
+        policy.Idle.Action != PowerActionNone ? (int)policy.IdleTimeout : 0;
+  }
+  if (powrprof) {
+    FreeLibrary(powrprof);
+  }
+
+  HKEY key;
+  if (RegOpenKeyExW(HKEY_LOCAL_MACHINE,
+                    L"SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Policies"
+                    L"\\System",
+                    0, KEY_READ, &key) == ERROR_SUCCESS) {
+    DWORD type, value, size = sizeof(value);
+    if (RegQueryValueExW(key, L"InactivityTimeoutSecs", 0, &type,
+                         (BYTE *)&value, &size) == ERROR_SUCCESS &&
+        type == REG_DWORD) {
+      out->lock = (int)value;
+    }
+    RegCloseKey(key);
+  }
+  out->application = state->appTimeout;
+}
+
+/* works the automatic interval out again, from idle timeouts which are read
+ * again as well. returns true if the interval changed. */
+static bool updateAutoInterval(struct AppState *state) {
+  readIdleTimeouts(state, &state->idleTimeouts);
+  const int intervalMs = idleAutoIntervalMs(&state->idleTimeouts);
+  if (intervalMs == state->autoIntervalMs) {
+    return false;
+  }
+  state->autoIntervalMs = intervalMs;
+  return true;
+}
+
+/* follows a change of any of the settings which the idle timeouts come from.
+ * the ticks only change if they come at the automatic interval, but the menu
+ * always shows what it is. */
+static void onIdleTimeoutsChanged(struct AppState *state) {
+  if (updateAutoInterval(state)) {
+    if (state->autoInterval) {
+      publishSettings(state);
+    }
+    updateIntervalItems(state);
+  }
+}
+
+static bool isDisplayStateSetting(const GUID *guid) {
+  return memcmp(guid, &ConsoleDisplayStateGuid, sizeof(*guid)) == 0 ||
+         memcmp(guid, &MonitorPowerOnGuid, sizeof(*guid)) == 0;
+}
+
+static void onPowerBroadcast(struct AppState *state, WPARAM event,
+                             LPARAM lparam) {
+  switch (event) {
+  case PBT_APMSUSPEND:
+    setParked(state, PARK_SUSPENDED, true);
+    break;
+  /* PBT_APMRESUMEAUTOMATIC is always sent on resume, while
+   * PBT_APMRESUMESUSPEND is only sent when the resume was caused by the
+   * user. */
+  case PBT_APMRESUMEAUTOMATIC:
+  case PBT_APMRESUMESUSPEND:
+    setParked(state, PARK_SUSPENDED, false);
+    break;
+  /* switching between AC and DC power switches between two sets of power
+   * plan timeouts. */
+  case PBT_APMPOWERSTATUSCHANGE:
+    onIdleTimeoutsChanged(state);
+    break;
+  case PBT_POWERSETTINGCHANGE: {
+    /* the display state is also sent once right after registering. the other
+     * settings that we register for are the power plan's timeouts, which are
+     * just read again, along with the other idle timeouts. */
+    const struct DisplayStateSetting *setting = (const void *)lparam;
+    if (!isDisplayStateSetting(&setting->powerSetting)) {
+      onIdleTimeoutsChanged(state);
+    } else if (setting->dataLength >= sizeof(setting->data)) {
+      setParked(state, PARK_DISPLAY_OFF, setting->data == 0);
+    }
+    break;
+  }
+  }
+}
+
+static void registerPowerNotifications(struct AppState *state) {
+  /* failing any of these isn't fatal : the ticks just don't get parked in the
+   * corresponding states. */
+  WTSRegisterSessionNotification(state->wnd, NOTIFY_FOR_THIS_SESSION);
+
+  /* RegisterPowerSettingNotification() only exists since Vista, and
+   * GUID_CONSOLE_DISPLAY_STATE only since Windows 8. XP doesn't tell anybody
+   * about the display being turned off. */
+  typedef void *(WINAPI * RegisterFn)(HANDLE, const GUID *, DWORD);
+  RegisterFn registerFn = (RegisterFn)GetProcAddress(
+      GetModuleHandleW(L"user32.dll"), "RegisterPowerSettingNotification");
+  if (registerFn == 0) {
+    return;
+  }
+  state->displayNotification = registerFn(
+      state->wnd, &ConsoleDisplayStateGuid, DEVICE_NOTIFY_WINDOW_HANDLE);
+  if (state->displayNotification == 0) {
+    state->displayNotification = registerFn(state->wnd, &MonitorPowerOnGuid,
+                                            DEVICE_NOTIFY_WINDOW_HANDLE);
+  }
+  const GUID *const planSettings[ARRAYSIZE(state->planNotifications)] = {
+      &VideoPowerdownTimeoutGuid, &StandbyTimeoutGuid, &ActivePowerSchemeGuid};
+  for (int i = 0; i < ARRAYSIZE(planSettings); ++i) {
+    state->planNotifications[i] =
+        registerFn(state->wnd, planSettings[i], DEVICE_NOTIFY_WINDOW_HANDLE);
+  }
+}
+
+static void unregisterPowerNotifications(struct AppState *state) {
+  WTSUnRegisterSessionNotification(state->wnd);
+  typedef BOOL(WINAPI * UnregisterFn)(void *);
+  UnregisterFn unregisterFn = (UnregisterFn)GetProcAddress(
+      GetModuleHandleW(L"user32.dll"), "UnregisterPowerSettingNotification");
+  if (unregisterFn == 0) {
+    return;
+  }
+  if (state->displayNotification) {
+    unregisterFn(state->displayNotification);
+    state->displayNotification = 0;
+  }
+  for (int i = 0; i < ARRAYSIZE(state->planNotifications); ++i) {
+    if (state->planNotifications[i]) {
+      unregisterFn(state->planNotifications[i]);
+      state->planNotifications[i] = 0;
+    }
+  }
+}
+
+static void writeTraceChunk(void *ctx, const void *data, size_t len) {
+  DWORD written;
+  WriteFile(ctx, data, (DWORD)len, &written, 0);
+}
+
+static void startRecording(struct AppState *state) {
+  /* raw input reports the relative motion of the mouse itself, before any
+   * pointer acceleration is applied, which is what the trace needs to
+   * contain. RIDEV_INPUTSINK keeps it coming while our window, which is never
+   * shown, isn't in the foreground. */
+  HANDLE file = CreateFileW(state->worker.recordPath, GENERIC_WRITE, 0, 0,
+                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  RAWINPUTDEVICE device;
+  device.usUsagePage = 0x01; /* generic desktop controls */
+  device.usUsage = 0x02;     /* mouse */
+  device.dwFlags = RIDEV_INPUTSINK;
+  device.hwndTarget = state->wnd;
+  if (!RegisterRawInputDevices(&device, 1, sizeof(device))) {
+    CloseHandle(file);
+    DeleteFileW(state->worker.recordPath);
+    return;
+  }
+  state->recordFile = file;
+  traceWriterInit(&state->recorder, writeTraceChunk, file);
+}
+
+static void stopRecording(struct AppState *state) {
+  RAWINPUTDEVICE device;
+  device.usUsagePage = 0x01;
+  device.usUsage = 0x02;
+  device.dwFlags = RIDEV_REMOVE;
+  device.hwndTarget = 0;
+  RegisterRawInputDevices(&device, 1, sizeof(device));
+  traceWriterFinish(&state->recorder);
+  CloseHandle(state->recordFile);
+  state->recordFile = 0;
+  atomicStore(&state->worker.settings.traceRecorded, 1);
+  SetEvent(state->worker.wakeEvent);
+}
+
+static void onRawInput(struct AppState *state, HRAWINPUT handle) {
+  /* the input that we inject ourselves comes through raw input as well, but
+   * without any device : it's left out, as it's the user's movement that's
+   * being recorded. devices reporting absolute positions, such as tablets,
+   * are left out as well. */
+  RAWINPUT input;
+  UINT size = sizeof(input);
+  if (GetRawInputData(handle, RID_INPUT, &input, &size,
+                      sizeof(RAWINPUTHEADER)) == (UINT)-1 ||
+      input.header.dwType != RIM_TYPEMOUSE || input.header.hDevice == 0 ||
+      (input.data.mouse.usFlags & MOUSE_MOVE_ABSOLUTE)) {
+    return;
+  }
+  if (input.data.mouse.lLastX || input.data.mouse.lLastY) {
+    traceWriterAdd(&state->recorder, GetMessageTime(),
+                   input.data.mouse.lLastX, input.data.mouse.lLastY);
+  }
+}
+
+static void onMenuItemClicked(int itemId, struct AppState *state, HWND wnd) {
+  if (itemId == IDM_QUIT) {
+    /* this seems to be the most "proper" way of asking the application to
+     * terminate itself :
+     * - using any standard C facilities is out of the question, since they kill
+     * the process instantly and don't let the message queue terminate properly,
+     * - PostQuitMessage() will lead to memory leaks since the window is never
+     * actually destroyed, as the message queue processing instantly ends after
+     * receiving such a message, having no chance to actually process any
+     * destruction-related messages.
+     * - sending a window a WM_DESTROY message is "is like prank calling
+     * somebody pretending to be the police" according to Raymond Chen, whom I
+     * dare not doubt
+     * (https://devblogs.microsoft.com/oldnewthing/20110926-00/?p=9553)
+     * - the article mentioned above also mentions that the window functions's
+     * default behaviour (i.e. DefWindowProc's) is to call DestroyWindow() on a
+     * WM_CLOSE, which makes everything come together nicely.
+     */
+    SendMessage(wnd, WM_CLOSE, 0, 0);
+  } else if (itemId == IDM_ENABLED) {
+    toggleEnabled(state);
+  } else if (itemId == IDM_PRECISE) {
+    setPreciseTiming(state, !state->precise);
+  } else if (itemId == IDM_PAUSE_WHILE_ACTIVE) {
+    state->pauseWhileActive ^= 1;
+    publishSettings(state);
+    updateCheckedItem(state, IDM_PAUSE_WHILE_ACTIVE, state->pauseWhileActive);
+  } else if (itemId == IDM_SMOOTH) {
+    state->smooth ^= 1;
+    publishSettings(state);
+    updateCheckedItem(state, IDM_SMOOTH, state->smooth);
+  } else if (itemId == IDM_ABSOLUTE) {
+    state->absolute ^= 1;
+    publishSettings(state);
+    updateCheckedItem(state, IDM_ABSOLUTE, state->absolute);
+  } else if (itemId == IDM_RECORD) {
+    if (state->recordFile) {
+      stopRecording(state);
+    } else {
+      startRecording(state);
+    }
+    updateCheckedItem(state, IDM_RECORD, state->recordFile != 0);
+  } else if (itemId == IDM_REPLAY) {
+    state->replay ^= 1;
+    publishSettings(state);
+    updateCheckedItem(state, IDM_REPLAY, state->replay);
+  } else if (itemId == IDM_KEEP_AWAKE) {
+    state->keepAwake ^= 1;
+    updateKeepAwake(state);
+    /* the ticks might not have been parked or unparked, but the setting
+     * still needs to be saved. */
+    publishSettings(state);
+    updateCheckedItem(state, IDM_KEEP_AWAKE, state->keepAwake);
+  } else if (itemId == IDM_BACKGROUND) {
+    state->background ^= 1;
+    updateBackground(state);
+    publishSettings(state);
+    updateCheckedItem(state, IDM_BACKGROUND, state->background);
+  } else if (itemId >= IDM_PATTERN_START && itemId < IDM_PATTERN_END) {
+    state->pattern = itemId - IDM_PATTERN_START;
+    publishSettings(state);
+    updatePatternItems(state);
+  } else if (itemId >= IDM_INTERVAL_START && itemId < IDM_INTERVAL_END) {
+    setNewInterval(state, predefIntervals[itemId - IDM_INTERVAL_START]);
+  } else if (itemId == IDM_INTERVAL_CUSTOM) {
+    int interval = getCustomInterval(state);
+    if (interval != -1) {
+      setNewInterval(state, interval);
+    }
+  } else if (itemId == IDM_INTERVAL_AUTO) {
+    state->autoInterval = true;
+    publishSettings(state);
+    updateIntervalItems(state);
+  } else if (itemId >= IDM_DELTA_START && itemId < IDM_DELTA_END) {
+    setNewDelta(state, predefDeltas[itemId - IDM_DELTA_START]);
+  } else if (itemId == IDM_DELTA_CUSTOM) {
+    int delta = getCustomDelta(state);
+    if (delta != -1) {
+      setNewDelta(state, delta);
+    }
+  }
+}
+
+#ifndef NDEBUG
+static void reportMenuLatency(struct AppState *state) {
+  /* the time from the click on the notification icon until the menu's modal
+   * loop is entered, right before the menu is drawn. this goes to the
+   * debugger, or to anything else which listens to debug output, such as
+   * DebugView. */
+  const long long us =
+      qpcToUs(&state->worker, qpcNow() - state->menuRequestQpc);
+  state->menuRequestQpc = 0;
+  wchar_t buf[64];
+  formatW(buf, ARRAYSIZE(buf), L"La Flor : menu opened in %d us\n", (int)us);
+  OutputDebugStringW(buf);
+}
+#endif
+
+static LRESULT onTaskbarIconEvent(struct AppState *state, HWND wnd, UINT msg) {
+  switch (msg) {
+  case WM_RBUTTONUP: {
+    if (state->inputDialogActive) {
+      break;
+    }
+#ifndef NDEBUG
+    state->menuRequestQpc = qpcNow();
+#endif
+    /* the version of Shell_NotifyIcon that we use does not support passing any
+     * extra information about the location of the related event, so we need to
+     * call GetCursorPos() ourselves. see further comments about this. */
+    POINT position;
+    GetCursorPos(&position);
+
+    /* the documentation for TrackPopupMenuEx() notes in its "Remarks" section
+     * that it will be impossible for the user to dismiss the menu by clicking
+     * away from it, unless the window associated with the menu is the current
+     * foreground window. I actually observed this as far back as Windows XP,
+     * and even Wine.
+     *
+     * to be truthfully honest, I have no idea if this is okay to just call this
+     * function blindly like this, but our window isn't visible anyway : it is
+     * never shown and has no size, so it cannot take any input events as far
+     * as I'm aware. however, setting
+     * it as foreground seems to work correctly with regard to how the
+     * notification icon menu behaves. */
+    SetForegroundWindow(wnd);
+
+    updateStatsItems(state);
+    /* TrackPopupMenuEx() doesn't return until the menu is closed - the message
+     * loop is not blocked, so it must run its own loop inside. this means that
+     * it's possible to "wait" for the user's input : we leverage this by
+     * setting TPM_RETURNCMD, which conveniently returns the selected item ID as
+     * the function's return value. */
+    int menuRv = TrackPopupMenuEx(state->menu, TPM_RIGHTBUTTON | TPM_RETURNCMD,
+                                  position.x, position.y, wnd, 0);
+    if (menuRv != 0) {
+      onMenuItemClicked(menuRv, state, wnd);
+    }
+    break;
+  }
+  case WM_LBUTTONDBLCLK:
+    toggleEnabled(state);
+    break;
+  case WM_MOUSEMOVE:
+    updateTooltip(state);
+    break;
+  }
+  return 0;
+}
+
+/* appends a line with the statistics and the current settings to the response
+ * of a control request. the values are printed as key=value pairs, which are
+ * easy to pick apart from a script, with all the times in microseconds. room
+ * is always kept for the final "ok". */
+static void controlAppendStats(struct AppState *state,
+                               struct ControlRequest *request) {
+  const int room =
+      CONTROL_MAX_MESSAGE - request->responseLen - (int)sizeof("ok\n");
+  if (room <= 1) {
+    return;
+  }
+  struct WorkerStats stats;
+  readStats(&state->worker, &stats);
+  const struct TickStats *ticks = &stats.ticks;
+  const long long avg = ticks->ticks ? ticks->jitterSumUs / ticks->ticks : 0;
+  char *out = request->response + request->responseLen;
+  formatA(out, room,
+          "enabled=%d parked=%d interval=%d auto=%d delta=%d ticks=%d "
+          "missed=%d skipped=%lu jitterAvgUs=%d jitterP99Us=%d "
+          "jitterMaxUs=%d wakeupsPerHour=%lu failed=%lu blocked=%d\n",
+          state->active, state->parkReasons != 0, tickInterval(state),
+          state->autoInterval, state->delta, (int)ticks->ticks,
+          (int)ticks->missed, stats.skippedTicks, (int)avg,
+          (int)schedulerJitterPercentileUs(ticks, 99),
+          (int)ticks->jitterMaxUs,
+          wakeupsPerHour(&state->worker, stats.wakeups), stats.failedTicks,
+          stats.injectionBlocked);
+  request->responseLen += lstrlenA(out);
+}
+
+/* runs a whole batch of commands which has already been parsed. the settings
+ * are only published once, after all the commands have been applied, so the
+ * injection thread sees the batch as a single change. "request" is null when
+ * there's nobody to answer to, in which case "stats" does nothing. */
+static void runControlBatch(struct AppState *state,
+                            const struct ControlCommand *commands, int count,
+                            struct ControlRequest *request) {
+  const bool wasActive = state->active;
+  for (int i = 0; i < count; ++i) {
+    switch (commands[i].op) {
+    case CONTROL_SET_INTERVAL:
+      state->interval = commands[i].value;
+      state->autoInterval = false;
+      break;
+    case CONTROL_SET_DELTA:
+      state->delta = commands[i].value;
+      break;
+    case CONTROL_ENABLE:
+      state->active = true;
+      break;
+    case CONTROL_DISABLE:
+      state->active = false;
+      break;
+    case CONTROL_BACKGROUND:
+      state->background = true;
+      break;
+    case CONTROL_FOREGROUND:
+      state->background = false;
+      break;
+    case CONTROL_QUERY_STATS:
+      if (request) {
+        controlAppendStats(state, request);
+      }
+      break;
+    }
+  }
+  updateBackground(state);
+  publishSettings(state);
+  updateIntervalItems(state);
+  updateDeltaItems(state);
+  updateCheckedItem(state, IDM_BACKGROUND, state->background);
+  if (state->active != wasActive) {
+    updateEnabledItems(state);
+    changeNotificationIcon(state->app, state->wnd, state->active);
+  }
+}
+
+/* handles a request received by the control pipe thread. a batch that doesn't
+ * parse is rejected as a whole, without any of its commands being run. */
+static void handleControlRequest(struct AppState *state,
+                                 struct ControlRequest *request) {
+  struct ControlCommand commands[CONTROL_MAX_COMMANDS];
+  size_t errorAt;
+  const int count = controlParse(request->text, request->textLen, commands,
+                                 CONTROL_MAX_COMMANDS, &errorAt);
+  request->responseLen = 0;
+  if (count < 0) {
+    formatA(request->response, CONTROL_MAX_MESSAGE,
+            "error : bad command at offset %d, nothing was changed\n",
+            (int)errorAt);
+  } else {
+    runControlBatch(state, commands, count, request);
+    lstrcpyA(request->response + request->responseLen, "ok\n");
+  }
+  request->responseLen = lstrlenA(request->response);
+}
+
+/* converts the command line to UTF-8, which is what goes through the control
+ * pipe. returns the length of the converted text, or -1 if it's too long. */
+static int commandLineToUtf8(const wchar_t *cmdLine, char *buf, int bufLen) {
+  const int len = WideCharToMultiByte(CP_UTF8, 0, cmdLine, -1, buf, bufLen,
+                                      0, 0);
+  return len == 0 ? -1 : len - 1;
+}
+
+/* applies the command line arguments given to the first instance, the same way
+ * that they'd be applied if they were forwarded by another instance. there's
+ * nowhere to report errors to, so invalid arguments are just ignored. */
+static void runCommandLine(struct AppState *state, const wchar_t *cmdLine) {
+  char text[CONTROL_MAX_MESSAGE];
+  const int len = commandLineToUtf8(cmdLine, text, sizeof(text));
+  struct ControlCommand commands[CONTROL_MAX_COMMANDS];
+  size_t errorAt;
+  const int count =
+      len < 0 ? -1
+              : controlParse(text, len, commands, CONTROL_MAX_COMMANDS,
+                             &errorAt);
+  if (count > 0) {
+    runControlBatch(state, commands, count, 0);
+  }
+}
+
+static void controlPipeName(wchar_t *buf, int bufLen) {
+  /* pipe names are global, while La Flor runs once per session : the session
+   * ID keeps instances running in different sessions, e.g. with fast user
+   * switching, from talking to each other. */
+  DWORD session = 0;
+  ProcessIdToSessionId(GetCurrentProcessId(), &session);
+  formatW(buf, bufLen, L"\\\\.\\pipe\\LaFlor-%lu", session);
+}
+
+static HANDLE createControlPipe(const wchar_t *name) {
+  /* only a single instance of the pipe is ever created, and
+   * FILE_FLAG_FIRST_PIPE_INSTANCE makes this fail if somebody else got to the
+   * name first, instead of them getting to see our clients' commands. the
+   * default security descriptor of a pipe only gives write access to its
+   * creator, the administrators and the system.
+   *
+   * PIPE_REJECT_REMOTE_CLIENTS only exists since Vista, and versions which
+   * don't know about it may refuse it as an invalid parameter. we can do
+   * without it there. */
+  const DWORD openMode =
+      PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE;
+  const DWORD pipeMode = PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT;
+  HANDLE rv = CreateNamedPipeW(name, openMode,
+                               pipeMode | PIPE_REJECT_REMOTE_CLIENTS, 1,
+                               CONTROL_MAX_MESSAGE, CONTROL_MAX_MESSAGE, 0, 0);
+  if (rv == INVALID_HANDLE_VALUE &&
+      GetLastError() == ERROR_INVALID_PARAMETER) {
+    rv = CreateNamedPipeW(name, openMode, pipeMode, 1, CONTROL_MAX_MESSAGE,
+                          CONTROL_MAX_MESSAGE, 0, 0);
+  }
+  return rv;
+}
+
+/* waits for an overlapped operation on the pipe to complete. "error" is what
+ * the function starting the operation failed with, or ERROR_SUCCESS if it
+ * didn't. returns false if the operation failed, or if it was cancelled
+ * because the server is being stopped or because the client took too long. */
+static bool controlWaitIo(struct ControlServer *server, OVERLAPPED *ov,
+                          DWORD error, DWORD timeoutMs, DWORD *bytes) {
+  if (error != ERROR_SUCCESS && error != ERROR_IO_PENDING) {
+    return false;
+  }
+  const HANDLE handles[] = {ov->hEvent, server->stopEvent};
+  if (WaitForMultipleObjects(2, handles, FALSE, timeoutMs) != WAIT_OBJECT_0) {
+    /* the operation must be over before the OVERLAPPED structure, or the
+     * buffer it uses, can be used again. */
+    CancelIo(server->pipe);
+    GetOverlappedResult(server->pipe, ov, bytes, TRUE);
+    return false;
+  }
+  return GetOverlappedResult(server->pipe, ov, bytes, FALSE);
+}
+
+static DWORD ioError(BOOL rv) { return rv ? ERROR_SUCCESS : GetLastError(); }
+
+static void serveControlClient(struct ControlServer *server, OVERLAPPED *ov) {
+  /* the pipe is in message mode : a whole batch of commands arrives in a
+   * single read, and a batch longer than the buffer fails with
+   * ERROR_MORE_DATA, which just drops the client. */
+  struct ControlRequest *request = &server->request;
+  DWORD bytes;
+  BOOL rv = ReadFile(server->pipe, request->text, sizeof(request->text), 0, ov);
+  if (!controlWaitIo(server, ov, ioError(rv), CONTROL_CLIENT_TIMEOUT_MS,
+                     &bytes)) {
+    return;
+  }
+  request->textLen = bytes;
+
+  /* the request is handled by the UI thread, which owns the settings and the
+   * menu. SendMessageW() fails without calling the window procedure if the
+   * window is already gone, in which case this response is sent back. */
+  lstrcpyA(request->response, "error : La Flor is exiting\n");
+  request->responseLen = lstrlenA(request->response);
+  SendMessageW(server->wnd, WM_CONTROL_REQUEST, 0, (LPARAM)request);
+
+  rv = WriteFile(server->pipe, request->response, request->responseLen, 0, ov);
+  if (!controlWaitIo(server, ov, ioError(rv), CONTROL_CLIENT_TIMEOUT_MS,
+                     &bytes)) {
+    return;
+  }
+  /* DisconnectNamedPipe() throws away anything that the client hasn't read
+   * yet, so the client is given a chance to close its end first : this read
+   * only completes once it has. */
+  rv = ReadFile(server->pipe, request->text, sizeof(request->text), 0, ov);
+  controlWaitIo(server, ov, ioError(rv), CONTROL_CLIENT_TIMEOUT_MS, &bytes);
+}
+
+static DWORD WINAPI controlThreadMain(void *param) {
+  struct ControlServer *server = param;
+  OVERLAPPED ov;
+  memset(&ov, 0, sizeof(ov));
+  ov.hEvent = CreateEventW(0, TRUE, FALSE, 0);
+  if (ov.hEvent == 0) {
+    return 1;
+  }
+  for (;;) {
+    /* a client which connected before ConnectNamedPipe() was called shows up
+     * as ERROR_PIPE_CONNECTED, or as ERROR_NO_DATA if it already went away :
+     * either way, it's served right away. */
+    DWORD bytes;
+    const DWORD error = ioError(ConnectNamedPipe(server->pipe, &ov));
+    if (error == ERROR_PIPE_CONNECTED || error == ERROR_NO_DATA ||
+        controlWaitIo(server, &ov, error, INFINITE, &bytes)) {
+      serveControlClient(server, &ov);
+      DisconnectNamedPipe(server->pipe);
+    } else {
+      /* either the server is being stopped, or the pipe is broken beyond
+       * repair. La Flor keeps running without a control plane in the latter
+       * case. */
+      break;
+    }
+  }
+  CloseHandle(ov.hEvent);
+  return 0;
+}
+
+/* starts serving the control pipe. failing to do so isn't fatal : La Flor just
+ * can't be controlled from the outside then. */
+static void startControlServer(struct ControlServer *server, HWND wnd) {
+  wchar_t name[64];
+  controlPipeName(name, ARRAYSIZE(name));
+  server->wnd = wnd;
+  server->pipe = createControlPipe(name);
+  if (server->pipe == INVALID_HANDLE_VALUE) {
+    server->pipe = 0;
+    return;
+  }
+  server->stopEvent = CreateEventW(0, TRUE, FALSE, 0);
+  if (server->stopEvent) {
+    server->thread = CreateThread(0, 0, controlThreadMain, server, 0, 0);
+  }
+}
+
+static void stopControlServer(struct ControlServer *server) {
+  if (server->thread) {
+    SetEvent(server->stopEvent);
+    /* this is called on the UI thread, and the control thread might be in the
+     * middle of sending it a request : sent messages must keep being handled
+     * while waiting, or both threads would end up waiting for each other. */
+    while (MsgWaitForMultipleObjects(1, &server->thread, FALSE, INFINITE,
+                                     QS_SENDMESSAGE) == WAIT_OBJECT_0 + 1) {
+      MSG msg;
+      PeekMessageW(&msg, 0, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+    }
+    CloseHandle(server->thread);
+  }
+  if (server->stopEvent) {
+    CloseHandle(server->stopEvent);
+  }
+  if (server->pipe) {
+    CloseHandle(server->pipe);
+  }
+}
+
+/* writes the response of the running instance where the user can see it. GUI
+ * applications don't get a console : the standard output is only usable when
+ * it's been redirected to a file or a pipe. otherwise, the response goes to
+ * the console of whoever started us, if there's one. */
+static void printForwardResponse(const char *text, DWORD len) {
+  HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+  bool attached = false;
+  if ((out == 0 || out == INVALID_HANDLE_VALUE) &&
+      AttachConsole(ATTACH_PARENT_PROCESS)) {
+    out = CreateFileW(L"CONOUT$", GENERIC_WRITE, FILE_SHARE_WRITE, 0,
+                      OPEN_EXISTING, 0, 0);
+    attached = true;
+  }
+  if (out == 0 || out == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  DWORD written;
+  WriteFile(out, text, len, &written, 0);
+  if (attached) {
+    CloseHandle(out);
+  }
+}
+
+/* forwards the command line of a second instance to the one already running,
+ * and returns the exit code of the second instance : zero if the commands
+ * were run, one otherwise. launching a second instance without any arguments
+ * does nothing at all. */
+static int forwardCommandLine(const wchar_t *cmdLine) {
+  char text[CONTROL_MAX_MESSAGE];
+  const int len = commandLineToUtf8(cmdLine, text, sizeof(text));
+  if (len <= 0) {
+    return len == 0 ? 0 : 1;
+  }
+  wchar_t name[64];
+  controlPipeName(name, ARRAYSIZE(name));
+  char response[CONTROL_MAX_MESSAGE];
+  DWORD responseLen;
+  /* CallNamedPipeW() connects, sends the whole batch as one message, reads the
+   * response and disconnects, all in one go. */
+  if (!CallNamedPipeW(name, text, len, response, sizeof(response),
+                      &responseLen, CONTROL_CLIENT_TIMEOUT_MS)) {
+    return 1;
+  }
+  printForwardResponse(response, responseLen);
+  return responseLen >= 5 && memcmp(response, "error", 5) == 0;
+}
+
+static const wchar_t LaFlorRegistryKey[] = L"SOFTWARE\\xavery\\LaFlor";
+
+static int registryReadInteger(HKEY key, const wchar_t *subkey, int *rv) {
+  unsigned int type;
+  unsigned char buf[sizeof(int)];
+  unsigned int bufsize = sizeof(buf);
+
+  const LSTATUS stat = RegQueryValueExW(key, subkey, 0, &type, buf, &bufsize);
+  if (stat == ERROR_SUCCESS && type == REG_DWORD) {
+    memcpy(rv, buf, sizeof(*rv));
+    return 0;
+  } else {
+    return 1;
+  }
+}
+
+/* the names of the settings are plain ASCII, which is widened for the registry
+ * functions. */
+static void configKeyNameW(enum ConfigKey key, wchar_t *buf, int bufLen) {
+  const char *name = configKeyName(key);
+  int i = 0;
+  for (; name[i] && i < bufLen - 1; ++i) {
+    buf[i] = name[i];
+  }
+  buf[i] = 0;
 }
 
-static LRESULT displayInputDialog(struct AppState *state, const wchar_t *title,
-                                  const wchar_t *label, const wchar_t *units,
-                                  int initialValue) {
-  unsigned char buf[8192] = {0};
+/* reads a string value, with any environment variables in it expanded. */
+static bool registryReadString(HKEY key, const wchar_t *name, wchar_t *buf,
+                               DWORD bufLen) {
+  wchar_t value[MAX_PATH];
+  DWORD type;
+  DWORD size = sizeof(value) - sizeof(wchar_t);
+  if (RegQueryValueExW(key, name, 0, &type, (BYTE *)value, &size) !=
+          ERROR_SUCCESS ||
+      (type != REG_SZ && type != REG_EXPAND_SZ)) {
+    return false;
+  }
+  value[size / sizeof(wchar_t)] = 0;
+  const DWORD len = ExpandEnvironmentStringsW(value, buf, bufLen);
+  if (len == 0 || len > bufLen) {
+    buf[0] = 0;
+    return false;
+  }
+  return true;
+}
 
-  const WORD buttonControl = 0x0080;
-  const WORD editControl = 0x0081;
-  const WORD staticControl = 0x0082;
+/* reads the settings kept in the registry, along with the two which are only
+ * ever kept there : the path of the configuration file to use instead, if
+ * there is one, and the applications watched in keep-awake mode. the path is
+ * the "configFile" value, which may contain environment variables, e.g.
+ * "%APPDATA%\LaFlor.ini" : this is what desktop management tools are meant to
+ * set. */
+static void registryReadConfig(struct AppState *state,
+                               struct ConfigValues *out) {
+  memset(out, 0, sizeof(*out));
+  state->configPath[0] = 0;
+  state->watchedApps[0] = 0;
+  HKEY key;
+  const LSTATUS ok =
+      RegOpenKeyExW(HKEY_CURRENT_USER, LaFlorRegistryKey, 0, KEY_READ, &key);
+  if (ok != ERROR_SUCCESS) {
+    return;
+  }
+  for (int i = 0; i < CONFIG_KEY_COUNT; ++i) {
+    wchar_t name[32];
+    configKeyNameW((enum ConfigKey)i, name, ARRAYSIZE(name));
+    int value;
+    if (registryReadInteger(key, name, &value) == 0) {
+      configSet(out, (enum ConfigKey)i, value);
+    }
+  }
+  registryReadString(key, L"configFile", state->configPath, MAX_PATH);
+  registryReadString(key, L"watchedApps", state->watchedApps,
+                     ARRAYSIZE(state->watchedApps));
+  RegCloseKey(key);
+}
 
-  void *dlg = initDLGTEMPLATEEX(buf, 0, 0,
-                                WS_POPUP | WS_SYSMENU | WS_CAPTION |
-                                    DS_MODALFRAME | DS_CENTERMOUSE,
-                                5, 10, 10, 100, 80, title);
+static bool registryWriteConfig(const struct ConfigValues *config) {
+  HKEY key;
+  const LSTATUS ok = RegCreateKeyExW(HKEY_CURRENT_USER, LaFlorRegistryKey, 0, 0,
+                                     0, KEY_WRITE, 0, &key, 0);
+  if (ok != ERROR_SUCCESS) {
+    return false;
+  }
+  for (int i = 0; i < CONFIG_KEY_COUNT; ++i) {
+    if (config->present & (1u << i)) {
+      wchar_t name[32];
+      configKeyNameW((enum ConfigKey)i, name, ARRAYSIZE(name));
+      RegSetValueExW(key, name, 0, REG_DWORD,
+                     (const BYTE *)&config->values[i], sizeof(int));
+    }
+  }
+  RegCloseKey(key);
+  return true;
+}
 
-  dlg = initDLGITEMTEMPLATEEX(dlg, 0, 0, WS_CHILD | WS_VISIBLE | SS_CENTER, 10,
-                              10, 80, 10, 0xdeadbeef, staticControl, label);
+/* reads the configuration file through a mapping, and parses it in one go,
+ * straight from the mapped view. "*busy" is set if the file couldn't be
+ * opened because somebody else is still writing it. */
+static bool readConfigFile(const wchar_t *path, struct ConfigValues *out,
+                           bool *busy) {
+  *busy = false;
+  HANDLE file = CreateFileW(path, GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                FILE_SHARE_DELETE,
+                            0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  if (file == INVALID_HANDLE_VALUE) {
+    *busy = GetLastError() == ERROR_SHARING_VIOLATION;
+    return false;
+  }
+  /* an empty file can't be mapped, but it's a perfectly valid configuration,
+   * which just doesn't set anything. */
+  const DWORD size = GetFileSize(file, 0);
+  bool rv = false;
+  if (size == 0) {
+    memset(out, 0, sizeof(*out));
+    rv = true;
+  } else if (size != INVALID_FILE_SIZE && size <= CONFIG_MAX_FILE_SIZE) {
+    HANDLE mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+    const void *view =
+        mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+    if (view) {
+      const int errors = configParse(view, size, out);
+      if (errors) {
+        wchar_t buf[96];
+        formatW(buf, ARRAYSIZE(buf),
+                L"La Flor : %d lines of the configuration file ignored\n",
+                errors);
+        OutputDebugStringW(buf);
+      }
+      UnmapViewOfFile(view);
+      rv = true;
+    }
+    if (mapping) {
+      CloseHandle(mapping);
+    }
+  }
+  CloseHandle(file);
+  return rv;
+}
 
-  wchar_t initialValStr[16];
-  swprintf(initialValStr, ARRAYSIZE(initialValStr), L"%d", initialValue);
-  dlg = initDLGITEMTEMPLATEEX(dlg, 0, 0, WS_CHILD | WS_VISIBLE | ES_NUMBER, 10,
-                              30, 60, 10, ID_EDIT, editControl, initialValStr);
-  dlg = initDLGITEMTEMPLATEEX(dlg, 0, 0, WS_CHILD | WS_VISIBLE | SS_LEFT, 75,
-                              30, 10, 10, 0xdeadc0de, staticControl, units);
-  dlg =
-      initDLGITEMTEMPLATEEX(dlg, 0, 0, WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON,
-                            10, 50, 20, 20, IDOK, buttonControl, L"OK");
-  dlg =
-      initDLGITEMTEMPLATEEX(dlg, 0, 0, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
-                            50, 50, 30, 20, IDCANCEL, buttonControl, L"Cancel");
+/* writes the configuration file by replacing it with a complete new one, so
+ * that nobody ever reads a half-written file, and nothing is lost if La Flor
+ * dies in the middle of it. */
+static bool writeConfigFile(const wchar_t *path,
+                            const struct ConfigValues *config) {
+  char text[1024];
+  const size_t len = configFormat(text, sizeof(text), config);
+  wchar_t tempPath[MAX_PATH];
+  if (len == 0 ||
+      formatW(tempPath, MAX_PATH, L"%s.new", path) >= MAX_PATH - 1) {
+    return false;
+  }
+  HANDLE file = CreateFileW(tempPath, GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, 0);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  DWORD written;
+  const bool ok = WriteFile(file, text, (DWORD)len, &written, 0) &&
+                  written == len && FlushFileBuffers(file);
+  CloseHandle(file);
+  if (!ok || !MoveFileExW(tempPath, path, MOVEFILE_REPLACE_EXISTING)) {
+    DeleteFileW(tempPath);
+    return false;
+  }
+  return true;
+}
 
-  state->inputDialogActive = true;
-  LRESULT rv = DialogBoxIndirectW(state->app, (const DLGTEMPLATE *)buf,
-                                  state->wnd, inputDialogProc);
-  state->inputDialogActive = false;
-  return rv;
+/* the settings of the UI thread's state, in the form that they're saved in.
+ * the settings without a menu item are only included when they're not at
+ * their defaults, so that they never end up saved unless somebody set them on
+ * purpose. */
+static void stateToConfig(const struct AppState *state,
+                          struct ConfigValues *out) {
+  memset(out, 0, sizeof(*out));
+  configSet(out, CONFIG_ACTIVE, state->active);
+  configSet(out, CONFIG_INTERVAL, state->interval);
+  configSet(out, CONFIG_DELTA, state->delta);
+  configSet(out, CONFIG_PRECISE, state->precise);
+  configSet(out, CONFIG_PAUSE_WHILE_ACTIVE, state->pauseWhileActive);
+  configSet(out, CONFIG_SMOOTH, state->smooth);
+  configSet(out, CONFIG_ABSOLUTE, state->absolute);
+  configSet(out, CONFIG_REPLAY, state->replay);
+  configSet(out, CONFIG_PATTERN, state->pattern);
+  if (state->reconcileEvery != MOTION_DEFAULT_RECONCILE_EVERY) {
+    configSet(out, CONFIG_RECONCILE_EVERY, state->reconcileEvery);
+  }
+  if (state->timerToleranceMs != DEFAULT_TIMER_TOLERANCE_MS) {
+    configSet(out, CONFIG_TIMER_TOLERANCE_MS, state->timerToleranceMs);
+  }
+  if (state->scrollEvery != 0) {
+    configSet(out, CONFIG_SCROLL_EVERY, state->scrollEvery);
+  }
+  if (!state->spreadTicks) {
+    configSet(out, CONFIG_SPREAD_TICKS, state->spreadTicks);
+  }
+  configSet(out, CONFIG_AUTO_INTERVAL, state->autoInterval);
+  if (state->appTimeout != 0) {
+    configSet(out, CONFIG_APP_TIMEOUT, state->appTimeout);
+  }
+  configSet(out, CONFIG_KEEP_AWAKE, state->keepAwake);
+  configSet(out, CONFIG_BACKGROUND, state->background);
 }
 
-static int getCustomInterval(struct AppState *state) {
-  int interval_sec = displayInputDialog(state, L"Custom interval",
-                                        L"Please enter the new interval", L"s",
-                                        state->interval / 1000);
-  return interval_sec * 1000;
+/* applies whichever settings are present, and valid, as a single change :
+ * they're published to the injection thread once, and each part of the menu
+ * is updated once, however many settings changed. */
+static void applyConfig(struct AppState *state,
+                        const struct ConfigValues *config) {
+  const bool wasActive = state->active;
+  for (int i = 0; i < CONFIG_KEY_COUNT; ++i) {
+    if ((config->present & (1u << i)) == 0) {
+      continue;
+    }
+    const int value = config->values[i];
+    switch ((enum ConfigKey)i) {
+    case CONFIG_ACTIVE:
+      state->active = value != 0;
+      break;
+    case CONFIG_INTERVAL:
+      state->interval =
+          value >= SCHEDULER_MIN_INTERVAL_MS ? value : state->interval;
+      break;
+    case CONFIG_DELTA:
+      state->delta = value > 0 ? value : state->delta;
+      break;
+    case CONFIG_PRECISE:
+      state->precise = value != 0 && state->worker.tickTimer;
+      break;
+    case CONFIG_PAUSE_WHILE_ACTIVE:
+      state->pauseWhileActive = value != 0;
+      break;
+    case CONFIG_SMOOTH:
+      state->smooth = value != 0;
+      break;
+    case CONFIG_ABSOLUTE:
+      state->absolute = value != 0;
+      break;
+    case CONFIG_REPLAY:
+      state->replay = value != 0;
+      break;
+    case CONFIG_PATTERN:
+      if (value >= 0 && value <= PATTERN_SCRIPT) {
+        state->pattern = value;
+      }
+      break;
+    /* how many ticks the cursor position may go without being queried in
+     * absolute mode, how late ticks may be, in milliseconds, outside of
+     * precise mode, 0 turning coalescing off, and how many seconds apart the
+     * scroll nudges are, 0 turning them off. there are no menu items for
+     * these, as they're only meant to be tweaked by people who know what
+     * they're doing. */
+    case CONFIG_RECONCILE_EVERY:
+      state->reconcileEvery = value > 0 ? value : state->reconcileEvery;
+      break;
+    case CONFIG_TIMER_TOLERANCE_MS:
+      state->timerToleranceMs = value >= 0 ? value : state->timerToleranceMs;
+      break;
+    case CONFIG_SCROLL_EVERY:
+      state->scrollEvery = value >= 0 ? value : state->scrollEvery;
+      break;
+    /* whether the ticks of the instances in the different sessions of the
+     * machine are spread over the interval, rather than all coming at once
+     * when they were all started at once. */
+    case CONFIG_SPREAD_TICKS:
+      state->spreadTicks = value != 0;
+      break;
+    /* how many seconds an application of the user's takes to go idle, for
+     * the automatic interval, 0 meaning that there's no such application. */
+    case CONFIG_APP_TIMEOUT:
+      state->appTimeout = value >= 0 ? value : state->appTimeout;
+      break;
+    case CONFIG_AUTO_INTERVAL:
+      state->autoInterval = value != 0;
+      break;
+    case CONFIG_KEEP_AWAKE:
+      state->keepAwake = value != 0;
+      break;
+    case CONFIG_BACKGROUND:
+      state->background = value != 0;
+      break;
+    case CONFIG_KEY_COUNT:
+      break;
+    }
+  }
+  updateAutoInterval(state);
+  updateBackground(state);
+  publishSettings(state);
+  updateIntervalItems(state);
+  updateDeltaItems(state);
+  updatePatternItems(state);
+  updateCheckedItem(state, IDM_PRECISE, state->precise);
+  updateCheckedItem(state, IDM_SMOOTH, state->smooth);
+  updateCheckedItem(state, IDM_ABSOLUTE, state->absolute);
+  updateCheckedItem(state, IDM_REPLAY, state->replay);
+  updateCheckedItem(state, IDM_KEEP_AWAKE, state->keepAwake);
+  updateCheckedItem(state, IDM_BACKGROUND, state->background);
+  if (state->active != wasActive) {
+    updateEnabledItems(state);
+    changeNotificationIcon(state->app, state->wnd, state->active);
+  }
+  updateKeepAwake(state);
 }
 
-static int getCustomDelta(struct AppState *state) {
-  return displayInputDialog(state, L"Custom delta",
-                            L"Please enter the new delta", L"px", state->delta);
+/* loads the settings at startup, from the configuration file if there's one,
+ * and from the registry otherwise. a configuration file which doesn't exist
+ * yet starts out with the settings from the registry, and is created the
+ * next time that the settings are saved. */
+static void loadSettings(struct AppState *state) {
+  struct ConfigValues config;
+  registryReadConfig(state, &config);
+  bool fromFile = false;
+  if (state->configPath[0]) {
+    bool busy;
+    fromFile = readConfigFile(state->configPath, &config, &busy);
+  }
+  applyConfig(state, &config);
+  if (state->configPath[0] && !fromFile) {
+    memset(&state->saved, 0, sizeof(state->saved));
+  } else {
+    stateToConfig(state, &state->saved);
+  }
 }
 
-static void toggleEnabled(struct AppState *state) {
-  state->active ^= 1;
-  setTimerEnabled(state, state->active);
-  changeNotificationIcon(state->app, state->wnd, state->active);
+/* saves the settings, unless they're the same as what was last read or
+ * written : most of the time, the timer only fires because the ticks were
+ * parked or unparked. */
+static void saveSettings(struct AppState *state) {
+  KillTimer(state->wnd, TIMER_SAVE);
+  struct ConfigValues config;
+  stateToConfig(state, &config);
+  if (configEqual(&config, &state->saved)) {
+    return;
+  }
+  const bool ok = state->configPath[0]
+                      ? writeConfigFile(state->configPath, &config)
+                      : registryWriteConfig(&config);
+  if (ok) {
+    state->saved = config;
+  }
 }
 
-static void onMenuItemClicked(int itemId, struct AppState *state, HWND wnd) {
-  if (itemId == IDM_QUIT) {
-    /* this seems to be the most "proper" way of asking the application to
-     * terminate itself :
-     * - using any standard C facilities is out of the question, since they kill
-     * the process instantly and don't let the message queue terminate properly,
-     * - PostQuitMessage() will lead to memory leaks since the window is never
-     * actually destroyed, as the message queue processing instantly ends after
-     * receiving such a message, having no chance to actually process any
-     * destruction-related messages.
-     * - sending a window a WM_DESTROY message is "is like prank calling
-     * somebody pretending to be the police" according to Raymond Chen, whom I
-     * dare not doubt
-     * (https://devblogs.microsoft.com/oldnewthing/20110926-00/?p=9553)
-     * - the article mentioned above also mentions that the window functions's
-     * default behaviour (i.e. DefWindowProc's) is to call DestroyWindow() on a
-     * WM_CLOSE, which makes everything come together nicely.
-     */
-    SendMessage(wnd, WM_CLOSE, 0, 0);
-  } else if (itemId == IDM_ENABLED) {
-    toggleEnabled(state);
-  } else if (itemId >= IDM_INTERVAL_START && itemId < IDM_INTERVAL_END) {
-    setNewInterval(state, predefIntervals[itemId - IDM_INTERVAL_START]);
-  } else if (itemId == IDM_INTERVAL_CUSTOM) {
-    int interval = getCustomInterval(state);
-    if (interval != -1) {
-      setNewInterval(state, interval);
+/* reloads the configuration file after it changed. only the settings which
+ * the file holds are applied, and only if any of them actually changed,
+ * which isn't the case when the change was La Flor saving the file itself. */
+static void reloadConfig(struct AppState *state) {
+  KillTimer(state->wnd, TIMER_RELOAD);
+  struct ConfigValues config;
+  bool busy;
+  if (!readConfigFile(state->configPath, &config, &busy)) {
+    /* somebody is still writing the file : try again a bit later. if the file
+     * is gone, the settings just stay as they are. */
+    if (busy) {
+      SetTimer(state->wnd, TIMER_RELOAD, RELOAD_DELAY_MS, 0);
     }
-  } else if (itemId >= IDM_DELTA_START && itemId < IDM_DELTA_END) {
-    setNewDelta(state, predefDeltas[itemId - IDM_DELTA_START]);
-  } else if (itemId == IDM_DELTA_CUSTOM) {
-    int delta = getCustomDelta(state);
-    if (delta != -1) {
-      setNewDelta(state, delta);
+    return;
+  }
+  struct ConfigValues current, merged;
+  stateToConfig(state, &current);
+  merged = current;
+  for (int i = 0; i < CONFIG_KEY_COUNT; ++i) {
+    if (config.present & (1u << i)) {
+      configSet(&merged, (enum ConfigKey)i, config.values[i]);
+    }
+  }
+  if (!configEqual(&merged, &current)) {
+    applyConfig(state, &config);
+  }
+  /* only the settings which the file holds are now known to be saved, as
+   * they've been applied, or rejected. any other change which is still
+   * waiting for TIMER_SAVE keeps differing from "saved", and gets written
+   * out as planned. */
+  stateToConfig(state, &current);
+  for (int i = 0; i < CONFIG_KEY_COUNT; ++i) {
+    const unsigned bit = 1u << i;
+    if ((config.present & bit) == 0) {
+      continue;
     }
+    state->saved.present =
+        (state->saved.present & ~bit) | (current.present & bit);
+    state->saved.values[i] = current.values[i];
   }
 }
 
-static LRESULT onTaskbarIconEvent(struct AppState *state, HWND wnd, UINT msg) {
-  switch (msg) {
-  case WM_RBUTTONUP: {
-    if (state->inputDialogActive) {
+static DWORD WINAPI configWatcherMain(void *param) {
+  struct ConfigWatcher *watcher = param;
+  HANDLE handles[2] = {watcher->stopEvent, watcher->change};
+  while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) ==
+         WAIT_OBJECT_0 + 1) {
+    PostMessageW(watcher->wnd, WM_CONFIG_CHANGED, 0, 0);
+    if (!FindNextChangeNotification(watcher->change)) {
       break;
     }
-    /* the version of Shell_NotifyIcon that we use does not support passing any
-     * extra information about the location of the related event, so we need to
-     * call GetCursorPos() ourselves. see further comments about this. */
-    POINT position;
-    GetCursorPos(&position);
-
-    /* the documentation for TrackPopupMenuEx() notes in its "Remarks" section
-     * that it will be impossible for the user to dismiss the menu by clicking
-     * away from it, unless the window associated with the menu is the current
-     * foreground window. I actually observed this as far back as Windows XP,
-     * and even Wine.
-     *
-     * to be truthfully honest, I have no idea if this is okay to just call this
-     * function blindly like this, but our window isn't visible anyway : it
-     * doesn't even have any graphical representation due to being message-only,
-     * so it cannot take any input events as far as I'm aware. however, setting
-     * it as foreground seems to work correctly with regard to how the
-     * notification icon menu behaves. */
-    SetForegroundWindow(wnd);
+  }
+  return 0;
+}
 
-    HMENU menu = createMenu(state);
-    /* TrackPopupMenuEx() doesn't return until the menu is closed - the message
-     * loop is not blocked, so it must run its own loop inside. this means that
-     * it's possible to "wait" for the user's input : we leverage this by
-     * setting TPM_RETURNCMD, which conveniently returns the selected item ID as
-     * the function's return value. */
-    int menuRv = TrackPopupMenuEx(menu, TPM_RIGHTBUTTON | TPM_RETURNCMD,
-                                  position.x, position.y, wnd, 0);
-    if (menuRv != 0) {
-      onMenuItemClicked(menuRv, state, wnd);
+/* starts watching the directory of the configuration file for changes. the
+ * notifications can't be narrowed down to a single file, so the UI thread
+ * gets told about any change in the directory, and only reloads the file if
+ * it changed anything. failing to watch isn't fatal : the file is then just
+ * read at startup. */
+static void startConfigWatcher(struct ConfigWatcher *watcher, HWND wnd,
+                               const wchar_t *path) {
+  wchar_t dir[MAX_PATH];
+  lstrcpynW(dir, path, MAX_PATH);
+  wchar_t *lastSlash = 0;
+  for (wchar_t *c = dir; *c; ++c) {
+    if (*c == L'\\' || *c == L'/') {
+      lastSlash = c;
     }
+  }
+  if (lastSlash == 0) {
+    return;
+  }
+  /* the root of a drive keeps its backslash. */
+  lastSlash[lastSlash > dir && lastSlash[-1] == L':' ? 1 : 0] = 0;
+  watcher->wnd = wnd;
+  watcher->change = FindFirstChangeNotificationW(
+      dir, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+  if (watcher->change == INVALID_HANDLE_VALUE) {
+    watcher->change = 0;
+    return;
+  }
+  watcher->stopEvent = CreateEventW(0, TRUE, FALSE, 0);
+  if (watcher->stopEvent) {
+    watcher->thread = CreateThread(0, 0, configWatcherMain, watcher, 0, 0);
+  }
+}
 
-    /* any menus not associated with a window must be explicitly destroyed.
-     * DestroyMenu() works recursively, i.e. it destroys any submenus as well.
-     */
-    DestroyMenu(menu);
-    break;
+static void stopConfigWatcher(struct ConfigWatcher *watcher) {
+  if (watcher->thread) {
+    SetEvent(watcher->stopEvent);
+    WaitForSingleObject(watcher->thread, INFINITE);
+    CloseHandle(watcher->thread);
   }
-  case WM_LBUTTONDBLCLK:
-    toggleEnabled(state);
-    break;
+  if (watcher->stopEvent) {
+    CloseHandle(watcher->stopEvent);
+  }
+  if (watcher->change) {
+    FindCloseChangeNotification(watcher->change);
   }
-  return 0;
 }
 
 static LRESULT CALLBACK windowProc(HWND wnd, UINT msg, WPARAM wparam,
@@ -512,15 +3428,74 @@ static LRESULT CALLBACK windowProc(HWND wnd, UINT msg, WPARAM wparam,
   struct AppState *state = (void *)GetWindowLongPtrW(wnd, GWLP_USERDATA);
   switch (msg) {
   case WM_DESTROY:
+    /* the notifications must be unregistered while the window exists. */
+    unregisterPowerNotifications(state);
+    stopKeepAwake(state);
+    if (state->recordFile) {
+      stopRecording(state);
+    }
     PostQuitMessage(0);
     return 0;
+  case WM_WTSSESSION_CHANGE:
+    onSessionChange(state, wparam, (DWORD)lparam);
+    return 0;
+  case WM_POWERBROADCAST:
+    onPowerBroadcast(state, wparam, lparam);
+    return TRUE;
+  case WM_INPUT:
+    /* DefWindowProcW() still needs to be called, in order to clean up after
+     * the input. */
+    if (state->recordFile) {
+      onRawInput(state, (HRAWINPUT)lparam);
+    }
+    break;
   case NOTIFYICON_ID:
     /* see comments in notifyIconDataCommonInit() */
     assert(wparam == NOTIFYICON_ID);
     return onTaskbarIconEvent(state, wnd, LOWORD(lparam));
+  case WM_CONTROL_REQUEST:
+    handleControlRequest(state, (struct ControlRequest *)lparam);
+    return 0;
   case WM_TIMER:
-    moveMouse(state);
+    if (wparam == TIMER_SAVE) {
+      saveSettings(state);
+    } else if (wparam == TIMER_RELOAD) {
+      reloadConfig(state);
+    }
     return 0;
+  case WM_INJECTION_CHANGED:
+    updateTooltip(state);
+    return 0;
+  case WM_CONFIG_CHANGED:
+    /* editors usually write a file in several steps, each of which is
+     * signaled : the file is only reloaded once they're all done. */
+    SetTimer(wnd, TIMER_RELOAD, RELOAD_DELAY_MS, 0);
+    return 0;
+#ifndef NDEBUG
+  case WM_ENTERMENULOOP:
+    if (state && state->menuRequestQpc) {
+      reportMenuLatency(state);
+    }
+    break;
+#endif
+  case WM_DISPLAYCHANGE:
+  case WM_SETTINGCHANGE:
+    /* WM_DISPLAYCHANGE is sent when the resolution of any monitor changes, but
+     * monitors being rearranged, added or removed is sometimes only signaled
+     * by WM_SETTINGCHANGE. rebuilding the layout is cheap enough to just do it
+     * on both. the layout belongs to the injection thread, which is just
+     * told to rebuild it. */
+    if (state) {
+      atomicStore(&state->worker.settings.layoutChanged, 1);
+      SetEvent(state->worker.wakeEvent);
+    }
+    /* the screen saver's timeout, and the machine inactivity limit, which
+     * comes with a group policy refresh, are signaled with WM_SETTINGCHANGE
+     * as well. reading the idle timeouts again is just as cheap. */
+    if (state && msg == WM_SETTINGCHANGE) {
+      onIdleTimeoutsChanged(state);
+    }
+    break;
   case WM_NCCREATE: {
     /* this message is sent to the window procedure before any other messages.
      * the lpCreateParams member of CREATESTRUCT is the last parameter
@@ -552,80 +3527,48 @@ static int removeNotificationIcon(HWND wnd) {
   return Shell_NotifyIconW(NIM_DELETE, &notifyIconData) == TRUE;
 }
 
-static const wchar_t LaFlorRegistryKey[] = L"SOFTWARE\\xavery\\LaFlor";
-
-static int registryReadInteger(HKEY key, const wchar_t *subkey, int *rv) {
-  unsigned int type;
-  unsigned char buf[sizeof(int)];
-  unsigned int bufsize = sizeof(buf);
-
-  const LSTATUS stat = RegQueryValueExW(key, subkey, 0, &type, buf, &bufsize);
-  if (stat == ERROR_SUCCESS && type == REG_DWORD) {
-    memcpy(rv, buf, sizeof(*rv));
-    return 0;
-  } else {
-    return 1;
-  }
-}
-
-static void stateReadFromRegistry(struct AppState *state) {
-  HKEY key;
-  const LSTATUS ok =
-      RegOpenKeyExW(HKEY_CURRENT_USER, LaFlorRegistryKey, 0, KEY_READ, &key);
-  if (ok != ERROR_SUCCESS) {
-    return;
-  }
-
-  int value;
-  if (registryReadInteger(key, L"delta", &value) == 0) {
-    setNewDelta(state, value);
-  }
-  if (registryReadInteger(key, L"interval", &value) == 0) {
-    setNewInterval(state, value);
-  }
-  if (registryReadInteger(key, L"active", &value) == 0 && value) {
-    toggleEnabled(state);
-  }
-
-  RegCloseKey(key);
-}
-
-static void stateSaveToRegistry(const struct AppState *state) {
-  HKEY key;
-  const LSTATUS ok = RegCreateKeyExW(HKEY_CURRENT_USER, LaFlorRegistryKey, 0, 0,
-                                     0, KEY_WRITE, 0, &key, 0);
-  if (ok != ERROR_SUCCESS) {
-    return;
-  }
-
-  RegSetValueExW(key, L"delta", 0, REG_DWORD, (const BYTE *)&state->delta,
-                 sizeof(state->delta));
-  RegSetValueExW(key, L"interval", 0, REG_DWORD, (const BYTE *)&state->interval,
-                 sizeof(state->interval));
-  int value = state->active;
-  RegSetValueExW(key, L"active", 0, REG_DWORD, (const BYTE *)&value,
-                 sizeof(value));
-  RegCloseKey(key);
-}
-
-static void initAppState(struct AppState *state, HINSTANCE hInstance) {
+static bool initAppState(struct AppState *state, HINSTANCE hInstance) {
   memset(state, 0, sizeof(*state));
   state->app = hInstance;
-  state->interval = predefIntervals[0];
+  state->interval = DEFAULT_INTERVAL;
   state->delta = predefDeltas[0];
+  state->reconcileEvery = MOTION_DEFAULT_RECONCILE_EVERY;
+  state->timerToleranceMs = DEFAULT_TIMER_TOLERANCE_MS;
+  state->autoIntervalMs = IDLE_FALLBACK_INTERVAL_MS;
+  state->spreadTicks = true;
+  state->setProcessInformation = (SetProcessInformationFn)GetProcAddress(
+      GetModuleHandleW(L"kernel32.dll"), "SetProcessInformation");
+  if (!initTickWorker(&state->worker)) {
+    return false;
+  }
+  state->worker.settings.layoutChanged = 1;
+  publishSettings(state);
+  buildInputDialogs(state);
+  return createMenu(state);
 }
 
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
                     _In_ PWSTR pCmdLine, _In_ int nCmdShow) {
-  struct AppState state;
-  initAppState(&state, hInstance);
+  /* La Flor only runs once per session. launching it again forwards the
+   * command line to the running instance instead, which makes it possible to
+   * change the settings from a script, e.g. "LaFlor.exe --interval 500". */
+  HANDLE instanceMutex = CreateMutexW(0, FALSE, InstanceMutexName);
+  if (instanceMutex && GetLastError() == ERROR_ALREADY_EXISTS) {
+    CloseHandle(instanceMutex);
+    return forwardCommandLine(pCmdLine);
+  }
 
+  struct AppState state;
   int rv = 1;
+  if (!initAppState(&state, hInstance)) {
+    goto beach;
+  }
+
   WNDCLASSEXW wndClass;
   memset(&wndClass, 0, sizeof(wndClass));
   wndClass.cbSize = sizeof(wndClass);
   wndClass.hInstance = hInstance;
-  wndClass.lpszClassName = L"LaFlor Root Window Class";
+  wndClass.lpszClassName = RootWindowClass;
   wndClass.lpfnWndProc = windowProc;
   ATOM classAtom = RegisterClassExW(&wndClass);
   if (classAtom == 0) {
@@ -633,28 +3576,59 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
   }
 
   /* since we have actually no use for any actual (visible) windows, the one and
-   * only window structure in the program is created as a "message-only" window
+   * only window structure in the program would ideally be created as a
+   * "message-only" window
    * (https://docs.microsoft.com/en-us/windows/win32/winmsg/window-features#message-only-windows)
-   * by specifying HWND_MESSAGE as its parent. the only thing that we need a
-   * window structure for is dispatching and processing messages, and this is
-   * exactly what this special kind of window is for. */
-  HWND wnd = CreateWindowExW(0, MAKEINTATOM(classAtom), L"LaFlor Root Window",
-                             0, 0, 0, 0, 0, HWND_MESSAGE, 0, hInstance, &state);
+   * by specifying HWND_MESSAGE as its parent. however, message-only windows
+   * don't receive any broadcast messages, and we need some of these, such as
+   * WM_DISPLAYCHANGE. therefore, it's created as a regular top-level window,
+   * which is just never shown : without WS_VISIBLE and with a zero size, it
+   * doesn't have any graphical representation either way. WS_EX_TOOLWINDOW
+   * keeps it out of the Alt+Tab list, just in case. */
+  HWND wnd =
+      CreateWindowExW(WS_EX_TOOLWINDOW, MAKEINTATOM(classAtom),
+                      L"LaFlor Root Window", 0, 0, 0, 0, 0, 0, 0, hInstance,
+                      &state);
   if (wnd == 0) {
     goto beach;
   }
   state.wnd = wnd;
 
   /* the icon is always created as inactive. if needed, this will be changed
-   * after reading registry values : this is done in order not to unnecessarily
+   * after loading the settings : this is done in order not to unnecessarily
    * call notification icon related functions with a null icon ID. */
   if (!createNotificationIcon(wnd, getNotificationIcon(hInstance, false))) {
     goto beach;
   }
 
-  /* reading values from registry might start the timer, which needs a valid
-   * window handle. */
-  stateReadFromRegistry(&state);
+  /* the settings read from the registry, or the configuration file, are only
+   * published for now : the injection thread picks them up as soon as it
+   * starts. */
+  loadSettings(&state);
+  runCommandLine(&state, pCmdLine);
+  state.worker.notifyWnd = wnd;
+  if (!startTickWorker(&state.worker)) {
+    goto beach2;
+  }
+  startControlServer(&state.control, wnd);
+  if (state.configPath[0]) {
+    startConfigWatcher(&state.configWatcher, wnd, state.configPath);
+  }
+  registerPowerNotifications(&state);
+  /* background mode only kicks in now that everything's been set up : see
+   * updateBackground(). */
+  state.running = true;
+  updateBackground(&state);
+  publishSettings(&state);
+
+  /* most of what has been paged in so far, such as the code reading the
+   * registry and building the menu, was only needed in order to start up.
+   * handing all of it back to the system right away keeps the resident set
+   * down to what the ticks actually touch, which matters with a copy of La
+   * Flor in each of many sessions. whatever is needed again later, e.g. when
+   * the menu is opened, simply gets paged back in, mostly from the standby
+   * list. */
+  SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
 
   MSG msg;
   BOOL getMsgRv;
@@ -665,7 +3639,12 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
    * while (GetMessage( lpMsg, hWnd, 0, 0))
    *
    * is slightly wrong though has no real consequences as it works out to the
-   * exact same thing. */
+   * exact same thing.
+   *
+   * none of the ticks go through this loop : they're all handled by the
+   * injection thread, so it doesn't matter how long any message takes to be
+   * processed, or that TrackPopupMenuEx() and DialogBoxIndirectW() run their
+   * own modal loops instead of this one. */
   while ((getMsgRv = GetMessageW(&msg, 0, 0, 0)) != 0) {
     if (getMsgRv == -1) {
       goto beach2;
@@ -677,11 +3656,22 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
    * program should be the wParam of a WM_QUIT message, which is also the value
    * passed to PostQuitMessage(). */
   rv = LOWORD(msg.wParam);
-  stateSaveToRegistry(&state);
+  saveSettings(&state);
 
 beach2:
   removeNotificationIcon(wnd);
 
 beach:
+  stopConfigWatcher(&state.configWatcher);
+  stopControlServer(&state.control);
+  stopTickWorker(&state.worker);
+  /* any menus not associated with a window must be explicitly destroyed.
+   * DestroyMenu() works recursively, i.e. it destroys any submenus as well. */
+  if (state.menu) {
+    DestroyMenu(state.menu);
+  }
+  if (instanceMutex) {
+    CloseHandle(instanceMutex);
+  }
   return rv;
 }
@@ -0,0 +1,382 @@
+/* La Flor for X11 desktops. this runs the very same motion engine as the
+ * Windows application, with its input injected through XTest : see
+ * x11backend.h. there's no notification icon, or menu : the settings are
+ * given on the command line, and La Flor keeps going until it gets SIGINT or
+ * SIGTERM.
+ *
+ *   ./build/LaFlorX11 --interval 1000 --delta 5 --smooth
+ *
+ * a single process can also keep any number of displays busy at once, e.g.
+ * the virtual displays of a CI host, each with its own interval and delta :
+ *
+ *   ./build/LaFlorX11 --display :1 --display :2,500 --display :3,250,10
+ *
+ * everything happens on a single thread, around a single epoll instance : the
+ * connections to the servers, a timerfd and a signalfd. each display ticks
+ * off its own struct TickScheduler, so the ticks never drift, with their
+ * phases spread so that they don't all come at once. all of the ticks are
+ * timers of one struct TimerWheel, which the timerfd is armed for : there's
+ * a single wakeup for whatever is due at the same time, however many displays
+ * there are. the signals are blocked, and only ever read from the
+ * signalfd, which is what keeps this free of globals. */
+
+#include "motion.h"
+#include "scheduler.h"
+#include "timerwheel.h"
+#include "x11backend.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+/* the epoll events of the timerfd and of the signalfd are told apart from
+ * those of the displays by these, with the displays numbered from
+ * FIRST_DISPLAY_EVENT on. */
+#define TIMER_EVENT 0
+#define SIGNAL_EVENT 1
+#define FIRST_DISPLAY_EVENT 2
+
+#define MAX_EVENTS 64
+
+struct Daemon;
+
+/* the settings and the state of a single display, along the lines of the
+ * Windows application's struct AppState. */
+struct DisplayState {
+  struct Daemon *daemon;
+  const char *name;
+  int interval;
+  int delta;
+  struct X11Backend x11;
+  struct MotionBackend backend;
+  struct ScreenLayout layout;
+  struct MotionState motion;
+  struct TickScheduler scheduler;
+  struct WheelTimer tick;
+  /* false once the display was closed, or its connection lost. */
+  bool open;
+};
+
+struct Daemon {
+  int epoll;
+  int timer;
+  int signals;
+  struct TimerWheel wheel;
+  /* fires after "seconds", if that's not 0, and stops the daemon. */
+  struct WheelTimer stop;
+  bool stopping;
+  int seconds;
+  bool smooth;
+  bool absolute;
+  int count;
+  int openCount;
+  struct DisplayState *displays;
+};
+
+static long long nowUs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* the memory that the process keeps resident, in bytes. */
+static long long residentBytes(void) {
+  FILE *f = fopen("/proc/self/statm", "r");
+  long long size = 0, resident = 0;
+  if (f) {
+    if (fscanf(f, "%lld %lld", &size, &resident) != 2) {
+      resident = 0;
+    }
+    fclose(f);
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+static long long cpuUs(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL +
+         usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void closeDisplay(struct Daemon *daemon, struct DisplayState *display) {
+  if (!display->open) {
+    return;
+  }
+  display->open = false;
+  --daemon->openCount;
+  wheelCancel(&daemon->wheel, &display->tick);
+  epoll_ctl(daemon->epoll, EPOLL_CTL_DEL,
+            ConnectionNumber(display->x11.display), 0);
+  if (display->x11.lost) {
+    fprintf(stderr, "lost display %s\n", display->name);
+  }
+  x11Close(&display->x11);
+}
+
+static void onDisplayEvents(struct Daemon *daemon,
+                            struct DisplayState *display) {
+  if (x11ProcessEvents(&display->x11)) {
+    x11QueryLayout(&display->x11, &display->layout);
+    motionSetLayout(&display->motion, &display->layout);
+  }
+  if (display->x11.lost) {
+    closeDisplay(daemon, display);
+  }
+}
+
+static void onTick(void *ctx, struct WheelTimer *timer) {
+  struct DisplayState *display = ctx;
+  struct Daemon *daemon = display->daemon;
+  schedulerOnFire(&display->scheduler, nowUs());
+  x11BeginTick(&display->x11);
+  motionTick(&display->motion);
+  x11EndTick(&display->x11);
+  /* flushing is what notices a connection that's gone, and reading the
+   * events that came in along the way keeps them from lying in Xlib's queue
+   * without the connection ever becoming readable. */
+  onDisplayEvents(daemon, display);
+  if (display->open) {
+    wheelSchedule(&daemon->wheel, timer, display->scheduler.nextDeadlineUs);
+  }
+}
+
+static void onStop(void *ctx, struct WheelTimer *timer) {
+  struct Daemon *daemon = ctx;
+  daemon->stopping = true;
+}
+
+/* the number of a display, which is unique on the host, e.g. 12 for ":12.0"
+ * or for "localhost:12". */
+static uint32_t displayNumber(const char *name) {
+  if (name == 0) {
+    name = getenv("DISPLAY");
+  }
+  const char *colon = name ? strrchr(name, ':') : 0;
+  return colon ? (uint32_t)atoi(colon + 1) : 0;
+}
+
+static bool openDisplay(struct Daemon *daemon, struct DisplayState *display,
+                        int index) {
+  display->daemon = daemon;
+  if (!x11Open(&display->x11, display->name)) {
+    return false;
+  }
+  x11InitMotionBackend(&display->backend, &display->x11);
+  x11QueryLayout(&display->x11, &display->layout);
+  motionInit(&display->motion, &display->backend, display->delta);
+  motionSetLayout(&display->motion, &display->layout);
+  display->motion.smooth = daemon->smooth;
+  display->motion.absolute = daemon->absolute;
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.u64 = FIRST_DISPLAY_EVENT + index;
+  if (epoll_ctl(daemon->epoll, EPOLL_CTL_ADD,
+                ConnectionNumber(display->x11.display), &event) != 0) {
+    perror("epoll_ctl");
+    x11Close(&display->x11);
+    return false;
+  }
+  display->open = true;
+  ++daemon->openCount;
+  /* the displays' ticks are spread over their intervals, just like those of
+   * the instances running in the sessions of a Windows machine, with the
+   * display number playing the part of the session ID. CLOCK_MONOTONIC is
+   * the same for every process, so this also holds across daemons. */
+  schedulerInit(&display->scheduler);
+  schedulerSetSpread(&display->scheduler, true, displayNumber(display->name));
+  schedulerStart(&display->scheduler, nowUs(), display->interval * 1000LL);
+  wheelTimerInit(&display->tick, onTick, display);
+  wheelSchedule(&daemon->wheel, &display->tick,
+                display->scheduler.nextDeadlineUs);
+  return true;
+}
+
+/* arms the timerfd for the earliest deadline of the wheel, in absolute time
+ * on the same clock as nowUs(), so that it never drifts. a zero time
+ * disarms it. */
+static void armTimer(struct Daemon *daemon) {
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  const long long deadlineUs = wheelNextDeadlineUs(&daemon->wheel);
+  if (deadlineUs >= 0) {
+    /* 0 would disarm the timer, rather than fire it right away. */
+    const long long dueUs = deadlineUs > 0 ? deadlineUs : 1;
+    spec.it_value.tv_sec = dueUs / 1000000;
+    spec.it_value.tv_nsec = (dueUs % 1000000) * 1000;
+  }
+  timerfd_settime(daemon->timer, TFD_TIMER_ABSTIME, &spec, 0);
+}
+
+static bool addToEpoll(int epoll, int fd, uint64_t data) {
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.u64 = data;
+  return epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+static bool initDaemon(struct Daemon *daemon) {
+  sigset_t stopSignals;
+  sigemptyset(&stopSignals);
+  sigaddset(&stopSignals, SIGINT);
+  sigaddset(&stopSignals, SIGTERM);
+  sigprocmask(SIG_BLOCK, &stopSignals, 0);
+  /* a server going away shows up as an error on its connection, not as a
+   * signal which would end the process. */
+  signal(SIGPIPE, SIG_IGN);
+
+  daemon->epoll = epoll_create1(EPOLL_CLOEXEC);
+  daemon->timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  daemon->signals = signalfd(-1, &stopSignals, SFD_CLOEXEC | SFD_NONBLOCK);
+  if (daemon->epoll < 0 || daemon->timer < 0 || daemon->signals < 0 ||
+      !addToEpoll(daemon->epoll, daemon->timer, TIMER_EVENT) ||
+      !addToEpoll(daemon->epoll, daemon->signals, SIGNAL_EVENT)) {
+    perror("couldn't set up the event loop");
+    return false;
+  }
+  wheelInit(&daemon->wheel, nowUs(), 1000);
+  wheelTimerInit(&daemon->stop, onStop, daemon);
+  if (daemon->seconds > 0) {
+    wheelSchedule(&daemon->wheel, &daemon->stop,
+                  nowUs() + daemon->seconds * 1000000LL);
+  }
+  return true;
+}
+
+static void runDaemon(struct Daemon *daemon) {
+  struct epoll_event events[MAX_EVENTS];
+  while (!daemon->stopping && daemon->openCount > 0) {
+    armTimer(daemon);
+    const int count = epoll_wait(daemon->epoll, events, MAX_EVENTS, -1);
+    if (count < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      return;
+    }
+    for (int i = 0; i < count; ++i) {
+      const uint64_t source = events[i].data.u64;
+      if (source == TIMER_EVENT) {
+        uint64_t expirations;
+        if (read(daemon->timer, &expirations, sizeof(expirations)) > 0) {
+          wheelAdvance(&daemon->wheel, nowUs());
+        }
+      } else if (source == SIGNAL_EVENT) {
+        daemon->stopping = true;
+      } else {
+        struct DisplayState *display =
+            &daemon->displays[source - FIRST_DISPLAY_EVENT];
+        if (!display->open) {
+          continue;
+        }
+        if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+          display->x11.lost = true;
+        }
+        onDisplayEvents(daemon, display);
+      }
+    }
+  }
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--interval MS] [--delta PX] [--smooth] [--absolute] "
+          "[--seconds S] [--display NAME[,MS[,PX]]]...\n",
+          argv0);
+}
+
+/* parses the options into "daemon", with the displays pointing into argv.
+ * the interval and delta apply to the displays which don't have their own,
+ * wherever they are on the command line. */
+static bool parseOptions(int argc, char **argv, struct Daemon *daemon) {
+  int interval = 1000;
+  int delta = 5;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--smooth") == 0) {
+      daemon->smooth = true;
+    } else if (strcmp(argv[i], "--absolute") == 0) {
+      daemon->absolute = true;
+    } else if (i + 1 >= argc) {
+      return false;
+    } else if (strcmp(argv[i], "--interval") == 0) {
+      interval = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--delta") == 0) {
+      delta = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seconds") == 0) {
+      daemon->seconds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--display") == 0) {
+      struct DisplayState *display = &daemon->displays[daemon->count++];
+      display->name = argv[++i];
+      display->interval = 0;
+      display->delta = 0;
+      char *comma = strchr(argv[i], ',');
+      if (comma) {
+        *comma = 0;
+        display->interval = atoi(comma + 1);
+        comma = strchr(comma + 1, ',');
+        display->delta = comma ? atoi(comma + 1) : 0;
+      }
+    } else {
+      return false;
+    }
+  }
+  /* without any --display, it's $DISPLAY. */
+  if (daemon->count == 0) {
+    daemon->displays[daemon->count++].name = 0;
+  }
+  for (int i = 0; i < daemon->count; ++i) {
+    struct DisplayState *display = &daemon->displays[i];
+    display->interval = display->interval > 0 ? display->interval : interval;
+    display->delta = display->delta > 0 ? display->delta : delta;
+  }
+  return interval > 0 && delta > 0;
+}
+
+int main(int argc, char **argv) {
+  struct Daemon daemon;
+  memset(&daemon, 0, sizeof(daemon));
+  /* there can't be more displays than arguments. */
+  daemon.displays = calloc(argc, sizeof(*daemon.displays));
+  if (daemon.displays == 0 || !parseOptions(argc, argv, &daemon)) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (!initDaemon(&daemon)) {
+    return 1;
+  }
+
+  const long long residentBefore = residentBytes();
+  for (int i = 0; i < daemon.count; ++i) {
+    openDisplay(&daemon, &daemon.displays[i], i);
+  }
+  const long long residentAfter = residentBytes();
+  const int opened = daemon.openCount;
+  if (opened == 0) {
+    return 1;
+  }
+  const long long cpuStart = cpuUs();
+  runDaemon(&daemon);
+  const long long cpu = cpuUs() - cpuStart;
+
+  long long ticks = 0, missed = 0;
+  for (int i = 0; i < daemon.count; ++i) {
+    ticks += daemon.displays[i].scheduler.stats.ticks;
+    missed += daemon.displays[i].scheduler.stats.missed;
+    closeDisplay(&daemon, &daemon.displays[i]);
+  }
+  printf("%d displays, %lld ticks, %lld missed, %.1f ms of CPU per 1000 "
+         "ticks, %lld KiB resident per display\n",
+         opened, ticks, missed, ticks ? cpu / (double)ticks : 0.0,
+         (residentAfter - residentBefore) / opened / 1024);
+  free(daemon.displays);
+  return 0;
+}
@@ -0,0 +1,35 @@
+#include "activity.h"
+
+#include <string.h>
+
+void activityInit(struct ActivityTracker *tracker) {
+  memset(tracker, 0, sizeof(*tracker));
+}
+
+bool activityForeignInput(const struct ActivityTracker *tracker,
+                          uint32_t lastInputMs) {
+  /* input from before our injection makes the subtraction wrap around to a
+   * huge value, which is just what we want here. */
+  return !tracker->injected || (uint32_t)(lastInputMs - tracker->injectedAtMs) >
+                                   ACTIVITY_OWN_INPUT_SLACK_MS;
+}
+
+uint32_t activityPostponeMs(struct ActivityTracker *tracker, uint32_t nowMs,
+                            uint32_t lastInputMs, uint32_t intervalMs) {
+  /* if the last input is the one that we generated, nobody else has touched the
+   * machine since. */
+  if (!activityForeignInput(tracker, lastInputMs)) {
+    return 0;
+  }
+  const uint32_t idleMs = nowMs - lastInputMs;
+  if (idleMs >= intervalMs) {
+    return 0;
+  }
+  ++tracker->skippedTicks;
+  return intervalMs - idleMs;
+}
+
+void activityOnInjected(struct ActivityTracker *tracker, uint32_t nowMs) {
+  tracker->injectedAtMs = nowMs;
+  tracker->injected = true;
+}
@@ -0,0 +1,46 @@
+#ifndef LAFLOR_ACTIVITY_H
+#define LAFLOR_ACTIVITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* input events arriving up to this many milliseconds after we injected some
+ * input are assumed to be our own. the input that we inject is processed
+ * asynchronously, so the last input time reported by the system can end up
+ * being a bit later than the time at which we called SendInput(). */
+#define ACTIVITY_OWN_INPUT_SLACK_MS 100
+
+/* keeps track of whether the real user has been using the machine since the
+ * last time we injected any input ourselves.
+ *
+ * all times are in milliseconds of a 32-bit wrapping tick counter, such as the
+ * one returned by GetTickCount() and used by GetLastInputInfo() : all the
+ * arithmetic is done on unsigned 32-bit values, so that wrapping around every
+ * 49.7 days doesn't matter. */
+struct ActivityTracker {
+  uint32_t injectedAtMs;
+  bool injected;
+  unsigned long skippedTicks;
+};
+
+void activityInit(struct ActivityTracker *tracker);
+
+/* returns true if the last input event seen by the system isn't one that we
+ * injected ourselves, or if we haven't injected anything yet. */
+bool activityForeignInput(const struct ActivityTracker *tracker,
+                          uint32_t lastInputMs);
+
+/* decides what a tick should do, given the time of the last input event seen
+ * by the system. returns 0 if input should be injected right now. otherwise,
+ * the user has been active less than one interval ago, and the return value is
+ * the number of milliseconds left until the user will have been idle for a
+ * whole interval : this is when the tick should be retried, as there's no point
+ * in checking any earlier. */
+uint32_t activityPostponeMs(struct ActivityTracker *tracker, uint32_t nowMs,
+                            uint32_t lastInputMs, uint32_t intervalMs);
+
+/* records the time right before injecting some input, which allows telling our
+ * own input apart from the user's later on. */
+void activityOnInjected(struct ActivityTracker *tracker, uint32_t nowMs);
+
+#endif
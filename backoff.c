@@ -0,0 +1,37 @@
+#include "backoff.h"
+
+#include <string.h>
+
+void backoffInit(struct InjectionBackoff *backoff) {
+  memset(backoff, 0, sizeof(*backoff));
+}
+
+bool backoffBlocked(const struct InjectionBackoff *backoff) {
+  return backoff->failedInARow != 0;
+}
+
+long long backoffOnTick(struct InjectionBackoff *backoff, bool injected,
+                        long long periodUs) {
+  if (injected) {
+    backoff->recoveries += backoff->failedInARow != 0;
+    backoff->failedInARow = 0;
+    return 0;
+  }
+  ++backoff->failedTicks;
+  ++backoff->failedInARow;
+  /* the first failure is retried after twice the period, the next one after
+   * four times the period, and so on. a period which is already longer than
+   * the cap is left alone. */
+  const unsigned long shift = backoff->failedInARow < BACKOFF_MAX_SHIFT
+                                  ? backoff->failedInARow
+                                  : BACKOFF_MAX_SHIFT;
+  long long delayUs = periodUs << shift;
+  if (delayUs > BACKOFF_MAX_DELAY_US) {
+    delayUs = periodUs > BACKOFF_MAX_DELAY_US ? periodUs : BACKOFF_MAX_DELAY_US;
+  }
+  return delayUs;
+}
+
+void backoffReset(struct InjectionBackoff *backoff) {
+  backoff->failedInARow = 0;
+}
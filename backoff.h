@@ -0,0 +1,46 @@
+#ifndef LAFLOR_BACKOFF_H
+#define LAFLOR_BACKOFF_H
+
+#include <stdbool.h>
+
+/* while injection keeps failing, the delay between ticks doubles with every
+ * failed tick, up to this many times the interval... */
+#define BACKOFF_MAX_SHIFT 6
+/* ...and up to this many microseconds, so that La Flor notices within half a
+ * minute that injection works again. */
+#define BACKOFF_MAX_DELAY_US 30000000LL
+
+/* keeps track of whether the input that the ticks inject actually gets
+ * through. the system refuses injected input when it would go to a window of
+ * a higher integrity level than ours, such as an elevated application in the
+ * foreground, or to a secure desktop, such as the UAC prompt's : trying again
+ * on every tick is just wasted work, so the ticks back off exponentially until
+ * one gets through, at which point they go back to their regular schedule
+ * right away. */
+struct InjectionBackoff {
+  /* the number of ticks whose input didn't get through, in total and in a
+   * row. */
+  unsigned long failedTicks;
+  unsigned long failedInARow;
+  /* the number of times that injection started working again after having
+   * failed. */
+  unsigned long recoveries;
+};
+
+void backoffInit(struct InjectionBackoff *backoff);
+
+/* whether the last tick's input didn't get through. */
+bool backoffBlocked(const struct InjectionBackoff *backoff);
+
+/* records whether a tick's input got through, for ticks with a period of
+ * "periodUs". returns how long to wait until the next tick, in microseconds,
+ * when backing off, or 0 if the next tick should come as scheduled. */
+long long backoffOnTick(struct InjectionBackoff *backoff, bool injected,
+                        long long periodUs);
+
+/* starts over with the regular schedule, e.g. because ticking was stopped and
+ * started again : whatever blocked injection might well be gone. the counts
+ * are preserved. */
+void backoffReset(struct InjectionBackoff *backoff);
+
+#endif
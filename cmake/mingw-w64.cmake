@@ -0,0 +1,23 @@
+# cross-compiles for Windows with MinGW-w64, e.g. from Linux :
+#
+#   cmake -S . -B mingw -DCMAKE_TOOLCHAIN_FILE=cmake/mingw-w64.cmake
+#
+# MINGW_PREFIX selects the target : x86_64-w64-mingw32 (the default) or
+# i686-w64-mingw32. everything is linked statically, so that the binaries run
+# under Wine, or on Windows, without any of MinGW's DLLs around.
+set(CMAKE_SYSTEM_NAME Windows)
+set(MINGW_PREFIX x86_64-w64-mingw32 CACHE STRING "MinGW-w64 target triplet")
+if (MINGW_PREFIX MATCHES "^i686")
+  set(CMAKE_SYSTEM_PROCESSOR x86)
+else ()
+  set(CMAKE_SYSTEM_PROCESSOR x86_64)
+endif ()
+
+set(CMAKE_C_COMPILER ${MINGW_PREFIX}-gcc)
+set(CMAKE_RC_COMPILER ${MINGW_PREFIX}-windres)
+set(CMAKE_EXE_LINKER_FLAGS_INIT "-static")
+
+set(CMAKE_FIND_ROOT_PATH /usr/${MINGW_PREFIX})
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
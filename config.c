@@ -0,0 +1,194 @@
+#include "config.h"
+#include "lex.h"
+#include "scheduler.h"
+
+#include <limits.h>
+#include <string.h>
+
+static const char *const configNames[CONFIG_KEY_COUNT] = {
+    "active",
+    "interval",
+    "delta",
+    "precise",
+    "pauseWhileActive",
+    "smooth",
+    "absolute",
+    "replay",
+    "pattern",
+    "reconcileEvery",
+    "timerToleranceMs",
+    "keepAwake",
+    "scrollEvery",
+    "spreadTicks",
+    "autoInterval",
+    "appTimeout",
+    "background",
+};
+
+static const struct {
+  const char *word;
+  int value;
+} configWords[] = {{"on", 1},   {"off", 0}, {"true", 1},
+                   {"false", 0}, {"yes", 1}, {"no", 0}};
+
+const char *configKeyName(enum ConfigKey key) { return configNames[key]; }
+
+void configSet(struct ConfigValues *config, enum ConfigKey key, int value) {
+  config->present |= 1u << key;
+  config->values[key] = value;
+}
+
+bool configEqual(const struct ConfigValues *a, const struct ConfigValues *b) {
+  if (a->present != b->present) {
+    return false;
+  }
+  for (int i = 0; i < CONFIG_KEY_COUNT; ++i) {
+    if ((a->present & (1u << i)) && a->values[i] != b->values[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* memchr(), which the CRT-free build doesn't have. */
+static const char *findChar(const char *text, size_t len, char c) {
+  for (size_t i = 0; i < len; ++i) {
+    if (text[i] == c) {
+      return text + i;
+    }
+  }
+  return 0;
+}
+
+static bool parseValue(const char *text, size_t len, int *out) {
+  for (size_t i = 0; i < sizeof(configWords) / sizeof(configWords[0]); ++i) {
+    if (lexWordIs(text, len, configWords[i].word)) {
+      *out = configWords[i].value;
+      return true;
+    }
+  }
+  size_t i = 0;
+  const bool negative = len > 0 && text[0] == '-';
+  i += negative;
+  if (i == len) {
+    return false;
+  }
+  long long val = 0;
+  for (; i < len; ++i) {
+    if (text[i] < '0' || text[i] > '9') {
+      return false;
+    }
+    val = val * 10 + (text[i] - '0');
+    if (val > INT_MAX) {
+      return false;
+    }
+  }
+  *out = (int)(negative ? -val : val);
+  return true;
+}
+
+/* parses a single line, without its line ending. returns false if it's
+ * neither blank, nor a comment, nor a setting. */
+static bool parseLine(const char *line, size_t len, struct ConfigValues *out) {
+  size_t start = 0, end = len;
+  while (start < end && lexIsBlank(line[start])) {
+    ++start;
+  }
+  if (start == end || line[start] == '#' || line[start] == ';') {
+    return true;
+  }
+  const char *eq = findChar(line + start, end - start, '=');
+  if (eq == 0) {
+    return false;
+  }
+  size_t nameEnd = (size_t)(eq - line);
+  size_t valueStart = nameEnd + 1;
+  while (nameEnd > start && lexIsBlank(line[nameEnd - 1])) {
+    --nameEnd;
+  }
+  while (valueStart < end && lexIsBlank(line[valueStart])) {
+    ++valueStart;
+  }
+  while (end > valueStart && lexIsBlank(line[end - 1])) {
+    --end;
+  }
+  int value;
+  if (nameEnd == start ||
+      !parseValue(line + valueStart, end - valueStart, &value)) {
+    return false;
+  }
+  for (int key = 0; key < CONFIG_KEY_COUNT; ++key) {
+    if (lexWordIs(line + start, nameEnd - start, configNames[key])) {
+      /* an interval which is too short is as bad as one which isn't a
+       * number : a file pushed to every session could otherwise make them
+       * all tick as fast as they can. */
+      if (key == CONFIG_INTERVAL && value < SCHEDULER_MIN_INTERVAL_MS) {
+        return false;
+      }
+      configSet(out, (enum ConfigKey)key, value);
+      break;
+    }
+  }
+  return true;
+}
+
+int configParse(const char *text, size_t len, struct ConfigValues *out) {
+  memset(out, 0, sizeof(*out));
+  size_t pos = 0;
+  if (len >= 3 && memcmp(text, "\xef\xbb\xbf", 3) == 0) {
+    pos = 3;
+  }
+  int errors = 0;
+  while (pos < len) {
+    const char *nl = findChar(text + pos, len - pos, '\n');
+    const size_t lineEnd = nl ? (size_t)(nl - text) : len;
+    errors += !parseLine(text + pos, lineEnd - pos, out);
+    pos = lineEnd + 1;
+  }
+  return errors;
+}
+
+/* appends "str" to the output, as long as there's room left for it. */
+static bool append(char *buf, size_t bufLen, size_t *len, const char *str,
+                   size_t strLen) {
+  if (bufLen - *len < strLen) {
+    return false;
+  }
+  memcpy(buf + *len, str, strLen);
+  *len += strLen;
+  return true;
+}
+
+size_t configFormat(char *buf, size_t bufLen,
+                    const struct ConfigValues *config) {
+  static const char header[] = "# La Flor settings\n";
+  size_t len = 0;
+  if (!append(buf, bufLen, &len, header, sizeof(header) - 1)) {
+    return 0;
+  }
+  for (int key = 0; key < CONFIG_KEY_COUNT; ++key) {
+    if ((config->present & (1u << key)) == 0) {
+      continue;
+    }
+    /* the digits are produced backwards, from the end of "num". */
+    char num[16];
+    size_t numStart = sizeof(num);
+    const int value = config->values[key];
+    unsigned mag = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+    do {
+      num[--numStart] = (char)('0' + mag % 10);
+      mag /= 10;
+    } while (mag);
+    if (value < 0) {
+      num[--numStart] = '-';
+    }
+    if (!append(buf, bufLen, &len, configNames[key],
+                strlen(configNames[key])) ||
+        !append(buf, bufLen, &len, " = ", 3) ||
+        !append(buf, bufLen, &len, num + numStart, sizeof(num) - numStart) ||
+        !append(buf, bufLen, &len, "\n", 1)) {
+      return 0;
+    }
+  }
+  return len;
+}
@@ -0,0 +1,72 @@
+#ifndef LAFLOR_CONFIG_H
+#define LAFLOR_CONFIG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* the largest configuration file that is accepted. */
+#define CONFIG_MAX_FILE_SIZE 65536
+
+/* the settings that La Flor keeps, in the order in which they're written
+ * out. the names, as returned by configKeyName(), are also the names of the
+ * registry values. */
+enum ConfigKey {
+  CONFIG_ACTIVE,
+  CONFIG_INTERVAL,
+  CONFIG_DELTA,
+  CONFIG_PRECISE,
+  CONFIG_PAUSE_WHILE_ACTIVE,
+  CONFIG_SMOOTH,
+  CONFIG_ABSOLUTE,
+  CONFIG_REPLAY,
+  CONFIG_PATTERN,
+  CONFIG_RECONCILE_EVERY,
+  CONFIG_TIMER_TOLERANCE_MS,
+  CONFIG_KEEP_AWAKE,
+  CONFIG_SCROLL_EVERY,
+  CONFIG_SPREAD_TICKS,
+  CONFIG_AUTO_INTERVAL,
+  CONFIG_APP_TIMEOUT,
+  CONFIG_BACKGROUND,
+  CONFIG_KEY_COUNT
+};
+
+/* a set of settings, any of which may be missing : "present" has the bit
+ * (1 << key) set for each of the values which are there. the values are
+ * stored as they were read, without any checks as to whether they make sense,
+ * which is up to whoever applies them. */
+struct ConfigValues {
+  unsigned present;
+  int values[CONFIG_KEY_COUNT];
+};
+
+const char *configKeyName(enum ConfigKey key);
+
+void configSet(struct ConfigValues *config, enum ConfigKey key, int value);
+
+/* whether both sets have the same values present, with the same values. */
+bool configEqual(const struct ConfigValues *a, const struct ConfigValues *b);
+
+/* parses a configuration file, in one pass, straight from memory : the file
+ * doesn't need to be null-terminated. the file is made of lines such as
+ *
+ *   # comments start with # or ;
+ *   interval = 1000
+ *   smooth = on
+ *
+ * with the value being a decimal integer, or one of on/off, true/false and
+ * yes/no for the settings which are switches. a UTF-8 byte order mark, blank
+ * lines, spaces around the names and values, and both kinds of line endings
+ * are fine. unknown names are ignored, so that files can be shared with newer
+ * versions. an interval shorter than SCHEDULER_MIN_INTERVAL_MS doesn't make
+ * sense. returns the number of lines which didn't make sense, and were
+ * ignored. */
+int configParse(const char *text, size_t len, struct ConfigValues *out);
+
+/* writes the values which are present in the format read by configParse(),
+ * one per line, in the order of enum ConfigKey. returns the number of bytes
+ * written, or 0 if "bufLen" wasn't enough. nothing is null-terminated. */
+size_t configFormat(char *buf, size_t bufLen,
+                    const struct ConfigValues *config);
+
+#endif
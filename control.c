@@ -0,0 +1,112 @@
+#include "control.h"
+#include "scheduler.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+struct ControlName {
+  const char *name;
+  enum ControlOp op;
+  bool hasValue;
+};
+
+static const struct ControlName controlNames[] = {
+    {"interval", CONTROL_SET_INTERVAL, true},
+    {"delta", CONTROL_SET_DELTA, true},
+    {"enable", CONTROL_ENABLE, false},
+    {"disable", CONTROL_DISABLE, false},
+    {"stats", CONTROL_QUERY_STATS, false},
+    {"background", CONTROL_BACKGROUND, false},
+    {"foreground", CONTROL_FOREGROUND, false},
+};
+
+static bool isSeparator(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ';';
+}
+
+/* finds the next word, starting at "*pos". returns false if there are no
+ * more words. */
+static bool nextWord(const char *text, size_t len, size_t *pos,
+                     size_t *start, size_t *wordLen) {
+  size_t i = *pos;
+  while (i < len && isSeparator(text[i])) {
+    ++i;
+  }
+  if (i == len) {
+    return false;
+  }
+  *start = i;
+  while (i < len && !isSeparator(text[i])) {
+    ++i;
+  }
+  *wordLen = i - *start;
+  *pos = i;
+  return true;
+}
+
+static const struct ControlName *findName(const char *word, size_t len) {
+  if (len > 2 && word[0] == '-' && word[1] == '-') {
+    word += 2;
+    len -= 2;
+  } else if (len > 1 && word[0] == '/') {
+    ++word;
+    --len;
+  }
+  for (size_t i = 0; i < sizeof(controlNames) / sizeof(controlNames[0]);
+       ++i) {
+    const char *name = controlNames[i].name;
+    if (strlen(name) == len && memcmp(name, word, len) == 0) {
+      return &controlNames[i];
+    }
+  }
+  return 0;
+}
+
+/* parses a positive decimal integer which fits into an int. */
+static bool parseValue(const char *word, size_t len, int *value) {
+  if (len == 0) {
+    return false;
+  }
+  long long rv = 0;
+  for (size_t i = 0; i < len; ++i) {
+    if (word[i] < '0' || word[i] > '9') {
+      return false;
+    }
+    rv = rv * 10 + (word[i] - '0');
+    if (rv > 0x7fffffff) {
+      return false;
+    }
+  }
+  *value = (int)rv;
+  return rv > 0;
+}
+
+int controlParse(const char *text, size_t len, struct ControlCommand *out,
+                 int maxCommands, size_t *errorAt) {
+  int count = 0;
+  size_t pos = 0, start, wordLen;
+  while (nextWord(text, len, &pos, &start, &wordLen)) {
+    *errorAt = start;
+    const struct ControlName *name = findName(text + start, wordLen);
+    if (name == 0 || count == maxCommands) {
+      return -1;
+    }
+    out[count].op = name->op;
+    out[count].value = 0;
+    if (name->hasValue) {
+      if (!nextWord(text, len, &pos, &start, &wordLen)) {
+        return -1;
+      }
+      *errorAt = start;
+      if (!parseValue(text + start, wordLen, &out[count].value)) {
+        return -1;
+      }
+      if (name->op == CONTROL_SET_INTERVAL &&
+          out[count].value < SCHEDULER_MIN_INTERVAL_MS) {
+        return -1;
+      }
+    }
+    ++count;
+  }
+  return count;
+}
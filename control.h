@@ -0,0 +1,50 @@
+#ifndef LAFLOR_CONTROL_H
+#define LAFLOR_CONTROL_H
+
+#include <stddef.h>
+
+/* the largest batch of commands that is accepted at once, both in bytes and in
+ * the number of commands. */
+#define CONTROL_MAX_MESSAGE 1024
+#define CONTROL_MAX_COMMANDS 32
+
+/* the class of La Flor's root window on Windows, which is how the tools find
+ * the window of the instance they started, in order to make it quit. */
+#define CONTROL_WINDOW_CLASS L"LaFlor Root Window Class"
+
+enum ControlOp {
+  CONTROL_SET_INTERVAL,
+  CONTROL_SET_DELTA,
+  CONTROL_ENABLE,
+  CONTROL_DISABLE,
+  CONTROL_QUERY_STATS,
+  CONTROL_BACKGROUND,
+  CONTROL_FOREGROUND,
+};
+
+struct ControlCommand {
+  enum ControlOp op;
+  /* the argument of the "set" commands : the interval in milliseconds, at
+   * least SCHEDULER_MIN_INTERVAL_MS, or the delta in pixels, always
+   * positive. */
+  int value;
+};
+
+/* parses a batch of commands, as sent to a running instance of La Flor, or
+ * passed to it on the command line. the commands are words separated by any
+ * whitespace or semicolons, with the "set" commands followed by their
+ * argument :
+ *
+ *   interval MS, delta PX, enable, disable, stats, background, foreground
+ *
+ * each command can also be prefixed with "--" or "/", as is customary for
+ * command line switches, so "--interval 500 --enable" works just as well.
+ *
+ * returns the number of commands stored in "out", or -1 if the batch isn't
+ * valid, in which case "*errorAt" is set to the offset of the word that
+ * couldn't be parsed, or of the interval that's too short. nothing in a batch should be acted upon unless the whole
+ * batch is valid. */
+int controlParse(const char *text, size_t len, struct ControlCommand *out,
+                 int maxCommands, size_t *errorAt);
+
+#endif
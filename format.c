@@ -0,0 +1,156 @@
+#include "format.h"
+
+#include <limits.h>
+#include <stdarg.h>
+
+/* both formatters share the same implementation, which reads the format and
+ * writes the output as either wchar_t or char, depending on "wide". */
+struct FormatOut {
+  void *buf;
+  int len;
+  int cap;
+  bool wide;
+};
+
+static void put(struct FormatOut *out, unsigned c) {
+  if (out->len >= out->cap - 1) {
+    return;
+  }
+  if (out->wide) {
+    ((wchar_t *)out->buf)[out->len++] = (wchar_t)c;
+  } else {
+    ((char *)out->buf)[out->len++] = (char)c;
+  }
+}
+
+static unsigned charAt(const void *text, bool wide, int i) {
+  return wide ? (unsigned)((const wchar_t *)text)[i]
+              : (unsigned char)((const char *)text)[i];
+}
+
+static void putNumber(struct FormatOut *out, unsigned long val, bool negative,
+                      int width, bool zeroPad) {
+  char digits[24];
+  int count = 0;
+  do {
+    digits[count++] = (char)('0' + val % 10);
+    val /= 10;
+  } while (val);
+  int len = count + negative;
+  /* the sign goes before zeros, but after spaces. */
+  if (negative && zeroPad) {
+    put(out, '-');
+  }
+  for (; len < width; ++len) {
+    put(out, zeroPad ? '0' : ' ');
+  }
+  if (negative && !zeroPad) {
+    put(out, '-');
+  }
+  while (count) {
+    put(out, digits[--count]);
+  }
+}
+
+static int formatV(struct FormatOut *out, const void *fmt, va_list args) {
+  if (out->cap <= 0) {
+    return 0;
+  }
+  const bool wide = out->wide;
+  for (int i = 0; charAt(fmt, wide, i); ++i) {
+    unsigned c = charAt(fmt, wide, i);
+    if (c != '%') {
+      put(out, c);
+      continue;
+    }
+    c = charAt(fmt, wide, ++i);
+    const bool zeroPad = c == '0';
+    int width = 0;
+    for (; c >= '0' && c <= '9'; c = charAt(fmt, wide, ++i)) {
+      width = width * 10 + (int)(c - '0');
+    }
+    const bool isLong = c == 'l';
+    if (isLong) {
+      c = charAt(fmt, wide, ++i);
+    }
+    if (c == 'd') {
+      const long val = isLong ? va_arg(args, long) : va_arg(args, int);
+      /* negating in unsigned arithmetic also works for LONG_MIN. */
+      const unsigned long mag =
+          val < 0 ? 0 - (unsigned long)val : (unsigned long)val;
+      putNumber(out, mag, val < 0, width, zeroPad);
+    } else if (c == 'u') {
+      putNumber(out,
+                isLong ? va_arg(args, unsigned long)
+                       : va_arg(args, unsigned),
+                false, width, zeroPad);
+    } else if (c == 's') {
+      const void *str = wide ? (const void *)va_arg(args, const wchar_t *)
+                             : (const void *)va_arg(args, const char *);
+      for (int j = 0; charAt(str, wide, j); ++j) {
+        put(out, charAt(str, wide, j));
+      }
+    } else if (c == '%') {
+      put(out, '%');
+    } else {
+      /* anything else is a bug in the caller : the format is cut short
+       * rather than guessing which argument comes next. */
+      break;
+    }
+  }
+  if (out->wide) {
+    ((wchar_t *)out->buf)[out->len] = 0;
+  } else {
+    ((char *)out->buf)[out->len] = 0;
+  }
+  return out->len;
+}
+
+int formatW(wchar_t *buf, int bufLen, const wchar_t *fmt, ...) {
+  struct FormatOut out = {buf, 0, bufLen, true};
+  va_list args;
+  va_start(args, fmt);
+  const int rv = formatV(&out, fmt, args);
+  va_end(args);
+  return rv;
+}
+
+int formatA(char *buf, int bufLen, const char *fmt, ...) {
+  struct FormatOut out = {buf, 0, bufLen, false};
+  va_list args;
+  va_start(args, fmt);
+  const int rv = formatV(&out, fmt, args);
+  va_end(args);
+  return rv;
+}
+
+static bool isSpace(wchar_t c) { return c == ' ' || c == '\t'; }
+
+bool parseIntW(const wchar_t *text, int *out) {
+  while (isSpace(*text)) {
+    ++text;
+  }
+  const bool negative = *text == '-';
+  if (negative) {
+    ++text;
+  }
+  /* the magnitude is accumulated as unsigned, which has room for INT_MIN. */
+  const unsigned limit = negative ? 0u - (unsigned)INT_MIN : (unsigned)INT_MAX;
+  unsigned val = 0;
+  int digits = 0;
+  for (; *text >= '0' && *text <= '9'; ++text, ++digits) {
+    const unsigned digit = (unsigned)(*text - '0');
+    if (val > (limit - digit) / 10) {
+      return false;
+    }
+    val = val * 10 + digit;
+  }
+  while (isSpace(*text)) {
+    ++text;
+  }
+  if (digits == 0 || *text) {
+    return false;
+  }
+  *out = negative ? (int)(0 - val) : (int)val;
+  return true;
+}
@@ -0,0 +1,26 @@
+#ifndef LAFLOR_FORMAT_H
+#define LAFLOR_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* the little bit of string formatting and parsing that La Flor needs, without
+ * pulling in the C runtime or shlwapi.dll for it : see LAFLOR_NO_CRT in
+ * CMakeLists.txt.
+ *
+ * the supported conversions are %d, %u, %ld, %lu, %s and %%, with an optional
+ * minimum width, padded with zeros if it starts with 0, as in %02d. %s takes a
+ * wchar_t string for formatW() and a char string for formatA(), just like
+ * wnsprintfW() and wnsprintfA() do. the output is truncated to "bufLen"
+ * characters including the terminating 0, which is always written as long as
+ * "bufLen" isn't 0. both return the number of characters written, not
+ * counting the terminating 0. */
+int formatW(wchar_t *buf, int bufLen, const wchar_t *fmt, ...);
+int formatA(char *buf, int bufLen, const char *fmt, ...);
+
+/* parses a decimal integer, optionally negative and surrounded with spaces,
+ * and nothing else. returns false if that's not what "text" holds, or if the
+ * value doesn't fit into an int. */
+bool parseIntW(const wchar_t *text, int *out);
+
+#endif
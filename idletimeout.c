@@ -0,0 +1,45 @@
+#include "idletimeout.h"
+
+static int shorterTimeout(int shortest, int timeout) {
+  return timeout > 0 && (shortest == 0 || timeout < shortest) ? timeout
+                                                              : shortest;
+}
+
+int idleShortestTimeout(const struct IdleTimeouts *timeouts) {
+  int shortest = 0;
+  shortest = shorterTimeout(shortest, timeouts->screenSaver);
+  shortest = shorterTimeout(shortest, timeouts->displayOff);
+  shortest = shorterTimeout(shortest, timeouts->sleep);
+  shortest = shorterTimeout(shortest, timeouts->lock);
+  shortest = shorterTimeout(shortest, timeouts->application);
+  return shortest;
+}
+
+int idleAutoIntervalMs(const struct IdleTimeouts *timeouts) {
+  const int shortest = idleShortestTimeout(timeouts);
+  if (shortest == 0) {
+    return IDLE_FALLBACK_INTERVAL_MS;
+  }
+  /* a tick per day is rare enough for any timeout, and keeps the interval
+   * well within an int. */
+  const long long timeoutMs =
+      shortest < 86400 ? shortest * 1000LL : 86400 * 1000LL;
+  long long marginMs = timeoutMs * IDLE_MARGIN_PERCENT / 100;
+  if (marginMs < IDLE_MIN_MARGIN_MS) {
+    /* a timeout shorter than twice the minimum margin gets half of it as a
+     * margin instead, rather than none at all. */
+    marginMs = IDLE_MIN_MARGIN_MS < timeoutMs / 2 ? IDLE_MIN_MARGIN_MS
+                                                  : timeoutMs / 2;
+  }
+  long long intervalMs = timeoutMs - marginMs;
+  intervalMs -= intervalMs % 1000;
+  return intervalMs > IDLE_MIN_INTERVAL_MS ? (int)intervalMs
+                                           : IDLE_MIN_INTERVAL_MS;
+}
+
+long idleTicksSavedPerHour(int manualMs, int autoMs) {
+  if (manualMs <= 0 || autoMs <= 0) {
+    return 0;
+  }
+  return 3600000L / manualMs - 3600000L / autoMs;
+}
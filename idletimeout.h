@@ -0,0 +1,44 @@
+#ifndef LAFLOR_IDLETIMEOUT_H
+#define LAFLOR_IDLETIMEOUT_H
+
+/* the interval picked when nothing is known to go idle at all : presence
+ * indicators, which La Flor is often used for, tend to go idle after a few
+ * minutes, and this is the longest of the menu's intervals. */
+#define IDLE_FALLBACK_INTERVAL_MS 60000
+/* the ticks come this much earlier than the shortest timeout, in percent of
+ * it, and at least IDLE_MIN_MARGIN_MS earlier, so that a tick which is late,
+ * or whose input took a while to get through, still beats the timeout... */
+#define IDLE_MARGIN_PERCENT 10
+#define IDLE_MIN_MARGIN_MS 5000
+/* ...and never come more often than this. */
+#define IDLE_MIN_INTERVAL_MS 1000
+
+/* the idle timeouts which the injected input has to beat, in seconds, each
+ * being 0 when it doesn't apply, e.g. with the screen saver turned off. every
+ * one of them is reset by any input, injected or not, so a single tick right
+ * before the shortest of them is all it takes. */
+struct IdleTimeouts {
+  int screenSaver;
+  /* the display being turned off, and the system going to sleep, by the
+   * active power plan, for the current power source. */
+  int displayOff;
+  int sleep;
+  /* the machine inactivity limit, which locks the workstation. */
+  int lock;
+  /* whatever the user says an application of theirs needs, e.g. a chat
+   * application which shows them as away. */
+  int application;
+};
+
+/* the shortest of the timeouts which apply, in seconds, or 0 if none do. */
+int idleShortestTimeout(const struct IdleTimeouts *timeouts);
+
+/* the longest interval between ticks, in milliseconds, which still beats all
+ * the timeouts with some margin, rounded down to whole seconds. */
+int idleAutoIntervalMs(const struct IdleTimeouts *timeouts);
+
+/* how many fewer ticks per hour an interval of "autoMs" takes than one of
+ * "manualMs", which is negative if it takes more. */
+long idleTicksSavedPerHour(int manualMs, int autoMs);
+
+#endif
@@ -0,0 +1,39 @@
+#include "layout.h"
+
+#include <string.h>
+
+void layoutInit(struct ScreenLayout *layout) {
+  memset(layout, 0, sizeof(*layout));
+}
+
+bool layoutAddMonitor(struct ScreenLayout *layout, int left, int top,
+                      int right, int bottom) {
+  if (layout->count == LAYOUT_MAX_MONITORS) {
+    return false;
+  }
+  struct ScreenRect *rect = &layout->monitors[layout->count++];
+  rect->left = left;
+  rect->top = top;
+  rect->right = right;
+  rect->bottom = bottom;
+  return true;
+}
+
+static bool rectContains(const struct ScreenRect *rect, int x, int y) {
+  return x >= rect->left && x < rect->right && y >= rect->top &&
+         y < rect->bottom;
+}
+
+int layoutFind(const struct ScreenLayout *layout, int x, int y, int *hint) {
+  if (*hint >= 0 && *hint < layout->count &&
+      rectContains(&layout->monitors[*hint], x, y)) {
+    return *hint;
+  }
+  for (int i = 0; i < layout->count; ++i) {
+    if (rectContains(&layout->monitors[i], x, y)) {
+      *hint = i;
+      return i;
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,42 @@
+#ifndef LAFLOR_LAYOUT_H
+#define LAFLOR_LAYOUT_H
+
+#include <stdbool.h>
+
+/* the maximum number of monitors that are taken into account. any monitors
+ * beyond that are simply treated as if they didn't exist. */
+#define LAYOUT_MAX_MONITORS 16
+
+/* a monitor's rectangle in virtual screen coordinates. as usual for Windows
+ * rectangles, the right and bottom edges are exclusive. */
+struct ScreenRect {
+  int left;
+  int top;
+  int right;
+  int bottom;
+};
+
+/* the arrangement of all monitors making up the virtual screen. monitors can
+ * be placed anywhere relative to the primary one, including at negative
+ * coordinates, and there can be areas of the virtual screen's bounding
+ * rectangle which aren't covered by any monitor at all : the cursor can't ever
+ * go there. */
+struct ScreenLayout {
+  int count;
+  struct ScreenRect monitors[LAYOUT_MAX_MONITORS];
+};
+
+void layoutInit(struct ScreenLayout *layout);
+
+/* returns false if the layout is already full. */
+bool layoutAddMonitor(struct ScreenLayout *layout, int left, int top,
+                      int right, int bottom);
+
+/* returns the index of the monitor containing the given point, or -1 if there
+ * is none. "hint" is the index of the monitor which is checked first, and is
+ * updated to the index of the monitor that was found : since the cursor tends
+ * to stay on the same monitor for a long time, this means that most lookups
+ * need to check only a single rectangle. */
+int layoutFind(const struct ScreenLayout *layout, int x, int y, int *hint);
+
+#endif
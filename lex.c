@@ -0,0 +1,17 @@
+#include "lex.h"
+
+bool lexIsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+bool lexWordIs(const char *text, size_t len, const char *word) {
+  size_t i = 0;
+  for (; i < len && word[i]; ++i) {
+    char c = text[i];
+    if (c >= 'A' && c <= 'Z') {
+      c = (char)(c - 'A' + 'a');
+    }
+    if (c != word[i]) {
+      return false;
+    }
+  }
+  return i == len && word[i] == 0;
+}
@@ -0,0 +1,18 @@
+#ifndef LAFLOR_LEX_H
+#define LAFLOR_LEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* the bits of lexing shared by the configuration file and motion scripts,
+ * which are both lines of words that aren't null-terminated. */
+
+/* whether a character separates words : spaces, tabs, and the carriage
+ * returns of files written on Windows. */
+bool lexIsBlank(char c);
+
+/* compares a word which isn't null-terminated with one that is, ignoring the
+ * case of the former. */
+bool lexWordIs(const char *text, size_t len, const char *word);
+
+#endif
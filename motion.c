@@ -0,0 +1,159 @@
+#include "motion.h"
+
+#include <string.h>
+
+void motionInit(struct MotionState *motion,
+                const struct MotionBackend *backend, int delta) {
+  memset(motion, 0, sizeof(*motion));
+  motion->backend = backend;
+  motion->delta = delta;
+  motion->reconcileEvery = MOTION_DEFAULT_RECONCILE_EVERY;
+}
+
+void motionSetLayout(struct MotionState *motion,
+                     const struct ScreenLayout *layout) {
+  motion->layout = layout;
+  motion->layoutHint = 0;
+  motionInvalidatePosition(motion);
+}
+
+void motionInvalidatePosition(struct MotionState *motion) {
+  motion->positionKnown = false;
+}
+
+static void getCursorPos(struct MotionState *motion, int *x, int *y) {
+  /* in relative mode, the position is always queried, as there's no way of
+   * telling where a relative move actually took the cursor. */
+  if (!motion->absolute || !motion->positionKnown ||
+      motion->ticksSinceReconcile >= motion->reconcileEvery) {
+    const struct MotionBackend *backend = motion->backend;
+    backend->getCursorPos(backend->ctx, &motion->x, &motion->y);
+    ++motion->cursorQueries;
+    motion->positionKnown = true;
+    motion->ticksSinceReconcile = 0;
+  }
+  *x = motion->x;
+  *y = motion->y;
+}
+
+static bool onScreen(struct MotionState *motion, int x, int y) {
+  return layoutFind(motion->layout, x, y, &motion->layoutHint) != -1;
+}
+
+static int bounced(int currentDelta, int wantedDelta) {
+  return currentDelta > 0 ? (-1 * wantedDelta) : wantedDelta;
+}
+
+static void getNewDeltas(struct MotionState *motion) {
+  if (motion->layout == 0 || motion->layout->count == 0) {
+    return;
+  }
+  int x, y;
+  getCursorPos(motion, &x, &y);
+  const int newx = x + motion->currentDeltaX;
+  const int newy = y + motion->currentDeltaY;
+
+  /* each axis is checked separately, by only moving along that axis : this
+   * tells which of the deltas needs to bounce when the cursor is about to hit
+   * the edge of a monitor which has no other monitor next to it. the cursor
+   * can still end up heading diagonally into an area not covered by any
+   * monitor, e.g. the empty corner of an L-shaped layout, in which case both
+   * deltas bounce. */
+  const bool xOk = onScreen(motion, newx, y);
+  const bool yOk = onScreen(motion, x, newy);
+  const bool cornered = xOk && yOk && !onScreen(motion, newx, newy);
+  if (!xOk || cornered) {
+    motion->currentDeltaX = bounced(motion->currentDeltaX, motion->delta);
+  }
+  if (!yOk || cornered) {
+    motion->currentDeltaY = bounced(motion->currentDeltaY, motion->delta);
+  }
+}
+
+void motionSetDelta(struct MotionState *motion, int wantedDelta) {
+  motion->delta = wantedDelta;
+  if (motion->currentDeltaX < 0) {
+    motion->currentDeltaX = motion->currentDeltaY = (-1 * wantedDelta);
+  } else {
+    motion->currentDeltaX = motion->currentDeltaY = wantedDelta;
+  }
+  getNewDeltas(motion);
+}
+
+static int absInt(int val) { return val < 0 ? -val : val; }
+
+/* the position along the smoothstep curve 3t^2 - 2t^3 for t = i/n, scaled by
+ * "distance". everything is done in integers : the intermediate values stay
+ * well within the range of long long for any sane distance and step count. */
+static int easedPosition(int distance, int i, int n) {
+  const long long n3 = (long long)n * n * n;
+  const long long num =
+      (long long)distance * (3LL * i * i * n - 2LL * i * i * i);
+  return (int)(num / n3);
+}
+
+int motionInterpolate(int dx, int dy, struct MotionStep *out, int maxSteps) {
+  const int adx = absInt(dx);
+  const int ady = absInt(dy);
+  int n = adx > ady ? adx : ady;
+  if (n > maxSteps) {
+    n = maxSteps;
+  }
+  if (n <= 1) {
+    out[0].dx = dx;
+    out[0].dy = dy;
+    return 1;
+  }
+
+  /* each step is the difference between two consecutive points on the curve,
+   * which guarantees that rounding errors don't accumulate : the last point is
+   * always exactly (dx, dy). */
+  int prevX = 0, prevY = 0;
+  for (int i = 1; i <= n; ++i) {
+    const int x = easedPosition(dx, i, n);
+    const int y = easedPosition(dy, i, n);
+    out[i - 1].dx = x - prevX;
+    out[i - 1].dy = y - prevY;
+    prevX = x;
+    prevY = y;
+  }
+  return n;
+}
+
+void motionTick(struct MotionState *motion) {
+  /* the deltas are updated before moving : the update looks at where the
+   * cursor would end up after this step, so that it bounces back right away
+   * instead of being pushed against the edge of a monitor, where the system
+   * would clip the move. */
+  getNewDeltas(motion);
+  const int dx = motion->currentDeltaX;
+  const int dy = motion->currentDeltaY;
+  const struct MotionBackend *backend = motion->backend;
+  if (motion->smooth) {
+    if (motion->pathCount == 0 || motion->pathDx != dx ||
+        motion->pathDy != dy) {
+      motion->pathCount =
+          motionInterpolate(dx, dy, motion->path, MOTION_MAX_PATH_STEPS);
+      motion->pathDx = dx;
+      motion->pathDy = dy;
+    }
+  }
+
+  if (motion->absolute && motion->positionKnown) {
+    const int fromX = motion->x;
+    const int fromY = motion->y;
+    motion->x += dx;
+    motion->y += dy;
+    ++motion->ticksSinceReconcile;
+    if (motion->smooth) {
+      backend->sendPathTo(backend->ctx, fromX, fromY, motion->path,
+                          motion->pathCount);
+    } else {
+      backend->sendMoveTo(backend->ctx, motion->x, motion->y);
+    }
+  } else if (motion->smooth) {
+    backend->sendPath(backend->ctx, motion->path, motion->pathCount);
+  } else {
+    backend->sendMove(backend->ctx, dx, dy);
+  }
+}
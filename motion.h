@@ -0,0 +1,113 @@
+#ifndef LAFLOR_MOTION_H
+#define LAFLOR_MOTION_H
+
+#include "layout.h"
+
+#include <stdbool.h>
+
+/* the maximum number of steps that a single smooth move is split into. */
+#define MOTION_MAX_PATH_STEPS 64
+
+/* in absolute mode, the real cursor position is queried at least once every
+ * this many ticks by default. */
+#define MOTION_DEFAULT_RECONCILE_EVERY 60
+
+struct MotionStep {
+  int dx;
+  int dy;
+};
+
+/* the set of platform-specific operations that the motion engine needs in order
+ * to do its job. the engine itself never calls any OS functions directly : the
+ * Windows application provides an implementation based on GetCursorPos() and
+ * SendInput(), while the simulator provides one which just keeps a virtual
+ * cursor in memory. the screen layout isn't queried through the backend, as it
+ * only changes rarely : it's handed to the engine with motionSetLayout()
+ * instead.
+ *
+ * every function receives the "ctx" pointer as its first argument, which is
+ * the usual C way of emulating a bound "this" pointer without any globals.
+ *
+ * sendPath() moves the cursor by each of the given steps in turn, and is
+ * expected to hand all of them to the system at once. sendMoveTo() and
+ * sendPathTo() are their counterparts for absolute mode : they place the
+ * cursor at exact coordinates, with the path starting at (fromX, fromY).
+ * sendWheel() turns the wheel by a number of notches, and is only used by
+ * motion scripts : it may be left null, in which case scripts don't scroll. */
+struct MotionBackend {
+  void *ctx;
+  void (*getCursorPos)(void *ctx, int *x, int *y);
+  void (*sendMove)(void *ctx, int dx, int dy);
+  void (*sendPath)(void *ctx, const struct MotionStep *steps, int count);
+  void (*sendMoveTo)(void *ctx, int x, int y);
+  void (*sendPathTo)(void *ctx, int fromX, int fromY,
+                     const struct MotionStep *steps, int count);
+  void (*sendWheel)(void *ctx, int notches);
+};
+
+/* the part of the application state which describes the bouncing motion. the
+ * cursor moves diagonally by "delta" pixels each tick, and the signs of the
+ * current deltas are flipped whenever the cursor is about to leave the area
+ * covered by monitors on the respective axis.
+ *
+ * in smooth mode, each move is split into a short path of smaller steps which
+ * accelerate and then decelerate. the path is computed into a buffer which is
+ * part of the state, so that no allocations are needed on every tick. since
+ * the deltas only ever change when bouncing off an edge, the path is only
+ * recomputed when the move that it was computed for changes.
+ *
+ * in absolute mode, the engine keeps track of where the cursor is expected to
+ * be instead of asking the system on every tick, and places the cursor at
+ * exact coordinates rather than moving it relatively : relative moves are
+ * scaled by pointer acceleration, so the cursor might not end up exactly
+ * "delta" pixels away. the expected position is reconciled with the real one
+ * every "reconcileEvery" ticks, or on the next tick after
+ * motionInvalidatePosition() is called, which is what should happen whenever
+ * somebody else might have moved the cursor. */
+struct MotionState {
+  const struct MotionBackend *backend;
+  const struct ScreenLayout *layout;
+  int layoutHint;
+  int delta;
+  int currentDeltaX;
+  int currentDeltaY;
+  bool smooth;
+  int pathDx;
+  int pathDy;
+  int pathCount;
+  struct MotionStep path[MOTION_MAX_PATH_STEPS];
+  bool absolute;
+  bool positionKnown;
+  int x;
+  int y;
+  int reconcileEvery;
+  int ticksSinceReconcile;
+  unsigned long long cursorQueries;
+};
+
+void motionInit(struct MotionState *motion,
+                const struct MotionBackend *backend, int delta);
+
+/* sets the layout of the screen that the cursor bounces around in. the layout
+ * is not copied, and must stay valid until it's replaced by another one. */
+void motionSetLayout(struct MotionState *motion,
+                     const struct ScreenLayout *layout);
+
+/* makes the next tick query the real cursor position in absolute mode. */
+void motionInvalidatePosition(struct MotionState *motion);
+
+/* changes the wanted delta while preserving the current direction of
+ * movement. */
+void motionSetDelta(struct MotionState *motion, int wantedDelta);
+
+/* splits a move by (dx, dy) into at most maxSteps steps along an
+ * ease-in/ease-out curve, never using more steps than there are pixels to move
+ * by on the longer axis. the steps always add up to exactly (dx, dy). returns
+ * the number of steps written to "out". */
+int motionInterpolate(int dx, int dy, struct MotionStep *out, int maxSteps);
+
+/* performs a single step of the motion : moves the cursor by the current
+ * deltas and updates them for the next step. */
+void motionTick(struct MotionState *motion);
+
+#endif
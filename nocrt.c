@@ -0,0 +1,118 @@
+/* the few things that La Flor still needs from a C runtime when it's built
+ * without one, i.e. with LAFLOR_NO_CRT : the memory and string functions that
+ * the compiler may emit calls to on its own, the symbol that MSVC expects
+ * whenever floating point is used, and the entry point, which calls wWinMain()
+ * the way that the C runtime would have. the 64-bit arithmetic helpers used
+ * by 32-bit builds and the stack probe come from ntdll.dll instead, which
+ * exports them.
+ *
+ * this is only ever built with MSVC : see CMakeLists.txt. */
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <intrin.h>
+#include <stddef.h>
+
+#pragma function(memset, memcpy, memmove, memcmp, strlen)
+
+/* the linker needs to find this as soon as any floating point is used. */
+int _fltused = 0;
+
+/* rep stosb and rep movsb are about as fast as anything else for the small
+ * sizes that La Flor deals with, and the compiler can't turn them back into
+ * calls to the very functions that they implement. */
+void *memset(void *dst, int c, size_t len) {
+#if defined(_M_IX86) || defined(_M_X64)
+  __stosb(dst, (unsigned char)c, len);
+#else
+  volatile unsigned char *d = dst;
+  while (len--) {
+    *d++ = (unsigned char)c;
+  }
+#endif
+  return dst;
+}
+
+void *memcpy(void *dst, const void *src, size_t len) {
+#if defined(_M_IX86) || defined(_M_X64)
+  __movsb(dst, src, len);
+#else
+  volatile unsigned char *d = dst;
+  const unsigned char *s = src;
+  while (len--) {
+    *d++ = *s++;
+  }
+#endif
+  return dst;
+}
+
+void *memmove(void *dst, const void *src, size_t len) {
+  volatile unsigned char *d = dst;
+  const unsigned char *s = src;
+  if (d <= s || d >= s + len) {
+    return memcpy(dst, src, len);
+  }
+  while (len--) {
+    d[len] = s[len];
+  }
+  return dst;
+}
+
+int memcmp(const void *a, const void *b, size_t len) {
+  const unsigned char *x = a;
+  const unsigned char *y = b;
+  for (size_t i = 0; i < len; ++i) {
+    if (x[i] != y[i]) {
+      return x[i] - y[i];
+    }
+  }
+  return 0;
+}
+
+size_t strlen(const char *str) {
+  const char *end = str;
+  while (*end) {
+    ++end;
+  }
+  return (size_t)(end - str);
+}
+
+int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
+                    PWSTR pCmdLine, int nCmdShow);
+
+/* skips the program name at the start of the command line, along with the
+ * spaces after it, which is what the C runtime does before calling
+ * wWinMain(). the program name may be quoted, and is never escaped. */
+static wchar_t *skipProgramName(wchar_t *cmdLine) {
+  if (*cmdLine == L'"') {
+    ++cmdLine;
+    while (*cmdLine && *cmdLine != L'"') {
+      ++cmdLine;
+    }
+    if (*cmdLine) {
+      ++cmdLine;
+    }
+  } else {
+    while (*cmdLine > L' ') {
+      ++cmdLine;
+    }
+  }
+  while (*cmdLine && *cmdLine <= L' ') {
+    ++cmdLine;
+  }
+  return cmdLine;
+}
+
+/* the entry point, as set with /ENTRY. returning from it would leave the
+ * process running as long as any thread is, so it exits explicitly. */
+void WINAPI laflorEntry(void) {
+  STARTUPINFOW startup;
+  startup.cb = sizeof(startup);
+  GetStartupInfoW(&startup);
+  const int show = (startup.dwFlags & STARTF_USESHOWWINDOW)
+                       ? startup.wShowWindow
+                       : SW_SHOWDEFAULT;
+  ExitProcess((UINT)wWinMain(GetModuleHandleW(0), 0,
+                             skipProgramName(GetCommandLineW()), show));
+}
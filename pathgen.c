@@ -0,0 +1,360 @@
+#include "pathgen.h"
+
+#include <string.h>
+
+/* SSE2 is part of x64, and MSVC only allows assuming it on x86 with /arch:SSE2
+ * or later, which is the default since Visual Studio 2012. */
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PATHGEN_SSE2
+#include <emmintrin.h>
+#endif
+
+/* the strokes are between 16 and 96 points long, in multiples of 4. */
+#define PATHGEN_MIN_STROKE 16
+#define PATHGEN_STROKE_CHOICES 21
+
+/* how far the stroke targets can be from the center, leaving some room for
+ * the Bezier arcs to bulge out. */
+#define PATHGEN_TARGET_RANGE 0.8f
+#define PATHGEN_MAX_BEND 0.3f
+#define PATHGEN_BEZIER_NOISE 0.01f
+
+/* the number of points that the slower axis of the Lissajous figure takes to
+ * go through a whole period. */
+#define PATHGEN_LISSAJOUS_PERIOD 1024
+#define PATHGEN_PI 3.14159265358979
+
+bool pathgenHaveSimd(void) {
+#ifdef PATHGEN_SSE2
+  return true;
+#else
+  return false;
+#endif
+}
+
+static uint32_t xorshift32(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+/* a uniformly distributed value in [-1, 1). */
+static float randomUnit(uint32_t *state) {
+  return (float)(int32_t)xorshift32(state) * (1.0f / 2147483648.0f);
+}
+
+/* the sine and cosine of a small angle, from the first few terms of their
+ * Taylor series, which is exact to float precision for the angles used here :
+ * this keeps the engine from depending on the math library. */
+static void smallSinCos(double angle, float *sinOut, float *cosOut) {
+  const double a2 = angle * angle;
+  *sinOut = (float)(angle * (1 - a2 / 6 * (1 - a2 / 20 * (1 - a2 / 42))));
+  *cosOut = (float)(1 - a2 / 2 * (1 - a2 / 12 * (1 - a2 / 30)));
+}
+
+static void newStroke(struct PathGen *gen) {
+  /* every stroke starts where the previous one ended. the control points are
+   * put along the straight line between the two ends, and then pushed
+   * sideways by a random amount, which bends the arc one way or the other. */
+  uint32_t *rng = &gen->rng[0];
+  gen->x0 = gen->x3;
+  gen->y0 = gen->y3;
+  gen->x3 = randomUnit(rng) * PATHGEN_TARGET_RANGE;
+  gen->y3 = randomUnit(rng) * PATHGEN_TARGET_RANGE;
+  const float dx = gen->x3 - gen->x0;
+  const float dy = gen->y3 - gen->y0;
+  const float bend1 = randomUnit(rng) * PATHGEN_MAX_BEND;
+  const float bend2 = randomUnit(rng) * PATHGEN_MAX_BEND;
+  gen->x1 = gen->x0 + dx / 3 - dy * bend1;
+  gen->y1 = gen->y0 + dy / 3 + dx * bend1;
+  gen->x2 = gen->x0 + dx * 2 / 3 - dy * bend2;
+  gen->y2 = gen->y0 + dy * 2 / 3 + dx * bend2;
+  gen->strokeLen =
+      PATHGEN_MIN_STROKE + 4 * (int)(xorshift32(rng) % PATHGEN_STROKE_CHOICES);
+  gen->strokePos = 0;
+}
+
+void pathgenInit(struct PathGen *gen, enum PathPattern pattern,
+                 uint32_t seed) {
+  memset(gen, 0, sizeof(*gen));
+  gen->pattern = pattern;
+  gen->simd = pathgenHaveSimd();
+  gen->noise = pattern == PATHGEN_BEZIER ? PATHGEN_BEZIER_NOISE : 0;
+  /* xorshift must never be seeded with 0, which it would never leave. */
+  for (int i = 0; i < 4; ++i) {
+    gen->rng[i] = (seed + 0x9e3779b9u * (i + 1)) | 1;
+  }
+  newStroke(gen);
+
+  /* the Lissajous figure goes through x = sin(3a) and y = sin(2a), with "a"
+   * advancing by the same amount for every point. just like the strokes, it
+   * starts from the center of its box. */
+  const double step = 2 * PATHGEN_PI / PATHGEN_LISSAJOUS_PERIOD;
+  for (int i = 0; i < 4; ++i) {
+    smallSinCos(3 * step * i, &gen->sinX[i], &gen->cosX[i]);
+    smallSinCos(2 * step * i, &gen->sinY[i], &gen->cosY[i]);
+  }
+  smallSinCos(3 * step * 4, &gen->rotSinX, &gen->rotCosX);
+  smallSinCos(2 * step * 4, &gen->rotSinY, &gen->rotCosY);
+}
+
+/* the plain C kernels. each of them computes the 4 points starting at index
+ * "i", exactly the way their SSE2 counterparts do. */
+
+static void minJerkScalar(struct PathGen *gen, int i) {
+  const float inv = 1.0f / gen->strokeLen;
+  for (int k = 0; k < 4; ++k) {
+    const float t = (float)(gen->strokePos + k + 1) * inv;
+    const float s = t * t * t * (10 + t * (-15 + t * 6));
+    gen->x[i + k] = gen->x0 + (gen->x3 - gen->x0) * s;
+    gen->y[i + k] = gen->y0 + (gen->y3 - gen->y0) * s;
+  }
+}
+
+static void bezierScalar(struct PathGen *gen, int i) {
+  const float inv = 1.0f / gen->strokeLen;
+  for (int k = 0; k < 4; ++k) {
+    const float t = (float)(gen->strokePos + k + 1) * inv;
+    const float u = 1 - t;
+    const float b0 = u * u * u;
+    const float b1 = 3 * u * u * t;
+    const float b2 = 3 * u * t * t;
+    const float b3 = t * t * t;
+    const float nx = randomUnit(&gen->rng[k]) * gen->noise;
+    const float ny = randomUnit(&gen->rng[k]) * gen->noise;
+    gen->x[i + k] =
+        b0 * gen->x0 + b1 * gen->x1 + b2 * gen->x2 + b3 * gen->x3 + nx;
+    gen->y[i + k] =
+        b0 * gen->y0 + b1 * gen->y1 + b2 * gen->y2 + b3 * gen->y3 + ny;
+  }
+}
+
+/* rotates the (cos, sin) pairs of the 4 lanes by the given angle. */
+static void rotateScalar(float *c, float *s, float rotCos, float rotSin) {
+  for (int k = 0; k < 4; ++k) {
+    const float nc = c[k] * rotCos - s[k] * rotSin;
+    s[k] = s[k] * rotCos + c[k] * rotSin;
+    c[k] = nc;
+  }
+}
+
+/* pulls the (cos, sin) pairs back onto the unit circle, which the rounding
+ * errors of the rotations slowly take them away from. the pairs are always
+ * very close to it, so a single Newton step of 1/sqrt(x) around 1 is
+ * enough. */
+static void renormalizeScalar(float *c, float *s) {
+  for (int k = 0; k < 4; ++k) {
+    const float f = (3 - (c[k] * c[k] + s[k] * s[k])) * 0.5f;
+    c[k] *= f;
+    s[k] *= f;
+  }
+}
+
+static void lissajousScalar(struct PathGen *gen, int i) {
+  memcpy(&gen->x[i], gen->sinX, sizeof(gen->sinX));
+  memcpy(&gen->y[i], gen->sinY, sizeof(gen->sinY));
+  rotateScalar(gen->cosX, gen->sinX, gen->rotCosX, gen->rotSinX);
+  rotateScalar(gen->cosY, gen->sinY, gen->rotCosY, gen->rotSinY);
+}
+
+#ifdef PATHGEN_SSE2
+/* pathgenSteps() stores pairs of ints straight into MotionStep structs. */
+typedef char PathgenStepIsTwoInts[sizeof(struct MotionStep) == 2 * sizeof(int)
+                                      ? 1
+                                      : -1];
+
+/* the SSE2 kernels. all the loads and stores are unaligned ones, which cost
+ * the same as aligned ones on anything from the last decade, and spare the
+ * struct from any alignment requirements. */
+
+static __m128 strokeTimes(const struct PathGen *gen) {
+  const __m128 inv = _mm_set1_ps(1.0f / gen->strokeLen);
+  const __m128 pos = _mm_add_ps(_mm_set1_ps((float)(gen->strokePos + 1)),
+                                _mm_set_ps(3, 2, 1, 0));
+  return _mm_mul_ps(pos, inv);
+}
+
+static void minJerkSse2(struct PathGen *gen, int i) {
+  const __m128 t = strokeTimes(gen);
+  const __m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+  const __m128 poly = _mm_add_ps(
+      _mm_set1_ps(10),
+      _mm_mul_ps(t, _mm_add_ps(_mm_set1_ps(-15),
+                               _mm_mul_ps(t, _mm_set1_ps(6)))));
+  const __m128 s = _mm_mul_ps(t3, poly);
+  _mm_storeu_ps(&gen->x[i],
+                _mm_add_ps(_mm_set1_ps(gen->x0),
+                           _mm_mul_ps(_mm_set1_ps(gen->x3 - gen->x0), s)));
+  _mm_storeu_ps(&gen->y[i],
+                _mm_add_ps(_mm_set1_ps(gen->y0),
+                           _mm_mul_ps(_mm_set1_ps(gen->y3 - gen->y0), s)));
+}
+
+/* advances the 4 xorshift32 states at once, and returns their new values as
+ * floats in [-1, 1). */
+static __m128 randomUnitSse2(__m128i *state) {
+  __m128i x = *state;
+  x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+  x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+  *state = x;
+  return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / 2147483648.0f));
+}
+
+static __m128 bezierAxis(__m128 b0, __m128 b1, __m128 b2, __m128 b3, float p0,
+                         float p1, float p2, float p3) {
+  return _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(b0, _mm_set1_ps(p0)),
+                 _mm_mul_ps(b1, _mm_set1_ps(p1))),
+      _mm_add_ps(_mm_mul_ps(b2, _mm_set1_ps(p2)),
+                 _mm_mul_ps(b3, _mm_set1_ps(p3))));
+}
+
+static void bezierSse2(struct PathGen *gen, int i) {
+  const __m128 t = strokeTimes(gen);
+  const __m128 u = _mm_sub_ps(_mm_set1_ps(1), t);
+  const __m128 three = _mm_set1_ps(3);
+  const __m128 b0 = _mm_mul_ps(_mm_mul_ps(u, u), u);
+  const __m128 b1 = _mm_mul_ps(_mm_mul_ps(three, _mm_mul_ps(u, u)), t);
+  const __m128 b2 = _mm_mul_ps(_mm_mul_ps(three, u), _mm_mul_ps(t, t));
+  const __m128 b3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+  __m128i rng = _mm_loadu_si128((const __m128i *)gen->rng);
+  const __m128 noise = _mm_set1_ps(gen->noise);
+  const __m128 nx = _mm_mul_ps(randomUnitSse2(&rng), noise);
+  const __m128 ny = _mm_mul_ps(randomUnitSse2(&rng), noise);
+  _mm_storeu_si128((__m128i *)gen->rng, rng);
+  _mm_storeu_ps(&gen->x[i], _mm_add_ps(bezierAxis(b0, b1, b2, b3, gen->x0,
+                                                  gen->x1, gen->x2, gen->x3),
+                                       nx));
+  _mm_storeu_ps(&gen->y[i], _mm_add_ps(bezierAxis(b0, b1, b2, b3, gen->y0,
+                                                  gen->y1, gen->y2, gen->y3),
+                                       ny));
+}
+
+static void rotateSse2(float *c, float *s, float rotCos, float rotSin) {
+  const __m128 vc = _mm_loadu_ps(c);
+  const __m128 vs = _mm_loadu_ps(s);
+  const __m128 rc = _mm_set1_ps(rotCos);
+  const __m128 rs = _mm_set1_ps(rotSin);
+  _mm_storeu_ps(c, _mm_sub_ps(_mm_mul_ps(vc, rc), _mm_mul_ps(vs, rs)));
+  _mm_storeu_ps(s, _mm_add_ps(_mm_mul_ps(vs, rc), _mm_mul_ps(vc, rs)));
+}
+
+static void renormalizeSse2(float *c, float *s) {
+  const __m128 vc = _mm_loadu_ps(c);
+  const __m128 vs = _mm_loadu_ps(s);
+  const __m128 norm = _mm_add_ps(_mm_mul_ps(vc, vc), _mm_mul_ps(vs, vs));
+  const __m128 f =
+      _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(3), norm), _mm_set1_ps(0.5f));
+  _mm_storeu_ps(c, _mm_mul_ps(vc, f));
+  _mm_storeu_ps(s, _mm_mul_ps(vs, f));
+}
+
+static void lissajousSse2(struct PathGen *gen, int i) {
+  _mm_storeu_ps(&gen->x[i], _mm_loadu_ps(gen->sinX));
+  _mm_storeu_ps(&gen->y[i], _mm_loadu_ps(gen->sinY));
+  rotateSse2(gen->cosX, gen->sinX, gen->rotCosX, gen->rotSinX);
+  rotateSse2(gen->cosY, gen->sinY, gen->rotCosY, gen->rotSinY);
+}
+#endif
+
+void pathgenChunk(struct PathGen *gen) {
+  void (*kernel)(struct PathGen *, int);
+  void (*renormalize)(float *, float *) = renormalizeScalar;
+  switch (gen->pattern) {
+  case PATHGEN_MIN_JERK:
+    kernel = minJerkScalar;
+    break;
+  case PATHGEN_BEZIER:
+    kernel = bezierScalar;
+    break;
+  default:
+    kernel = lissajousScalar;
+    break;
+  }
+#ifdef PATHGEN_SSE2
+  if (gen->simd) {
+    kernel = gen->pattern == PATHGEN_MIN_JERK ? minJerkSse2
+             : gen->pattern == PATHGEN_BEZIER ? bezierSse2
+                                              : lissajousSse2;
+    renormalize = renormalizeSse2;
+  }
+#endif
+
+  for (int i = 0; i < PATHGEN_CHUNK; i += 4) {
+    kernel(gen, i);
+    /* the strokes are made of whole groups of 4 points, so a group never
+     * spans two of them. */
+    gen->strokePos += 4;
+    if (gen->strokePos == gen->strokeLen) {
+      newStroke(gen);
+    }
+  }
+  if (gen->pattern == PATHGEN_LISSAJOUS) {
+    renormalize(gen->cosX, gen->sinX);
+    renormalize(gen->cosY, gen->sinY);
+  }
+}
+
+/* rounds half away from zero. */
+static int roundToInt(float val) {
+  return (int)(val < 0 ? val - 0.5f : val + 0.5f);
+}
+
+#ifdef PATHGEN_SSE2
+/* rounds the same way as roundToInt(), rather than to even like
+ * _mm_cvtps_epi32() : 0.5 gets the sign of each value, is added to it, and the
+ * sum is truncated. */
+static __m128i roundSse2(__m128 val) {
+  const __m128 sign = _mm_and_ps(val, _mm_set1_ps(-0.0f));
+  const __m128 half = _mm_or_ps(sign, _mm_set1_ps(0.5f));
+  return _mm_cvttps_epi32(_mm_add_ps(val, half));
+}
+#endif
+
+void pathgenSteps(struct PathGen *gen, float scale, struct MotionStep *out) {
+  /* the points are rounded to whole pixels, and each step is the difference
+   * between two consecutive rounded points, the first one being the last
+   * point of the previous chunk. */
+  pathgenChunk(gen);
+#ifdef PATHGEN_SSE2
+  if (gen->simd) {
+    /* the steps are computed 4 at a time. the previous point of each lane is
+     * the current point of the lane before it, which is what shifting the
+     * whole register by one lane gives, with the last point of the previous
+     * group shifted in. the x and y steps are then interleaved into
+     * MotionStep structs, which are just pairs of ints. */
+    const __m128 vscale = _mm_set1_ps(scale);
+    __m128i carryX = _mm_cvtsi32_si128(gen->lastX);
+    __m128i carryY = _mm_cvtsi32_si128(gen->lastY);
+    for (int i = 0; i < PATHGEN_CHUNK; i += 4) {
+      const __m128i px =
+          roundSse2(_mm_mul_ps(_mm_loadu_ps(&gen->x[i]), vscale));
+      const __m128i py =
+          roundSse2(_mm_mul_ps(_mm_loadu_ps(&gen->y[i]), vscale));
+      const __m128i dx =
+          _mm_sub_epi32(px, _mm_or_si128(_mm_slli_si128(px, 4), carryX));
+      const __m128i dy =
+          _mm_sub_epi32(py, _mm_or_si128(_mm_slli_si128(py, 4), carryY));
+      carryX = _mm_srli_si128(px, 12);
+      carryY = _mm_srli_si128(py, 12);
+      _mm_storeu_si128((__m128i *)&out[i], _mm_unpacklo_epi32(dx, dy));
+      _mm_storeu_si128((__m128i *)&out[i + 2], _mm_unpackhi_epi32(dx, dy));
+    }
+    gen->lastX = _mm_cvtsi128_si32(carryX);
+    gen->lastY = _mm_cvtsi128_si32(carryY);
+    return;
+  }
+#endif
+  for (int i = 0; i < PATHGEN_CHUNK; ++i) {
+    const int px = roundToInt(gen->x[i] * scale);
+    const int py = roundToInt(gen->y[i] * scale);
+    out[i].dx = px - gen->lastX;
+    out[i].dy = py - gen->lastY;
+    gen->lastX = px;
+    gen->lastY = py;
+  }
+}
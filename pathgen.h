@@ -0,0 +1,80 @@
+#ifndef LAFLOR_PATHGEN_H
+#define LAFLOR_PATHGEN_H
+
+#include "motion.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* the number of points generated at once. this is also the number of steps that
+ * a single tick moves the cursor by, so it must not exceed
+ * MOTION_MAX_PATH_STEPS. it must be a multiple of 4, the number of points that
+ * the kernels compute at once. */
+#define PATHGEN_CHUNK 32
+
+enum PathPattern {
+  /* strokes between random points, along the minimum jerk profile
+   * 10t^3 - 15t^4 + 6t^5 : the way a hand moves when it's aiming at
+   * something. */
+  PATHGEN_MIN_JERK,
+  /* strokes between random points along cubic Bezier arcs, with some noise on
+   * top, for a less purposeful look. */
+  PATHGEN_BEZIER,
+  /* a Lissajous figure with a 3:2 frequency ratio, which keeps sweeping over
+   * most of its bounding box. */
+  PATHGEN_LISSAJOUS,
+  PATHGEN_PATTERN_COUNT
+};
+
+/* a generator of natural-looking paths, which produces its points in chunks of
+ * PATHGEN_CHUNK, lazily, into the buffers below : nothing is allocated, and
+ * the cost of generating a chunk doesn't depend on anything but the pattern.
+ * the points are in the [-1, 1] square, and are scaled to pixels by
+ * pathgenSteps(). the buffers are laid out as separate arrays of x and y
+ * coordinates, so that the kernels can work on 4 points at a time.
+ *
+ * the kernels use SSE2 wherever it's available, which it is on every x64
+ * build, and on any x86 build allowed to assume it. "simd" can be cleared in
+ * order to run the equivalent plain C kernels instead, which is what the
+ * benchmark compares them against. */
+struct PathGen {
+  float x[PATHGEN_CHUNK];
+  float y[PATHGEN_CHUNK];
+  enum PathPattern pattern;
+  bool simd;
+  /* four independent xorshift32 states, one for each lane of the kernels. */
+  uint32_t rng[4];
+  /* the current stroke, for the stroke-based patterns : "strokeLen" points
+   * from (x0, y0) to (x3, y3), with (x1, y1) and (x2, y2) as the Bezier
+   * control points. */
+  float x0, y0, x1, y1, x2, y2, x3, y3;
+  int strokePos;
+  int strokeLen;
+  float noise;
+  /* the cosines and sines of the current angles of the Lissajous figure's
+   * two axes, for 4 consecutive points, and the rotations which advance them
+   * by 4 points. */
+  float cosX[4], sinX[4], cosY[4], sinY[4];
+  float rotCosX, rotSinX, rotCosY, rotSinY;
+  /* where the previous chunk left the cursor, in pixels, relative to where the
+   * generator started. */
+  int lastX;
+  int lastY;
+};
+
+/* whether the SSE2 kernels have been compiled in. */
+bool pathgenHaveSimd(void);
+
+void pathgenInit(struct PathGen *gen, enum PathPattern pattern, uint32_t seed);
+
+/* generates the next PATHGEN_CHUNK points into gen->x and gen->y. */
+void pathgenChunk(struct PathGen *gen);
+
+/* generates the next chunk, and turns it into PATHGEN_CHUNK relative steps,
+ * with the pattern scaled so that the [-1, 1] square spans "scale" pixels on
+ * each side of where the generator started. the points are rounded half away
+ * from zero by both kinds of kernels, and rounding errors don't accumulate
+ * across chunks. */
+void pathgenSteps(struct PathGen *gen, float scale, struct MotionStep *out);
+
+#endif
@@ -0,0 +1,163 @@
+#include "scheduler.h"
+
+#include <string.h>
+
+void schedulerInit(struct TickScheduler *sched) {
+  memset(sched, 0, sizeof(*sched));
+}
+
+void schedulerSetSpread(struct TickScheduler *sched, bool spread,
+                        uint32_t seed) {
+  sched->spread = spread;
+  /* Fibonacci hashing : multiplying by 2^32 divided by the golden ratio
+   * scatters consecutive seeds over the whole range, each one landing in the
+   * largest gap left by the ones before it. */
+  const uint32_t hash = seed * 2654435769u;
+  sched->phase = hash >> 16;
+  /* xorshift32 never leaves 0. */
+  sched->rng = hash ^ 0x2545f491u;
+  if (sched->rng == 0) {
+    sched->rng = 1;
+  }
+}
+
+static uint32_t nextRandom(struct TickScheduler *sched) {
+  uint32_t x = sched->rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return sched->rng = x;
+}
+
+/* the first point of the grid after "afterUs", which is no more than a period
+ * after it. */
+static long long nextGridPoint(const struct TickScheduler *sched,
+                               long long afterUs) {
+  const long long offsetUs =
+      sched->periodUs * sched->phase / SCHEDULER_PHASE_ONE;
+  long long sincePointUs = (afterUs - offsetUs) % sched->periodUs;
+  if (sincePointUs < 0) {
+    sincePointUs += sched->periodUs;
+  }
+  return afterUs - sincePointUs + sched->periodUs;
+}
+
+/* makes "gridUs" the next point of the grid, and works out the deadline that
+ * goes with it. */
+static void setGridPoint(struct TickScheduler *sched, long long gridUs) {
+  sched->gridUs = gridUs;
+  sched->postponed = false;
+  sched->nextDeadlineUs = gridUs;
+  if (sched->spread) {
+    long long maxJitterUs = sched->periodUs >> SCHEDULER_JITTER_SHIFT;
+    if (maxJitterUs > SCHEDULER_MAX_JITTER_US) {
+      maxJitterUs = SCHEDULER_MAX_JITTER_US;
+    }
+    if (maxJitterUs > 0) {
+      sched->nextDeadlineUs += nextRandom(sched) % maxJitterUs;
+    }
+  }
+}
+
+void schedulerStart(struct TickScheduler *sched, long long nowUs,
+                    long long periodUs) {
+  sched->periodUs = periodUs;
+  setGridPoint(sched, sched->spread ? nextGridPoint(sched, nowUs)
+                                    : nowUs + periodUs);
+}
+
+void schedulerSetPeriod(struct TickScheduler *sched, long long nowUs,
+                        long long periodUs) {
+  const long long lastGridUs = sched->gridUs - sched->periodUs;
+  sched->periodUs = periodUs;
+  long long gridUs = sched->spread ? nextGridPoint(sched, lastGridUs)
+                                   : lastGridUs + periodUs;
+  /* with a shorter period, the deadline which keeps the phase may well have
+   * passed already. the deadlines in between were never going to be ticked
+   * at, so none of them is missed, and the next tick isn't late either : it
+   * just happens now, or at the next point of the grid. */
+  if (gridUs <= nowUs) {
+    gridUs = sched->spread ? nextGridPoint(sched, nowUs) : nowUs;
+  }
+  setGridPoint(sched, gridUs);
+}
+
+static int bitLength(unsigned long long val) {
+  int rv = 0;
+  while (val) {
+    ++rv;
+    val >>= 1;
+  }
+  return rv;
+}
+
+static void recordJitter(struct TickStats *stats, long long jitterUs) {
+  /* waitable timers are allowed to fire a tiny bit early : these are counted
+   * as being on time. */
+  if (jitterUs < 0) {
+    jitterUs = 0;
+  }
+  int bucket = bitLength((unsigned long long)jitterUs);
+  if (bucket >= SCHEDULER_HISTOGRAM_BUCKETS) {
+    bucket = SCHEDULER_HISTOGRAM_BUCKETS - 1;
+  }
+  ++stats->histogram[bucket];
+  ++stats->ticks;
+  stats->jitterSumUs += jitterUs;
+  if (jitterUs > stats->jitterMaxUs) {
+    stats->jitterMaxUs = jitterUs;
+  }
+}
+
+long long schedulerOnFire(struct TickScheduler *sched, long long nowUs) {
+  recordJitter(&sched->stats, nowUs - sched->nextDeadlineUs);
+  if (sched->spread && sched->postponed) {
+    /* a postponed deadline is off the grid, so the grid points between it
+     * and now were never meant to be ticked at, and the one right after now
+     * could come just after this tick. */
+    setGridPoint(sched, nextGridPoint(sched, nowUs + sched->periodUs / 2));
+    return sched->nextDeadlineUs;
+  }
+  long long gridUs = sched->spread ? nextGridPoint(sched, sched->gridUs)
+                                   : sched->gridUs + sched->periodUs;
+  if (gridUs <= nowUs) {
+    const long long skipped = (nowUs - gridUs) / sched->periodUs + 1;
+    sched->stats.missed += skipped;
+    gridUs += skipped * sched->periodUs;
+  }
+  setGridPoint(sched, gridUs);
+  return sched->nextDeadlineUs;
+}
+
+void schedulerPostpone(struct TickScheduler *sched, long long nowUs,
+                       long long delayUs) {
+  /* an explicit delay is taken as it is, without any jitter. */
+  sched->gridUs = sched->nextDeadlineUs = nowUs + delayUs;
+  sched->postponed = true;
+}
+
+long long schedulerDelayUs(const struct TickScheduler *sched, long long nowUs) {
+  const long long delay = sched->nextDeadlineUs - nowUs;
+  return delay > 0 ? delay : 0;
+}
+
+long long schedulerJitterPercentileUs(const struct TickStats *stats,
+                                      int percentile) {
+  if (stats->ticks == 0) {
+    return 0;
+  }
+  /* the number of ticks which must be at or below the returned value, rounded
+   * up. */
+  const long long wanted = (stats->ticks * percentile + 99) / 100;
+  long long seen = 0;
+  for (int i = 0; i < SCHEDULER_HISTOGRAM_BUCKETS; ++i) {
+    seen += stats->histogram[i];
+    if (seen >= wanted) {
+      /* the largest value with a bit length of i, which obviously can't be
+       * larger than the largest value seen. */
+      const long long bound = i == 0 ? 0 : (1LL << i) - 1;
+      return bound < stats->jitterMaxUs ? bound : stats->jitterMaxUs;
+    }
+  }
+  return stats->jitterMaxUs;
+}
@@ -0,0 +1,117 @@
+#ifndef LAFLOR_SCHEDULER_H
+#define LAFLOR_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* number of buckets in the jitter histogram. bucket N holds ticks whose
+ * lateness in microseconds has a bit length of N, i.e. bucket 0 is "on time",
+ * bucket 1 is 1us late, bucket 2 is 2-3us late, bucket 11 is 1.024-2.047ms
+ * late and so on. 32 buckets are more than enough for over half an hour of
+ * lateness. */
+#define SCHEDULER_HISTOGRAM_BUCKETS 32
+
+/* with phase spreading, the phase is a fraction of the period, out of this
+ * much... */
+#define SCHEDULER_PHASE_ONE 65536
+/* ...and every deadline comes up to a period shifted right by this much late,
+ * i.e. up to about 1.5% of the period... */
+#define SCHEDULER_JITTER_SHIFT 6
+/* ...but never more than this many microseconds late. */
+#define SCHEDULER_MAX_JITTER_US 1000000
+
+/* the shortest interval between ticks, in ms, which is also the shortest
+ * interval of the menu. whatever sets the interval, be it the menu, the
+ * command line, the control pipe, the configuration file or the waits of a
+ * script, can't make the ticks come any more often than that. */
+#define SCHEDULER_MIN_INTERVAL_MS 250
+
+struct TickStats {
+  long long ticks;
+  /* number of deadlines which were skipped entirely because the tick came in
+   * more than a whole period late. */
+  long long missed;
+  long long jitterSumUs;
+  long long jitterMaxUs;
+  unsigned long histogram[SCHEDULER_HISTOGRAM_BUCKETS];
+};
+
+/* a scheduler which computes tick deadlines in absolute time. each deadline is
+ * exactly one period after the previous deadline, regardless of when the tick
+ * for the previous deadline actually ran : this means that any lateness in
+ * processing a tick does not accumulate over time, unlike when the next tick
+ * is scheduled relative to the current one.
+ *
+ * the scheduler doesn't read any clocks on its own : the current time, in
+ * microseconds of any monotonic clock, is always passed in by the caller.
+ *
+ * with phase spreading, see schedulerSetSpread(), the deadlines are points
+ * of a grid of the clock, one period apart and offset by the scheduler's
+ * phase, plus a little random jitter each. */
+struct TickScheduler {
+  long long periodUs;
+  long long nextDeadlineUs;
+  /* the point of the grid that the next deadline comes after, which is the
+   * deadline itself without phase spreading. */
+  long long gridUs;
+  /* set when the next deadline was put off the grid by schedulerPostpone(). */
+  bool postponed;
+  bool spread;
+  unsigned phase;
+  uint32_t rng;
+  struct TickStats stats;
+};
+
+void schedulerInit(struct TickScheduler *sched);
+
+/* spreads the ticks of the many schedulers which run on the same machine,
+ * such as La Flor's in every session of a terminal server, over the whole
+ * period, rather than having all of them tick at once because they were all
+ * started at once. "seed" tells the schedulers apart, e.g. the session ID :
+ * it decides the phase, which is stable, and seeds the jitter, which keeps
+ * schedulers with close phases from ticking in lockstep. consecutive seeds
+ * get phases which are as far apart as possible, for any number of them.
+ *
+ * this takes effect with the next deadline which gets computed. the clock
+ * must be the same for all of the schedulers, counting from the same
+ * origin. */
+void schedulerSetSpread(struct TickScheduler *sched, bool spread,
+                        uint32_t seed);
+
+/* starts a new series of ticks, with the first deadline one period from now,
+ * or at the first point of the grid within a period with phase spreading. the
+ * collected statistics are preserved. */
+void schedulerStart(struct TickScheduler *sched, long long nowUs,
+                    long long periodUs);
+
+/* changes the period while preserving the phase : the next deadline becomes
+ * one new period after the last one, or the first point of the new grid
+ * within a new period of the last one with phase spreading. if that's no
+ * later than "nowUs", the next deadline is now instead, or the first point of
+ * the new grid after now, and no deadline counts as missed. */
+void schedulerSetPeriod(struct TickScheduler *sched, long long nowUs,
+                        long long periodUs);
+
+/* records that the tick for the current deadline has fired at "nowUs" and
+ * advances to the next deadline, which is returned. if the tick was so late
+ * that one or more following deadlines have passed too, these are skipped
+ * rather than fired in a quick burst. */
+long long schedulerOnFire(struct TickScheduler *sched, long long nowUs);
+
+/* moves the next deadline to "delayUs" from now, with the following deadlines
+ * continuing one period apart from there. with phase spreading, the deadline
+ * after that one goes back onto the grid instead, at least half a period
+ * after the postponed tick actually ran, without any deadline counting as
+ * missed in between. */
+void schedulerPostpone(struct TickScheduler *sched, long long nowUs,
+                       long long delayUs);
+
+/* the time left until the next deadline, never negative. */
+long long schedulerDelayUs(const struct TickScheduler *sched, long long nowUs);
+
+/* an upper bound of the given percentile (0-100) of tick lateness, based on
+ * the histogram. */
+long long schedulerJitterPercentileUs(const struct TickStats *stats,
+                                      int percentile);
+
+#endif
@@ -0,0 +1,400 @@
+#include "script.h"
+#include "lex.h"
+#include "scheduler.h"
+
+#include <string.h>
+
+/* the number of steps that a glide is split into, at most. */
+#define SCRIPT_GLIDE_STEPS 16
+
+/* the state of the compiler, as it goes through the lines of a script. */
+struct ScriptCompiler {
+  struct ScriptProgram *out;
+  struct ScriptError *err;
+  const char *pos;
+  const char *end;
+  int line;
+  /* the lines of the loops which haven't been closed yet, for reporting. */
+  int depth;
+  int loopLines[SCRIPT_MAX_DEPTH];
+};
+
+static bool fail(struct ScriptCompiler *c, const char *message) {
+  c->err->line = c->line;
+  c->err->message = message;
+  return false;
+}
+
+/* the next word of the current line, which ends at "lineEnd". returns false if
+ * there's none left. */
+static bool nextWord(struct ScriptCompiler *c, const char *lineEnd,
+                     const char **word, size_t *len) {
+  while (c->pos < lineEnd && lexIsBlank(*c->pos)) {
+    ++c->pos;
+  }
+  if (c->pos == lineEnd) {
+    return false;
+  }
+  *word = c->pos;
+  while (c->pos < lineEnd && !lexIsBlank(*c->pos)) {
+    ++c->pos;
+  }
+  *len = (size_t)(c->pos - *word);
+  return true;
+}
+
+/* parses the digits at the start of a word, with an optional sign. "*used" is
+ * set to the number of characters that were part of the number. */
+static bool parseNumber(const char *text, size_t len, long long max,
+                        long long *out, size_t *used) {
+  size_t i = 0;
+  const bool negative = len > 0 && text[0] == '-';
+  i += negative || (len > 0 && text[0] == '+');
+  const size_t digits = i;
+  long long val = 0;
+  for (; i < len && text[i] >= '0' && text[i] <= '9'; ++i) {
+    val = val * 10 + (text[i] - '0');
+    if (val > max) {
+      return false;
+    }
+  }
+  if (i == digits) {
+    return false;
+  }
+  *out = negative ? -val : val;
+  *used = i;
+  return true;
+}
+
+static bool parseInteger(struct ScriptCompiler *c, const char *lineEnd,
+                         long long min, long long max, long long *out) {
+  const char *word;
+  size_t len, used;
+  if (!nextWord(c, lineEnd, &word, &len)) {
+    return fail(c, "a number is missing");
+  }
+  if (!parseNumber(word, len, max, out, &used) || used != len || *out < min) {
+    return fail(c, "not a valid number");
+  }
+  return true;
+}
+
+/* returns the number of milliseconds in the given unit, or 0 if it's not
+ * one. */
+static long long unitMs(const char *word, size_t len) {
+  if (len == 0 || lexWordIs(word, len, "ms")) {
+    return 1;
+  } else if (lexWordIs(word, len, "s")) {
+    return 1000;
+  } else if (lexWordIs(word, len, "min")) {
+    return 60000;
+  }
+  return 0;
+}
+
+/* parses a duration, with its unit either stuck to the number, as in "40s",
+ * or following it, as in "40 s". */
+static bool parseDuration(struct ScriptCompiler *c, const char *lineEnd,
+                          long long *out) {
+  const char *word;
+  size_t len, used;
+  long long value;
+  if (!nextWord(c, lineEnd, &word, &len) ||
+      !parseNumber(word, len, SCRIPT_MAX_MS, &value, &used) || value < 0) {
+    return fail(c, "not a valid duration");
+  }
+  long long unit = unitMs(word + used, len - used);
+  if (unit == 0) {
+    return fail(c, "unknown unit");
+  }
+  if (used == len) {
+    /* the unit might be the next word. */
+    const char *const save = c->pos;
+    const char *next;
+    size_t nextLen;
+    if (nextWord(c, lineEnd, &next, &nextLen) && unitMs(next, nextLen)) {
+      unit = unitMs(next, nextLen);
+    } else {
+      c->pos = save;
+    }
+  }
+  if (value * unit > SCRIPT_MAX_MS) {
+    return fail(c, "the duration is too long");
+  }
+  *out = value * unit;
+  return true;
+}
+
+static bool emit(struct ScriptCompiler *c, unsigned value, int bytes) {
+  struct ScriptProgram *out = c->out;
+  if (SCRIPT_MAX_CODE - out->len < (size_t)bytes) {
+    return fail(c, "the script is too long");
+  }
+  for (int i = 0; i < bytes; ++i) {
+    out->code[out->len++] = (unsigned char)(value >> (8 * i));
+  }
+  return true;
+}
+
+static bool compileMove(struct ScriptCompiler *c, const char *lineEnd,
+                        enum ScriptOp op) {
+  long long dx, dy;
+  return parseInteger(c, lineEnd, -SCRIPT_MAX_DISTANCE, SCRIPT_MAX_DISTANCE,
+                      &dx) &&
+         parseInteger(c, lineEnd, -SCRIPT_MAX_DISTANCE, SCRIPT_MAX_DISTANCE,
+                      &dy) &&
+         emit(c, op, 1) && emit(c, (unsigned)dx, 2) && emit(c, (unsigned)dy, 2);
+}
+
+static bool compileWait(struct ScriptCompiler *c, const char *lineEnd) {
+  long long ms, jitterMs = 0;
+  if (!parseDuration(c, lineEnd, &ms)) {
+    return false;
+  }
+  const char *save = c->pos, *word;
+  size_t len;
+  if (nextWord(c, lineEnd, &word, &len)) {
+    c->pos = save;
+    if (!parseDuration(c, lineEnd, &jitterMs)) {
+      return false;
+    }
+  }
+  if (ms < SCHEDULER_MIN_INTERVAL_MS) {
+    return fail(c, "the wait is too short");
+  }
+  if (jitterMs >= ms) {
+    return fail(c, "the jitter must be shorter than the wait");
+  }
+  if (jitterMs == 0) {
+    return emit(c, SCRIPT_OP_WAIT, 1) && emit(c, (unsigned)ms, 4);
+  }
+  return emit(c, SCRIPT_OP_WAIT_JITTER, 1) && emit(c, (unsigned)ms, 4) &&
+         emit(c, (unsigned)jitterMs, 4);
+}
+
+static bool compileStatement(struct ScriptCompiler *c, const char *lineEnd) {
+  const char *word;
+  size_t len;
+  if (!nextWord(c, lineEnd, &word, &len)) {
+    return true;
+  }
+  long long value;
+  bool ok;
+  if (lexWordIs(word, len, "move")) {
+    ok = compileMove(c, lineEnd, SCRIPT_OP_MOVE);
+  } else if (lexWordIs(word, len, "glide")) {
+    ok = compileMove(c, lineEnd, SCRIPT_OP_GLIDE);
+  } else if (lexWordIs(word, len, "scroll")) {
+    ok = parseInteger(c, lineEnd, -SCRIPT_MAX_DISTANCE, SCRIPT_MAX_DISTANCE,
+                      &value) &&
+         emit(c, SCRIPT_OP_SCROLL, 1) && emit(c, (unsigned)value, 2);
+  } else if (lexWordIs(word, len, "home")) {
+    ok = emit(c, SCRIPT_OP_HOME, 1);
+  } else if (lexWordIs(word, len, "wait")) {
+    ok = compileWait(c, lineEnd);
+  } else if (lexWordIs(word, len, "repeat")) {
+    if (c->depth == SCRIPT_MAX_DEPTH) {
+      return fail(c, "too many nested loops");
+    }
+    c->loopLines[c->depth++] = c->line;
+    ok = parseInteger(c, lineEnd, 1, SCRIPT_MAX_REPEAT, &value) &&
+         emit(c, SCRIPT_OP_REPEAT, 1) && emit(c, (unsigned)value, 2);
+  } else if (lexWordIs(word, len, "end")) {
+    if (c->depth == 0) {
+      return fail(c, "\"end\" without \"repeat\"");
+    }
+    --c->depth;
+    ok = emit(c, SCRIPT_OP_END, 1);
+  } else {
+    return fail(c, "unknown statement");
+  }
+  if (!ok) {
+    return false;
+  }
+  ++c->out->statements;
+  if (nextWord(c, lineEnd, &word, &len)) {
+    return fail(c, "too many arguments");
+  }
+  return true;
+}
+
+bool scriptCompile(const char *text, size_t len, struct ScriptProgram *out,
+                   struct ScriptError *err) {
+  struct ScriptCompiler c;
+  memset(&c, 0, sizeof(c));
+  c.out = out;
+  c.err = err;
+  c.pos = text;
+  c.end = text + len;
+  out->len = 0;
+  out->statements = 0;
+  if (len >= 3 && memcmp(text, "\xef\xbb\xbf", 3) == 0) {
+    c.pos += 3;
+  }
+  while (c.pos < c.end) {
+    ++c.line;
+    /* the line ends at the newline, and its meaningful part at the comment,
+     * if there's one. */
+    const char *lineEnd = c.pos;
+    while (lineEnd < c.end && *lineEnd != '\n' && *lineEnd != '#') {
+      ++lineEnd;
+    }
+    if (!compileStatement(&c, lineEnd)) {
+      return false;
+    }
+    c.pos = lineEnd;
+    while (c.pos < c.end && *c.pos++ != '\n') {
+    }
+  }
+  if (c.depth) {
+    c.line = c.loopLines[c.depth - 1];
+    return fail(&c, "\"repeat\" without \"end\"");
+  }
+  if (out->statements == 0) {
+    c.line = 0;
+    return fail(&c, "the script is empty");
+  }
+  return emit(&c, SCRIPT_OP_HALT, 1);
+}
+
+void scriptInit(struct ScriptVm *vm, const struct ScriptProgram *program,
+                const struct MotionBackend *backend, uint32_t seed) {
+  memset(vm, 0, sizeof(*vm));
+  vm->program = program;
+  vm->backend = backend;
+  vm->rng = seed ? seed : 1;
+}
+
+static int read16(const unsigned char *code) {
+  return (int16_t)(code[0] | code[1] << 8);
+}
+
+static uint32_t read32(const unsigned char *code) {
+  return code[0] | code[1] << 8 | code[2] << 16 | (uint32_t)code[3] << 24;
+}
+
+static uint32_t xorshift32(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static void flush(struct ScriptVm *vm) {
+  if (vm->pendingCount) {
+    vm->backend->sendPath(vm->backend->ctx, vm->pending, vm->pendingCount);
+    vm->pendingCount = 0;
+  }
+}
+
+static void move(struct ScriptVm *vm, int dx, int dy) {
+  if (vm->pendingCount == MOTION_MAX_PATH_STEPS) {
+    flush(vm);
+  }
+  vm->pending[vm->pendingCount].dx = dx;
+  vm->pending[vm->pendingCount].dy = dy;
+  ++vm->pendingCount;
+  vm->offsetX += dx;
+  vm->offsetY += dy;
+}
+
+static void glide(struct ScriptVm *vm, int dx, int dy) {
+  if (MOTION_MAX_PATH_STEPS - vm->pendingCount < SCRIPT_GLIDE_STEPS) {
+    flush(vm);
+  }
+  vm->pendingCount += motionInterpolate(
+      dx, dy, vm->pending + vm->pendingCount, SCRIPT_GLIDE_STEPS);
+  vm->offsetX += dx;
+  vm->offsetY += dy;
+}
+
+long scriptTick(struct ScriptVm *vm) {
+  /* the operands were all checked by the compiler, so they're just read
+   * here. */
+  const unsigned char *code = vm->program->code;
+  size_t pc = vm->pc;
+  /* whether the script has been gone through from the start during this
+   * tick. */
+  bool fromStart = pc == 0;
+  long waitMs = -1;
+  int ran = 0;
+  while (ran < SCRIPT_MAX_STATEMENTS_PER_TICK) {
+    const enum ScriptOp op = (enum ScriptOp)code[pc];
+    if (op == SCRIPT_OP_HALT) {
+      /* the script starts over. a tick which started after a wait goes on
+       * from the start, up to the first wait : the end of the script isn't
+       * worth a tick of its own. a script without any wait in it runs once
+       * per tick. */
+      pc = 0;
+      vm->depth = 0;
+      if (fromStart) {
+        break;
+      }
+      fromStart = true;
+      continue;
+    }
+    ++ran;
+    switch (op) {
+    case SCRIPT_OP_MOVE:
+      move(vm, read16(code + pc + 1), read16(code + pc + 3));
+      pc += 5;
+      break;
+    case SCRIPT_OP_GLIDE:
+      glide(vm, read16(code + pc + 1), read16(code + pc + 3));
+      pc += 5;
+      break;
+    case SCRIPT_OP_SCROLL:
+      flush(vm);
+      if (vm->backend->sendWheel) {
+        vm->backend->sendWheel(vm->backend->ctx, read16(code + pc + 1));
+      }
+      pc += 3;
+      break;
+    case SCRIPT_OP_HOME:
+      glide(vm, -vm->offsetX, -vm->offsetY);
+      pc += 1;
+      break;
+    case SCRIPT_OP_WAIT:
+      waitMs = (long)read32(code + pc + 1);
+      pc += 5;
+      break;
+    case SCRIPT_OP_WAIT_JITTER: {
+      const long ms = (long)read32(code + pc + 1);
+      const uint32_t jitter = read32(code + pc + 5);
+      waitMs = ms + (long)(xorshift32(&vm->rng) % (2 * jitter + 1)) -
+               (long)jitter;
+      /* the compiler makes sure that the jitter is shorter than the wait,
+       * but the wait can still come out shorter than the floor. */
+      if (waitMs < SCHEDULER_MIN_INTERVAL_MS) {
+        waitMs = SCHEDULER_MIN_INTERVAL_MS;
+      }
+      pc += 9;
+      break;
+    }
+    case SCRIPT_OP_REPEAT:
+      vm->loops[vm->depth].start = pc + 3;
+      vm->loops[vm->depth].remaining = read16(code + pc + 1) & 0xffff;
+      ++vm->depth;
+      pc += 3;
+      break;
+    case SCRIPT_OP_END:
+      if (--vm->loops[vm->depth - 1].remaining > 0) {
+        pc = vm->loops[vm->depth - 1].start;
+      } else {
+        --vm->depth;
+        pc += 1;
+      }
+      break;
+    case SCRIPT_OP_HALT:
+      break;
+    }
+    if (waitMs >= 0) {
+      break;
+    }
+  }
+  vm->pc = pc;
+  vm->statements += ran;
+  flush(vm);
+  return waitMs;
+}
@@ -0,0 +1,129 @@
+#ifndef LAFLOR_SCRIPT_H
+#define LAFLOR_SCRIPT_H
+
+#include "motion.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* a motion script is a little program describing what La Flor should do with
+ * the cursor, instead of bouncing it around. there's one statement per line :
+ *
+ *   move DX DY       moves the cursor by (DX, DY) pixels, at once
+ *   glide DX DY      the same, along a smooth path
+ *   scroll N         turns the wheel by N notches, away from the user if N is
+ *                    positive
+ *   home             glides the cursor back to where the script started
+ *   wait T [J]       waits T, give or take up to J, at random
+ *   repeat N         runs the statements up to the matching "end" N times
+ *   end
+ *
+ * durations are in milliseconds, unless followed by "s" or "min", e.g.
+ * "wait 40s 5s". a wait needs to be at least SCHEDULER_MIN_INTERVAL_MS, and
+ * its jitter shorter than the wait itself. anything from a # to the end of a
+ * line is a comment. the script starts over once it's done, so e.g.
+ *
+ *   move 3 0
+ *   wait 40s
+ *   scroll 1
+ *   home
+ *   wait 1min 10s
+ *
+ * nudges the cursor, scrolls and goes back every 40 to 110 seconds, forever.
+ *
+ * scripts are compiled once, into the compact bytecode below, and every tick
+ * then runs the statements up to the next wait : that wait decides when the
+ * next tick is due, in place of the interval. the moves made during a tick
+ * are collected and sent all at once, as a single path. */
+
+/* the largest script file that is accepted, in bytes of source. */
+#define SCRIPT_MAX_SOURCE 65536
+/* the largest script that can be compiled, in bytes of bytecode. a move takes
+ * 5 bytes, and a wait at most 9. */
+#define SCRIPT_MAX_CODE 2048
+/* how deeply "repeat" may be nested. */
+#define SCRIPT_MAX_DEPTH 8
+/* the most statements that a single tick runs : a tick which gets there ends
+ * as if the script had reached its end. this keeps a loop without any wait in
+ * it from turning into a burst of input. */
+#define SCRIPT_MAX_STATEMENTS_PER_TICK 256
+/* the largest distance, wheel turn, repeat count and duration (in ms) that a
+ * statement accepts. */
+#define SCRIPT_MAX_DISTANCE 32767
+#define SCRIPT_MAX_REPEAT 65535
+#define SCRIPT_MAX_MS 86400000
+
+enum ScriptOp {
+  /* the end of the script. */
+  SCRIPT_OP_HALT,
+  /* followed by two 16-bit distances. */
+  SCRIPT_OP_MOVE,
+  SCRIPT_OP_GLIDE,
+  /* followed by a 16-bit number of notches. */
+  SCRIPT_OP_SCROLL,
+  SCRIPT_OP_HOME,
+  /* followed by a 32-bit duration, and by a 32-bit jitter for WAIT_JITTER. */
+  SCRIPT_OP_WAIT,
+  SCRIPT_OP_WAIT_JITTER,
+  /* followed by a 16-bit count. the loop starts right after it. */
+  SCRIPT_OP_REPEAT,
+  /* the end of the innermost loop, which knows where the loop starts. */
+  SCRIPT_OP_END
+};
+
+/* a compiled script : a sequence of instructions, each of which is an opcode
+ * byte followed by its operands, little endian. */
+struct ScriptProgram {
+  unsigned char code[SCRIPT_MAX_CODE];
+  size_t len;
+  /* the number of statements, for statistics. */
+  int statements;
+};
+
+/* where compiling a script went wrong. "line" starts at 1. */
+struct ScriptError {
+  int line;
+  const char *message;
+};
+
+/* compiles a script, which doesn't need to be null-terminated. returns false,
+ * with "err" filled in, if the script doesn't make sense. */
+bool scriptCompile(const char *text, size_t len, struct ScriptProgram *out,
+                   struct ScriptError *err);
+
+/* the state of a script being run. nothing is ever allocated : the loop
+ * counters and the moves of the current tick are all kept in here. */
+struct ScriptVm {
+  const struct ScriptProgram *program;
+  const struct MotionBackend *backend;
+  size_t pc;
+  int depth;
+  struct {
+    size_t start;
+    int remaining;
+  } loops[SCRIPT_MAX_DEPTH];
+  uint32_t rng;
+  /* how far the cursor was moved since the script started. */
+  int offsetX;
+  int offsetY;
+  /* the moves of the current tick which haven't been sent yet. */
+  int pendingCount;
+  struct MotionStep pending[MOTION_MAX_PATH_STEPS];
+  /* the number of statements run so far. */
+  unsigned long long statements;
+};
+
+/* the program is not copied, and must stay valid for as long as the script
+ * runs. */
+void scriptInit(struct ScriptVm *vm, const struct ScriptProgram *program,
+                const struct MotionBackend *backend, uint32_t seed);
+
+/* runs a single tick : every statement up to the next wait, or up to the end
+ * of the script. returns how long the next tick should wait for, in
+ * milliseconds, or -1 if the script reached its end or
+ * SCRIPT_MAX_STATEMENTS_PER_TICK without waiting, in which case the next tick
+ * should come after the usual interval. */
+long scriptTick(struct ScriptVm *vm);
+
+#endif
@@ -0,0 +1,139 @@
+#include "telemetry.h"
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* the head is published with release semantics once a record is complete, and
+ * read with acquire semantics : a reader which sees the new head is thus
+ * guaranteed to see the whole record as well. with GCC and Clang, this is
+ * what the __atomic builtins are for. MSVC gives volatile accesses acquire
+ * and release semantics on x86 and x64 (/volatile:ms, the default there), so
+ * all that's left to do is keeping the compiler from reordering things. */
+static uint32_t loadAcquire(const volatile uint32_t *ptr) {
+#ifdef __GNUC__
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#else
+  return *ptr;
+#endif
+}
+
+static void storeRelease(volatile uint32_t *ptr, uint32_t val) {
+#ifdef __GNUC__
+  __atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+#else
+  *ptr = val;
+#endif
+}
+
+/* keeps the loads before the fence from being moved past the loads after it. */
+static void fenceAcquire(void) {
+#ifdef __GNUC__
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#else
+  _ReadWriteBarrier();
+#endif
+}
+
+size_t telemetrySize(uint32_t capacity) {
+  return sizeof(struct TelemetryHeader) +
+         (size_t)capacity * sizeof(struct TelemetryRecord);
+}
+
+static bool validCapacity(uint32_t capacity) {
+  return capacity != 0 && (capacity & (capacity - 1)) == 0;
+}
+
+static void setupRing(struct TelemetryRing *ring, void *mem) {
+  ring->header = mem;
+  ring->records = (struct TelemetryRecord *)(ring->header + 1);
+  ring->mask = ring->header->capacity - 1;
+  ring->head = loadAcquire(&ring->header->head);
+}
+
+bool telemetryInit(struct TelemetryRing *ring, void *mem, size_t size,
+                   uint32_t capacity) {
+  if (!validCapacity(capacity) || size < telemetrySize(capacity)) {
+    return false;
+  }
+  struct TelemetryHeader *header = mem;
+  memset(header, 0, sizeof(*header));
+  header->magic = TELEMETRY_MAGIC;
+  header->version = TELEMETRY_VERSION;
+  header->capacity = capacity;
+  header->recordSize = sizeof(struct TelemetryRecord);
+  setupRing(ring, mem);
+  return true;
+}
+
+bool telemetryAttach(struct TelemetryRing *ring, void *mem, size_t size) {
+  const struct TelemetryHeader *header = mem;
+  if (size < sizeof(*header) || header->magic != TELEMETRY_MAGIC ||
+      header->version != TELEMETRY_VERSION ||
+      header->recordSize != sizeof(struct TelemetryRecord) ||
+      !validCapacity(header->capacity) ||
+      size < telemetrySize(header->capacity)) {
+    return false;
+  }
+  setupRing(ring, mem);
+  return true;
+}
+
+struct TelemetryRecord *telemetryNext(const struct TelemetryRing *ring) {
+  return &ring->records[ring->head & ring->mask];
+}
+
+void telemetryCommit(struct TelemetryRing *ring) {
+  storeRelease(&ring->header->head, ++ring->head);
+}
+
+uint32_t telemetryOldest(const struct TelemetryRing *ring) {
+  /* the very oldest record is left out, as it's the one that the producer
+   * overwrites with the next record, possibly right now. right after the head
+   * wraps around, which takes over a century at one tick per second, this
+   * skips a few more records that are actually still there. */
+  const uint32_t head = loadAcquire(&ring->header->head);
+  const uint32_t capacity = ring->mask + 1;
+  return head < capacity ? 0 : head - capacity + 1;
+}
+
+uint32_t telemetryRead(const struct TelemetryRing *ring, uint32_t *cursor,
+                       struct TelemetryRecord *out, uint32_t maxCount,
+                       unsigned long long *lost) {
+  /* all the index arithmetic is done on unsigned 32-bit values, so that the
+   * head wrapping around doesn't matter. */
+  const uint32_t capacity = ring->mask + 1;
+  const uint32_t head = loadAcquire(&ring->header->head);
+  uint32_t from = *cursor;
+  uint32_t available = head - from;
+  if (available >= capacity) {
+    /* see telemetryOldest() about the oldest record being left out. */
+    *lost += available - (capacity - 1);
+    from = head - (capacity - 1);
+    available = capacity - 1;
+  }
+  const uint32_t count = available < maxCount ? available : maxCount;
+  for (uint32_t i = 0; i < count; ++i) {
+    out[i] = ring->records[(from + i) & ring->mask];
+  }
+
+  /* the producer might have lapped us while we were copying. once the head is
+   * at "newHead", the producer may already be writing the record with that
+   * index, which overwrites the one at newHead - capacity : any record at or
+   * before that one can't be trusted. */
+  fenceAcquire();
+  const uint32_t newHead = loadAcquire(&ring->header->head);
+  uint32_t torn = 0;
+  if (newHead - from >= capacity) {
+    torn = newHead - from - capacity + 1;
+    if (torn > count) {
+      torn = count;
+    }
+    memmove(out, out + torn, (count - torn) * sizeof(*out));
+    *lost += torn;
+  }
+  *cursor = from + count;
+  return count - torn;
+}
@@ -0,0 +1,107 @@
+#ifndef LAFLOR_TELEMETRY_H
+#define LAFLOR_TELEMETRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* the base name of the shared memory that the application exports its
+ * telemetry through. each platform decorates it in its own way : on Windows,
+ * it's a named file mapping in the session's "Local\" namespace. */
+#define TELEMETRY_NAME "LaFlorTelemetry"
+
+#define TELEMETRY_MAGIC 0x4d54464c /* "LFTM" */
+#define TELEMETRY_VERSION 1
+
+/* the number of records kept in the ring, which must be a power of two. at
+ * one tick per second, this is over an hour's worth of ticks. */
+#define TELEMETRY_DEFAULT_CAPACITY 4096
+
+/* the record's "flags". */
+#define TELEMETRY_POSTPONED 0x1      /* skipped because the user was active */
+#define TELEMETRY_CURSOR_QUERIED 0x2 /* asked the system where the cursor is */
+
+/* what happened during a single tick. the layout of this struct is part of the
+ * format of the shared memory, so it's made of fixed-size types only, with no
+ * implicit padding anywhere. */
+struct TelemetryRecord {
+  /* the deadline of the tick and the time at which it actually ran, in
+   * microseconds of the producer's monotonic clock. */
+  int64_t scheduledUs;
+  int64_t actualUs;
+  /* how long the tick path took, from waking up to being done injecting. */
+  uint32_t pathNs;
+  /* the number of input events handed to the system, and the number of those
+   * that it reported as actually inserted. both are 0 if nothing was
+   * injected. */
+  uint16_t requested;
+  uint16_t sent;
+  /* where the motion engine last saw or placed the cursor. */
+  int32_t x;
+  int32_t y;
+  uint32_t flags;
+  uint32_t reserved;
+};
+
+/* the header at the very start of the shared memory, followed directly by
+ * "capacity" records. "head" is the total number of records ever written,
+ * wrapping around at 2^32, and is the only part of the header that changes
+ * after initialization. */
+struct TelemetryHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t recordSize;
+  volatile uint32_t head;
+  uint32_t reserved[3];
+};
+
+/* a lock-free ring buffer with a single producer and any number of readers,
+ * living in memory provided by the caller, e.g. a mapping shared with other
+ * processes. the producer never waits for anybody : once the ring is full, the
+ * oldest records are simply overwritten, and it's up to the readers to keep
+ * up. a record is only ever published, by advancing the head, once it has been
+ * completely written.
+ *
+ * "head" here is the producer's private copy of the shared head, which saves
+ * reading it back from the shared memory on every record. */
+struct TelemetryRing {
+  struct TelemetryHeader *header;
+  struct TelemetryRecord *records;
+  uint32_t mask;
+  uint32_t head;
+};
+
+/* the number of bytes needed for a ring with the given capacity. */
+size_t telemetrySize(uint32_t capacity);
+
+/* formats "size" bytes of memory at "mem" as an empty ring, for the producer.
+ * returns false if the capacity isn't a power of two or doesn't fit. */
+bool telemetryInit(struct TelemetryRing *ring, void *mem, size_t size,
+                   uint32_t capacity);
+
+/* attaches to a ring which was formatted by telemetryInit(), for a reader.
+ * returns false if the memory doesn't contain a valid ring. */
+bool telemetryAttach(struct TelemetryRing *ring, void *mem, size_t size);
+
+/* returns the slot for the next record, which only becomes visible to readers
+ * with telemetryCommit(). */
+struct TelemetryRecord *telemetryNext(const struct TelemetryRing *ring);
+
+/* publishes the record returned by telemetryNext(). */
+void telemetryCommit(struct TelemetryRing *ring);
+
+/* returns the index of the oldest record which can still be read from the
+ * ring. this is where a reader that wants to see everything should start. */
+uint32_t telemetryOldest(const struct TelemetryRing *ring);
+
+/* copies up to "maxCount" records starting at index "*cursor" to "out", and
+ * advances the cursor past them. records which were overwritten before the
+ * reader got to them, including the ones overwritten while they were being
+ * copied, are not returned : their number is added to "*lost" instead. returns
+ * the number of records copied. */
+uint32_t telemetryRead(const struct TelemetryRing *ring, uint32_t *cursor,
+                       struct TelemetryRecord *out, uint32_t maxCount,
+                       unsigned long long *lost);
+
+#endif
@@ -0,0 +1,279 @@
+#include "timerwheel.h"
+
+#include <string.h>
+
+#define LEVEL_FAR WHEEL_LEVELS
+#define LEVEL_DUE (WHEEL_LEVELS + 1)
+#define SLOT_MASK (WHEEL_SLOTS - 1)
+
+/* the index of the lowest bit set in "bits", which mustn't be 0. this uses a
+ * de Bruijn sequence rather than a compiler intrinsic, which works the same
+ * with every compiler. */
+static int lowestBit(uint64_t bits) {
+  static const unsigned char table[64] = {
+      0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38, 29, 17, 4,
+      62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+      63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+      46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6};
+  return table[((bits & (~bits + 1)) * 0x03f79d71b4cb0a89ULL) >> 58];
+}
+
+/* how many slots away from "from" the first occupied slot is, going
+ * forward, or -1 if there are none. */
+static int distanceToOccupied(uint64_t occupied, int from) {
+  if (occupied == 0) {
+    return -1;
+  }
+  const uint64_t rotated =
+      from ? (occupied >> from) | (occupied << (WHEEL_SLOTS - from))
+           : occupied;
+  return lowestBit(rotated);
+}
+
+static struct WheelTimer **listOf(struct TimerWheel *wheel,
+                                  const struct WheelTimer *timer) {
+  if (timer->level == LEVEL_FAR) {
+    return &wheel->far;
+  }
+  if (timer->level == LEVEL_DUE) {
+    return &wheel->due;
+  }
+  return &wheel->slots[timer->level][timer->slot];
+}
+
+static void linkTimer(struct TimerWheel *wheel, struct WheelTimer *timer,
+                      int level, int slot) {
+  timer->level = level;
+  timer->slot = slot;
+  struct WheelTimer **head = listOf(wheel, timer);
+  timer->prev = 0;
+  timer->next = *head;
+  if (*head) {
+    (*head)->prev = timer;
+  }
+  *head = timer;
+  if (level < WHEEL_LEVELS) {
+    wheel->occupied[level] |= (uint64_t)1 << slot;
+  }
+}
+
+static void unlinkTimer(struct TimerWheel *wheel, struct WheelTimer *timer) {
+  struct WheelTimer **head = listOf(wheel, timer);
+  if (timer->prev) {
+    timer->prev->next = timer->next;
+  } else {
+    *head = timer->next;
+  }
+  if (timer->next) {
+    timer->next->prev = timer->prev;
+  }
+  if (*head == 0 && timer->level < WHEEL_LEVELS) {
+    wheel->occupied[timer->level] &= ~((uint64_t)1 << timer->slot);
+  }
+  timer->level = -1;
+}
+
+/* puts the timer into the lowest level whose slots still tell its deadline
+ * apart from the current time. on any level but the lowest one, that's never
+ * the current slot. */
+static void placeTimer(struct TimerWheel *wheel, struct WheelTimer *timer) {
+  long long slice = timer->deadlineUs / wheel->resolutionUs;
+  if (slice < wheel->now) {
+    slice = wheel->now;
+  }
+  for (int level = 0; level < WHEEL_LEVELS; ++level) {
+    const int shift = level * WHEEL_SLOT_BITS;
+    if ((slice >> shift) - (wheel->now >> shift) < WHEEL_SLOTS) {
+      linkTimer(wheel, timer, level, (int)((slice >> shift) & SLOT_MASK));
+      return;
+    }
+  }
+  linkTimer(wheel, timer, LEVEL_FAR, 0);
+}
+
+/* detaches a whole list, and places each of its timers again. */
+static void replaceList(struct TimerWheel *wheel, struct WheelTimer **head) {
+  struct WheelTimer *timer = *head;
+  *head = 0;
+  while (timer) {
+    struct WheelTimer *next = timer->next;
+    placeTimer(wheel, timer);
+    timer = next;
+  }
+}
+
+static long long earliestOf(const struct WheelTimer *timer, long long best) {
+  for (; timer; timer = timer->next) {
+    if (best < 0 || timer->deadlineUs < best) {
+      best = timer->deadlineUs;
+    }
+  }
+  return best;
+}
+
+void wheelInit(struct TimerWheel *wheel, long long nowUs,
+               long long resolutionUs) {
+  memset(wheel, 0, sizeof(*wheel));
+  wheel->resolutionUs = resolutionUs > 0 ? resolutionUs : 1;
+  wheel->now = nowUs / wheel->resolutionUs;
+  wheel->nextDeadlineUs = -1;
+  wheel->nextValid = true;
+}
+
+void wheelTimerInit(struct WheelTimer *timer, WheelTimerFn fire, void *ctx) {
+  memset(timer, 0, sizeof(*timer));
+  timer->fire = fire;
+  timer->ctx = ctx;
+  timer->level = -1;
+}
+
+bool wheelTimerPending(const struct WheelTimer *timer) {
+  return timer->level >= 0;
+}
+
+void wheelCancel(struct TimerWheel *wheel, struct WheelTimer *timer) {
+  if (!wheelTimerPending(timer)) {
+    return;
+  }
+  unlinkTimer(wheel, timer);
+  --wheel->count;
+  if (timer->deadlineUs == wheel->nextDeadlineUs) {
+    wheel->nextValid = false;
+  }
+}
+
+void wheelSchedule(struct TimerWheel *wheel, struct WheelTimer *timer,
+                   long long deadlineUs) {
+  wheelCancel(wheel, timer);
+  timer->deadlineUs = deadlineUs;
+  placeTimer(wheel, timer);
+  ++wheel->count;
+  if (wheel->nextValid &&
+      (wheel->nextDeadlineUs < 0 || deadlineUs < wheel->nextDeadlineUs)) {
+    wheel->nextDeadlineUs = deadlineUs;
+  }
+}
+
+long long wheelNextDeadlineUs(struct TimerWheel *wheel) {
+  if (wheel->nextValid) {
+    return wheel->nextDeadlineUs;
+  }
+  /* the timers of a level are all in different slots than those of the
+   * timers due later, so only the first occupied slot of each level needs to
+   * be looked at. the levels do overlap, though, so each of them is looked
+   * at, unless its first slot only starts after the earliest deadline found
+   * so far : the slots of the upper levels can hold a lot of timers. */
+  long long next = earliestOf(wheel->due, earliestOf(wheel->far, -1));
+  for (int level = 0; level < WHEEL_LEVELS; ++level) {
+    const int shift = level * WHEEL_SLOT_BITS;
+    const long long current = wheel->now >> shift;
+    const int distance = distanceToOccupied(wheel->occupied[level],
+                                            (int)(current & SLOT_MASK));
+    if (distance < 0) {
+      continue;
+    }
+    const long long startUs =
+        ((current + distance) << shift) * wheel->resolutionUs;
+    if (next < 0 || startUs <= next) {
+      next = earliestOf(
+          wheel->slots[level][(current + distance) & SLOT_MASK], next);
+    }
+  }
+  wheel->nextDeadlineUs = next;
+  wheel->nextValid = true;
+  return next;
+}
+
+/* moves the timers of the current slot of the lowest level whose deadline has
+ * passed to the list of timers about to fire. */
+static void collectDue(struct TimerWheel *wheel, long long nowUs) {
+  const int slot = (int)(wheel->now & SLOT_MASK);
+  struct WheelTimer *timer = wheel->slots[0][slot];
+  while (timer) {
+    struct WheelTimer *next = timer->next;
+    if (timer->deadlineUs <= nowUs) {
+      unlinkTimer(wheel, timer);
+      linkTimer(wheel, timer, LEVEL_DUE, 0);
+    }
+    timer = next;
+  }
+}
+
+/* the next slice, after the current one and no later than "target", at which
+ * anything happens : a slot of the lowest level with timers in it, a slot of
+ * another level whose timers need to move down, or the far away timers
+ * needing to be looked at again. */
+static long long nextEvent(const struct TimerWheel *wheel, long long target) {
+  long long next = target;
+  for (int level = 0; level < WHEEL_LEVELS; ++level) {
+    const int shift = level * WHEEL_SLOT_BITS;
+    const long long current = wheel->now >> shift;
+    const int distance = distanceToOccupied(
+        wheel->occupied[level], (int)((current + 1) & SLOT_MASK));
+    if (distance >= 0) {
+      const long long slice = (current + 1 + distance) << shift;
+      next = slice < next ? slice : next;
+    }
+  }
+  if (wheel->far) {
+    const int shift = (WHEEL_LEVELS - 1) * WHEEL_SLOT_BITS;
+    const long long slice = ((wheel->now >> shift) + 1) << shift;
+    next = slice < next ? slice : next;
+  }
+  return next;
+}
+
+/* moves the wheel to the given slice, with nothing happening in between :
+ * the timers of the slots which the wheel reaches on the upper levels move
+ * down, starting from the top. */
+static void moveTo(struct TimerWheel *wheel, long long slice) {
+  const long long previous = wheel->now;
+  wheel->now = slice;
+  const int topShift = (WHEEL_LEVELS - 1) * WHEEL_SLOT_BITS;
+  if (wheel->far && (slice >> topShift) != (previous >> topShift)) {
+    replaceList(wheel, &wheel->far);
+  }
+  for (int level = WHEEL_LEVELS - 1; level > 0; --level) {
+    const int shift = level * WHEEL_SLOT_BITS;
+    if ((slice >> shift) == (previous >> shift)) {
+      continue;
+    }
+    const int slot = (int)((slice >> shift) & SLOT_MASK);
+    if (wheel->occupied[level] & ((uint64_t)1 << slot)) {
+      wheel->occupied[level] &= ~((uint64_t)1 << slot);
+      replaceList(wheel, &wheel->slots[level][slot]);
+    }
+  }
+}
+
+int wheelAdvance(struct TimerWheel *wheel, long long nowUs) {
+  /* the wheel jumps straight from one slice where something happens to the
+   * next, so that a long sleep doesn't mean going through every slice in
+   * between. every timer due is collected before any of them fires, which
+   * lets the callbacks schedule timers relative to the final position of the
+   * wheel. */
+  long long target = nowUs / wheel->resolutionUs;
+  if (target < wheel->now) {
+    target = wheel->now;
+  }
+  for (;;) {
+    collectDue(wheel, nowUs);
+    if (wheel->now >= target) {
+      break;
+    }
+    moveTo(wheel, nextEvent(wheel, target));
+  }
+  if (wheel->due) {
+    wheel->nextValid = false;
+  }
+
+  int fired = 0;
+  while (wheel->due) {
+    struct WheelTimer *timer = wheel->due;
+    unlinkTimer(wheel, timer);
+    --wheel->count;
+    ++fired;
+    timer->fire(timer->ctx, timer);
+  }
+  return fired;
+}
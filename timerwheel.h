@@ -0,0 +1,97 @@
+#ifndef LAFLOR_TIMERWHEEL_H
+#define LAFLOR_TIMERWHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* a hierarchical timer wheel, which keeps track of any number of timers so
+ * that a single thread, woken up by a single OS timer, can run any number of
+ * periodic actions : the OS timer is just armed for wheelNextDeadlineUs().
+ *
+ * time is cut into slices of "resolutionUs". each level of the wheel has
+ * WHEEL_SLOTS slots, each of which spans WHEEL_SLOTS times as many slices as
+ * one of the level below : a timer goes into the lowest level whose slots
+ * still tell its deadline apart from the current time, and moves down a level
+ * whenever the wheel reaches the slot it's in. scheduling and cancelling a
+ * timer are O(1), and so is every timer moving down a level, which happens at
+ * most WHEEL_LEVELS - 1 times.
+ *
+ * deadlines are kept exactly, in microseconds of any monotonic clock, and the
+ * resolution only decides which slot a timer is in : timers never fire late
+ * because of it. like struct TickScheduler, the wheel doesn't read any clocks
+ * on its own. */
+
+#define WHEEL_SLOT_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_SLOT_BITS)
+/* with a resolution of a millisecond, five levels cover over 12 days. timers
+ * due later than that wait in a separate list until they're within range. */
+#define WHEEL_LEVELS 5
+
+struct WheelTimer;
+
+/* called once the timer's deadline has passed, right after it was removed
+ * from the wheel : the callback can schedule it again, e.g. one period
+ * later. */
+typedef void (*WheelTimerFn)(void *ctx, struct WheelTimer *timer);
+
+struct WheelTimer {
+  /* the timers of a slot are kept in a doubly-linked list, which is what
+   * makes cancelling O(1). */
+  struct WheelTimer *next;
+  struct WheelTimer *prev;
+  long long deadlineUs;
+  WheelTimerFn fire;
+  void *ctx;
+  /* where the timer is : a level, WHEEL_LEVELS for the list of far away
+   * timers, WHEEL_LEVELS + 1 for the list of timers about to fire, or -1 if
+   * the timer isn't scheduled. */
+  int level;
+  int slot;
+};
+
+struct TimerWheel {
+  long long resolutionUs;
+  /* the current time, in slices. */
+  long long now;
+  /* which slots of each level have any timers in them, one bit per slot. */
+  uint64_t occupied[WHEEL_LEVELS];
+  struct WheelTimer *slots[WHEEL_LEVELS][WHEEL_SLOTS];
+  struct WheelTimer *far;
+  /* the timers which wheelAdvance() is about to fire. */
+  struct WheelTimer *due;
+  size_t count;
+  /* the earliest deadline, or -1 if there are no timers, which is only
+   * valid while "nextValid" is set : it's kept up to date when timers are
+   * scheduled, and computed again when it's asked for after the earliest
+   * timer was cancelled or fired. */
+  long long nextDeadlineUs;
+  bool nextValid;
+};
+
+void wheelInit(struct TimerWheel *wheel, long long nowUs,
+               long long resolutionUs);
+
+void wheelTimerInit(struct WheelTimer *timer, WheelTimerFn fire, void *ctx);
+
+bool wheelTimerPending(const struct WheelTimer *timer);
+
+/* schedules the timer to fire once "deadlineUs" has passed, replacing its
+ * previous deadline if it was already scheduled. a deadline in the past fires
+ * on the next wheelAdvance(). */
+void wheelSchedule(struct TimerWheel *wheel, struct WheelTimer *timer,
+                   long long deadlineUs);
+
+/* does nothing if the timer isn't scheduled. */
+void wheelCancel(struct TimerWheel *wheel, struct WheelTimer *timer);
+
+/* the earliest deadline of all the timers, or -1 if there are none. */
+long long wheelNextDeadlineUs(struct TimerWheel *wheel);
+
+/* moves the wheel forward to "nowUs" and fires every timer whose deadline has
+ * passed, in no particular order. the callbacks may schedule and cancel any
+ * timers, but the ones they schedule only fire on the next call, even if
+ * they're already due. returns the number of timers fired. */
+int wheelAdvance(struct TimerWheel *wheel, long long nowUs);
+
+#endif
@@ -0,0 +1,153 @@
+/* starts one or more builds of La Flor, one after the other, and reports how
+ * long each of them took to start up and how much memory it uses once it's
+ * settled : the private bytes (its commit charge, which is what every extra
+ * session costs), the working set, its peak during startup, and the number of
+ * modules loaded. typically used in order to compare the regular build with a
+ * LAFLOR_NO_CRT one :
+ *
+ *   LaFlorFootprint --runs 10 build\Release\LaFlor.exe nocrt\Release\LaFlor.exe
+ *
+ * startup is considered to be over once La Flor waits for its first message,
+ * which is what WaitForInputIdle() waits for. since La Flor only runs once per
+ * session, no other instance may be running in the meantime. every instance
+ * is asked to quit the regular way once it's been measured, which saves its
+ * settings to the registry as usual. */
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <psapi.h>
+
+#include "benchclock.h"
+#include "rootwindow.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Footprint {
+  double startupMs;
+  SIZE_T privateBytes;
+  SIZE_T workingSet;
+  SIZE_T peakWorkingSet;
+  DWORD modules;
+};
+
+static bool measure(const char *exe, DWORD settleMs, struct Footprint *out) {
+  char cmdLine[MAX_PATH + 2];
+  snprintf(cmdLine, sizeof(cmdLine), "\"%s\"", exe);
+  STARTUPINFOA startup;
+  memset(&startup, 0, sizeof(startup));
+  startup.cb = sizeof(startup);
+  PROCESS_INFORMATION pi;
+  const long long start = benchClockNs();
+  if (!CreateProcessA(exe, cmdLine, 0, 0, FALSE, 0, 0, 0, &startup, &pi)) {
+    fprintf(stderr, "couldn't start %s (error %lu)\n", exe, GetLastError());
+    return false;
+  }
+  const DWORD idleRv = WaitForInputIdle(pi.hProcess, 10000);
+  out->startupMs = (benchClockNs() - start) / 1e6;
+  bool rv = false;
+  if (idleRv != 0) {
+    fprintf(stderr, "%s didn't finish starting up\n", exe);
+  } else if (WaitForSingleObject(pi.hProcess, settleMs) == WAIT_OBJECT_0) {
+    /* most likely, another instance was already running, and this one just
+     * forwarded its (empty) command line to it. */
+    fprintf(stderr, "%s exited right away : is La Flor already running?\n",
+            exe);
+  } else {
+    PROCESS_MEMORY_COUNTERS_EX counters;
+    HMODULE modules[1];
+    DWORD modulesSize = 0;
+    if (GetProcessMemoryInfo(pi.hProcess,
+                             (PROCESS_MEMORY_COUNTERS *)&counters,
+                             sizeof(counters)) &&
+        EnumProcessModules(pi.hProcess, modules, sizeof(modules),
+                           &modulesSize)) {
+      out->privateBytes = counters.PrivateUsage;
+      out->workingSet = counters.WorkingSetSize;
+      out->peakWorkingSet = counters.PeakWorkingSetSize;
+      out->modules = modulesSize / sizeof(HMODULE);
+      rv = true;
+    } else {
+      fprintf(stderr, "couldn't query %s (error %lu)\n", exe, GetLastError());
+    }
+  }
+  quitLaFlor(&pi);
+  CloseHandle(pi.hThread);
+  CloseHandle(pi.hProcess);
+  return rv;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+  const double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--runs N] [--settle MS] EXE...\n"
+          "  --runs N     start each build N times (default 5)\n"
+          "  --settle MS  wait this long after startup before measuring the\n"
+          "               memory use (default 1000)\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  int runs = 5;
+  DWORD settleMs = 1000;
+  int first = 1;
+  for (; first < argc && strncmp(argv[first], "--", 2) == 0; first += 2) {
+    if (first + 1 >= argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    if (strcmp(argv[first], "--runs") == 0) {
+      runs = atoi(argv[first + 1]);
+    } else if (strcmp(argv[first], "--settle") == 0) {
+      settleMs = (DWORD)atoi(argv[first + 1]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (first == argc || runs <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (FindWindowW(CONTROL_WINDOW_CLASS, 0)) {
+    fprintf(stderr, "La Flor is already running in this session : quit it "
+                    "first\n");
+    return 1;
+  }
+
+  /* the startup time is the median over all runs, and the memory figures are
+   * the ones of the last run, as they hardly vary at all. */
+  double *startupMs = malloc(runs * sizeof(*startupMs));
+  if (startupMs == 0) {
+    return 1;
+  }
+  printf("%-40s %10s %10s %10s %10s %8s\n", "build", "startup ms",
+         "private KB", "ws KB", "peak ws KB", "modules");
+  int rv = 0;
+  for (int i = first; i < argc; ++i) {
+    struct Footprint fp;
+    int run = 0;
+    for (; run < runs && measure(argv[i], settleMs, &fp); ++run) {
+      startupMs[run] = fp.startupMs;
+    }
+    if (run < runs) {
+      rv = 1;
+      continue;
+    }
+    qsort(startupMs, runs, sizeof(*startupMs), compareDoubles);
+    printf("%-40s %10.1f %10lu %10lu %10lu %8lu\n", argv[i],
+           startupMs[runs / 2], (unsigned long)(fp.privateBytes / 1024),
+           (unsigned long)(fp.workingSet / 1024),
+           (unsigned long)(fp.peakWorkingSet / 1024),
+           (unsigned long)fp.modules);
+  }
+  free(startupMs);
+  return rv;
+}
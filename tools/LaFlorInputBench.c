@@ -0,0 +1,75 @@
+/* measures the cost of injecting mouse input through SendInput(), comparing
+ * one call per input record (what La Flor does on every tick in the default
+ * mode) against a single call with a whole batch of records (what smooth mode
+ * does). the moves alternate between one pixel to the right and one to the
+ * left, so the cursor doesn't wander off while this runs, but it will visibly
+ * jitter : don't touch the mouse in the meantime. */
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include "benchclock.h"
+#include "motion.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int batchSizes[] = {1, 2, 4, 8, 16, 32, MOTION_MAX_PATH_STEPS};
+
+static void initInputs(INPUT *inputs, int count) {
+  memset(inputs, 0, count * sizeof(*inputs));
+  for (int i = 0; i < count; ++i) {
+    inputs[i].type = INPUT_MOUSE;
+    inputs[i].mi.dwFlags = MOUSEEVENTF_MOVE;
+    inputs[i].mi.dx = (i % 2) ? -1 : 1;
+  }
+}
+
+/* returns the number of nanoseconds per event. "failed" is set to the number
+ * of events that SendInput() reported as not inserted. */
+static double runPerEvent(INPUT *inputs, int events, long *failed) {
+  const long long start = benchClockNs();
+  for (int i = 0; i < events; ++i) {
+    *failed += 1 - (long)SendInput(1, &inputs[i % 2], sizeof(*inputs));
+  }
+  return (double)(benchClockNs() - start) / events;
+}
+
+static double runBatched(INPUT *inputs, int batch, int events, long *failed) {
+  const int calls = events / batch;
+  const long long start = benchClockNs();
+  for (int i = 0; i < calls; ++i) {
+    /* single-record batches still need to alternate directions. */
+    INPUT *first = (batch == 1) ? &inputs[i % 2] : inputs;
+    *failed += batch - (long)SendInput(batch, first, sizeof(*inputs));
+  }
+  return (double)(benchClockNs() - start) / (calls * batch);
+}
+
+int main(int argc, char **argv) {
+  const int events = argc > 1 ? atoi(argv[1]) : 65536;
+  if (events < MOTION_MAX_PATH_STEPS) {
+    fprintf(stderr, "usage: %s [EVENTS]\n(at least %d events)\n", argv[0],
+            MOTION_MAX_PATH_STEPS);
+    return 1;
+  }
+
+  INPUT inputs[MOTION_MAX_PATH_STEPS];
+  initInputs(inputs, MOTION_MAX_PATH_STEPS);
+
+  long failed = 0;
+  const double perEvent = runPerEvent(inputs, events, &failed);
+  printf("one SendInput() per event : %.1f ns/event, %ld failed\n\n", perEvent,
+         failed);
+
+  printf("%6s %16s %8s %8s\n", "batch", "batched ns/ev", "speedup", "failed");
+  for (size_t i = 0; i < sizeof(batchSizes) / sizeof(batchSizes[0]); ++i) {
+    const int batch = batchSizes[i];
+    failed = 0;
+    const double batched = runBatched(inputs, batch, events, &failed);
+    printf("%6d %16.1f %7.2fx %8ld\n", batch, batched,
+           batched > 0 ? perEvent / batched : 0.0, failed);
+  }
+  return 0;
+}
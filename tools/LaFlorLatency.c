@@ -0,0 +1,368 @@
+/* measures how long injected mouse input takes to get through the system, end
+ * to end : ticks are driven by a waitable timer just like La Flor's injection
+ * thread does it, each tick runs the motion engine, and the Win32 backend
+ * below timestamps every event right before handing it to SendInput(), which
+ * is the moveMouse() step of La Flor. a WH_MOUSE_LL hook, installed on the
+ * main thread, sees the events come out of the input stream : every event
+ * carries its sequence number in dwExtraInfo, so that the hook can match the
+ * injected events (LLMHF_INJECTED) with their timestamps, and ignore anything
+ * else, such as real mouse movement.
+ *
+ * for every combination of interval and delta, three latencies are reported :
+ * from the timer's deadline to the injection ("timer"), from the injection to
+ * the hook ("inject"), and the sum of both ("total"), followed by a histogram
+ * of the total latency. the cursor moves around while this runs.
+ *
+ * this only needs what Wine provides, so it also runs on Linux when
+ * cross-built with MinGW : see tools/latency-wine.sh. */
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include "benchclock.h"
+#include "layout.h"
+#include "motion.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef LLMHF_INJECTED
+#define LLMHF_INJECTED 0x00000001
+#endif
+
+/* the high bits of dwExtraInfo which tell our events apart from anybody
+ * else's. the low bits hold the sequence number, which indexes the ring of
+ * timestamps : the ring only needs to be larger than the number of events
+ * that can be in flight at once. */
+#define LATENCY_TAG 0x4c460000u
+#define LATENCY_TAG_MASK 0xffff0000u
+#define LATENCY_SEQ_MASK 0xffffu
+#define LATENCY_RING 4096
+
+/* how long to wait for the hook to see the last events of a run. */
+#define LATENCY_DRAIN_MS 500
+
+/* the histogram has one bucket per power of two microseconds, the last one
+ * collecting everything from about a second up. */
+#define LATENCY_BUCKETS 21
+
+static const int intervals[] = {10, 50, 250};
+static const int deltas[] = {1, 10, 60};
+
+/* everything shared between the ticking thread and the hook. the ticking
+ * thread writes the timestamps before injecting the events, and the hook
+ * appends the latencies it matches : since the hook only ever runs after
+ * SendInput() was called, it never sees a timestamp being written. */
+struct LatencyRun {
+  long long deadlineNs[LATENCY_RING];
+  long long injectNs[LATENCY_RING];
+  unsigned seq;
+  long long *timer;
+  long long *inject;
+  int maxSamples;
+  volatile LONG samples;
+  volatile LONG foreign;
+};
+
+/* a low-level hook procedure doesn't get any context, so this is the one
+ * thing that has to be found through a static variable. it's set before the
+ * hook is installed, and never changes afterwards. */
+static struct LatencyRun *hookRun;
+
+struct LatencyInjector {
+  struct LatencyRun *run;
+  long long deadlineNs;
+  INPUT inputs[MOTION_MAX_PATH_STEPS];
+};
+
+static LRESULT CALLBACK mouseHook(int code, WPARAM wparam, LPARAM lparam) {
+  /* this runs on the main thread, while it waits for messages. */
+  const long long now = benchClockNs();
+  const MSLLHOOKSTRUCT *info = (const MSLLHOOKSTRUCT *)lparam;
+  struct LatencyRun *run = hookRun;
+  if (code == HC_ACTION && wparam == WM_MOUSEMOVE) {
+    const unsigned extra = (unsigned)info->dwExtraInfo;
+    if ((info->flags & LLMHF_INJECTED) &&
+        (extra & LATENCY_TAG_MASK) == LATENCY_TAG) {
+      const unsigned slot = (extra & LATENCY_SEQ_MASK) % LATENCY_RING;
+      const LONG i = run->samples;
+      if (i < run->maxSamples) {
+        run->timer[i] = run->injectNs[slot] - run->deadlineNs[slot];
+        run->inject[i] = now - run->injectNs[slot];
+        InterlockedIncrement(&run->samples);
+      }
+    } else {
+      InterlockedIncrement(&run->foreign);
+    }
+  }
+  return CallNextHookEx(0, code, wparam, lparam);
+}
+
+static void stamp(struct LatencyInjector *injector, INPUT *inp) {
+  struct LatencyRun *run = injector->run;
+  const unsigned slot = run->seq % LATENCY_RING;
+  run->deadlineNs[slot] = injector->deadlineNs;
+  run->injectNs[slot] = benchClockNs();
+  inp->mi.dwExtraInfo = LATENCY_TAG | (run->seq & LATENCY_SEQ_MASK);
+  ++run->seq;
+}
+
+static void latencyGetCursorPos(void *ctx, int *x, int *y) {
+  POINT pt;
+  if (GetCursorPos(&pt)) {
+    *x = pt.x;
+    *y = pt.y;
+  }
+}
+
+static void latencySendMove(void *ctx, int dx, int dy) {
+  struct LatencyInjector *injector = ctx;
+  injector->inputs[0].mi.dx = dx;
+  injector->inputs[0].mi.dy = dy;
+  stamp(injector, &injector->inputs[0]);
+  SendInput(1, injector->inputs, sizeof(INPUT));
+}
+
+static void latencySendPath(void *ctx, const struct MotionStep *steps,
+                            int count) {
+  /* all the events of a path are stamped with the same time, right before
+   * the single SendInput() call, just like La Flor sends them. */
+  struct LatencyInjector *injector = ctx;
+  for (int i = 0; i < count; ++i) {
+    injector->inputs[i].mi.dx = steps[i].dx;
+    injector->inputs[i].mi.dy = steps[i].dy;
+    stamp(injector, &injector->inputs[i]);
+  }
+  SendInput(count, injector->inputs, sizeof(INPUT));
+}
+
+struct LatencyOptions {
+  int ticks;
+  bool smooth;
+  /* the largest acceptable p99 of the total latency, or 0 for no limit. */
+  long long maxP99Us;
+};
+
+struct LatencyThread {
+  const struct LatencyOptions *opts;
+  struct LatencyRun *run;
+  DWORD mainThreadId;
+  /* set if any events were lost, or the latency was over the limit. */
+  bool failed;
+};
+
+static int compareLongLongs(const void *a, const void *b) {
+  const long long x = *(const long long *)a, y = *(const long long *)b;
+  return x < y ? -1 : x > y;
+}
+
+/* "samples" must be sorted. */
+static long long percentileUs(const long long *samples, int count, int pct) {
+  if (count == 0) {
+    return 0;
+  }
+  return samples[(long long)(count - 1) * pct / 100] / 1000;
+}
+
+static void printHistogram(const long long *totals, int count) {
+  int buckets[LATENCY_BUCKETS] = {0};
+  for (int i = 0; i < count; ++i) {
+    const long long us = totals[i] / 1000;
+    int b = 0;
+    while (b < LATENCY_BUCKETS - 1 && us >= (1LL << b)) {
+      ++b;
+    }
+    ++buckets[b];
+  }
+  printf("  total latency histogram (us) :");
+  for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+    if (buckets[b]) {
+      printf(" <%lld:%d", 1LL << b, buckets[b]);
+    }
+  }
+  printf("\n");
+}
+
+/* returns the p99 of the total latency, in microseconds. */
+static long long report(int interval, int delta, struct LatencyRun *run,
+                        int sent, long long *totals) {
+  const int count = run->samples;
+  for (int i = 0; i < count; ++i) {
+    totals[i] = run->timer[i] + run->inject[i];
+  }
+  qsort(run->timer, count, sizeof(long long), compareLongLongs);
+  qsort(run->inject, count, sizeof(long long), compareLongLongs);
+  qsort(totals, count, sizeof(long long), compareLongLongs);
+  printf("%8d %6d %7d %6d |", interval, delta, count, sent - count);
+  const long long *sets[] = {run->timer, run->inject, totals};
+  for (int s = 0; s < 3; ++s) {
+    printf(" %7lld %7lld %7lld |", percentileUs(sets[s], count, 50),
+           percentileUs(sets[s], count, 99),
+           percentileUs(sets[s], count, 100));
+  }
+  printf("\n");
+  printHistogram(totals, count);
+  return percentileUs(totals, count, 99);
+}
+
+/* waits until "deadlineNs", on the benchmark clock. */
+static void waitUntil(HANDLE timer, long long deadlineNs) {
+  const long long remainingNs = deadlineNs - benchClockNs();
+  if (remainingNs <= 0) {
+    return;
+  }
+  LARGE_INTEGER due;
+  due.QuadPart = -(remainingNs / 100);
+  if (timer && SetWaitableTimer(timer, &due, 0, 0, 0, FALSE)) {
+    WaitForSingleObject(timer, INFINITE);
+  } else {
+    Sleep((DWORD)(remainingNs / 1000000));
+  }
+}
+
+static DWORD WINAPI tickThreadMain(void *param) {
+  /* the ticks are scheduled against absolute deadlines, like La Flor does in
+   * precise mode, so that the lateness of one tick doesn't carry over to the
+   * next ones. */
+  struct LatencyThread *thread = param;
+  const struct LatencyOptions *opts = thread->opts;
+  struct LatencyRun *run = thread->run;
+  long long *totals = malloc(run->maxSamples * sizeof(*totals));
+  if (totals == 0) {
+    /* nothing gets measured, which must not pass as a success. */
+    fprintf(stderr, "out of memory\n");
+    thread->failed = true;
+  }
+  HANDLE timer = CreateWaitableTimerW(0, FALSE, 0);
+
+  struct LatencyInjector injector;
+  memset(&injector, 0, sizeof(injector));
+  injector.run = run;
+  for (int i = 0; i < MOTION_MAX_PATH_STEPS; ++i) {
+    injector.inputs[i].type = INPUT_MOUSE;
+    injector.inputs[i].mi.dwFlags = MOUSEEVENTF_MOVE;
+  }
+  struct MotionBackend backend;
+  memset(&backend, 0, sizeof(backend));
+  backend.ctx = &injector;
+  backend.getCursorPos = latencyGetCursorPos;
+  backend.sendMove = latencySendMove;
+  backend.sendPath = latencySendPath;
+  struct ScreenLayout layout;
+  layoutInit(&layout);
+  const int left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+  const int top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+  layoutAddMonitor(&layout, left, top,
+                   left + GetSystemMetrics(SM_CXVIRTUALSCREEN),
+                   top + GetSystemMetrics(SM_CYVIRTUALSCREEN));
+
+  printf("%8s %6s %7s %6s | %-23s | %-23s | %-23s |\n", "interval", "delta",
+         "events", "lost", "timer p50/p99/max us", "inject p50/p99/max us",
+         "total p50/p99/max us");
+  for (size_t i = 0; totals && i < ARRAYSIZE(intervals); ++i) {
+    for (size_t d = 0; d < ARRAYSIZE(deltas); ++d) {
+      struct MotionState motion;
+      motionInit(&motion, &backend, deltas[d]);
+      motionSetLayout(&motion, &layout);
+      motion.smooth = opts->smooth;
+      run->samples = 0;
+      const long long periodNs = intervals[i] * 1000000LL;
+      long long deadline = benchClockNs() + periodNs;
+      const unsigned firstSeq = run->seq;
+      for (int t = 0; t < opts->ticks; ++t, deadline += periodNs) {
+        waitUntil(timer, deadline);
+        injector.deadlineNs = deadline;
+        motionTick(&motion);
+      }
+      const int sent = (int)(run->seq - firstSeq);
+      const long long drainEnd = benchClockNs() + LATENCY_DRAIN_MS * 1000000LL;
+      while (run->samples < sent && benchClockNs() < drainEnd) {
+        Sleep(10);
+      }
+      const long long p99 = report(intervals[i], deltas[d], run, sent, totals);
+      if (run->samples < sent ||
+          (opts->maxP99Us && p99 > opts->maxP99Us)) {
+        thread->failed = true;
+      }
+    }
+  }
+  if (run->foreign) {
+    printf("\n%ld other mouse events were ignored\n", (long)run->foreign);
+  }
+  if (timer) {
+    CloseHandle(timer);
+  }
+  free(totals);
+  PostThreadMessageW(thread->mainThreadId, WM_QUIT, 0, 0);
+  return 0;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--ticks N] [--smooth] [--max-p99-us N]\n"
+          "  --ticks N        ticks per interval and delta (default 50)\n"
+          "  --smooth         send smooth moves, %d events per tick\n"
+          "  --max-p99-us N   fail if the p99 of the total latency goes over\n"
+          "                   N microseconds for any interval and delta\n"
+          "the exit status is nonzero if any events were lost, or if the\n"
+          "latency was over the limit.\n",
+          argv0, MOTION_MAX_PATH_STEPS);
+}
+
+int main(int argc, char **argv) {
+  struct LatencyOptions opts = {50, false, 0};
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+      opts.ticks = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--smooth") == 0) {
+      opts.smooth = true;
+    } else if (strcmp(argv[i], "--max-p99-us") == 0 && i + 1 < argc) {
+      opts.maxP99Us = atol(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (opts.ticks <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  struct LatencyRun run;
+  memset(&run, 0, sizeof(run));
+  run.maxSamples = opts.ticks * (opts.smooth ? MOTION_MAX_PATH_STEPS : 1);
+  run.timer = malloc(run.maxSamples * sizeof(*run.timer));
+  run.inject = malloc(run.maxSamples * sizeof(*run.inject));
+  if (run.timer == 0 || run.inject == 0) {
+    return 1;
+  }
+  hookRun = &run;
+  HHOOK hook =
+      SetWindowsHookExW(WH_MOUSE_LL, mouseHook, GetModuleHandleW(0), 0);
+  if (hook == 0) {
+    fprintf(stderr, "couldn't install the mouse hook (error %lu)\n",
+            (unsigned long)GetLastError());
+    return 1;
+  }
+
+  /* the hook is called through this thread's message loop, so it has to keep
+   * pumping messages while the ticks run on another thread. */
+  struct LatencyThread thread = {&opts, &run, GetCurrentThreadId(), false};
+  HANDLE tickThread = CreateThread(0, 0, tickThreadMain, &thread, 0, 0);
+  if (tickThread == 0) {
+    UnhookWindowsHookEx(hook);
+    return 1;
+  }
+  MSG msg;
+  while (GetMessageW(&msg, 0, 0, 0) > 0) {
+    DispatchMessageW(&msg);
+  }
+  WaitForSingleObject(tickThread, INFINITE);
+  CloseHandle(tickThread);
+  UnhookWindowsHookEx(hook);
+  free(run.timer);
+  free(run.inject);
+  return thread.failed ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+/* measures how fast the path generator produces points, for each pattern, with
+ * the SSE2 kernels and with their plain C counterparts. every chunk is turned
+ * into steps, just like on the tick path, where a single chunk is all that a
+ * tick ever generates : the ns/chunk column is what a tick pays for its
+ * pattern. the two kinds of kernels are also checked against each other, and
+ * the way they round the points to pixels is checked for both. */
+
+#include "benchclock.h"
+#include "pathgen.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const patternNames[PATHGEN_PATTERN_COUNT] = {
+    "min-jerk", "bezier", "lissajous"};
+
+/* the largest difference between the points generated by the SSE2 kernels and
+ * the plain C ones, over the given number of chunks. */
+static float compareKernels(enum PathPattern pattern, long chunks) {
+  struct PathGen simd, scalar;
+  pathgenInit(&simd, pattern, 1);
+  pathgenInit(&scalar, pattern, 1);
+  scalar.simd = false;
+  float maxDiff = 0;
+  for (long c = 0; c < chunks; ++c) {
+    pathgenChunk(&simd);
+    pathgenChunk(&scalar);
+    for (int i = 0; i < PATHGEN_CHUNK; ++i) {
+      const float dx = simd.x[i] - scalar.x[i];
+      const float dy = simd.y[i] - scalar.y[i];
+      const float adx = dx < 0 ? -dx : dx;
+      const float ady = dy < 0 ? -dy : dy;
+      maxDiff = adx > maxDiff ? adx : maxDiff;
+      maxDiff = ady > maxDiff ? ady : maxDiff;
+    }
+  }
+  return maxDiff;
+}
+
+/* the number of points where the steps produced by the given kernels don't
+ * lead to the point rounded half away from zero, which is what both kinds of
+ * kernels are meant to do. at a scale of 2^22, every point in [0.5, 1) is
+ * either a whole number or a tie once it's scaled, so ties get checked too. */
+static long countRoundingErrors(enum PathPattern pattern, bool simd,
+                                float scale, long chunks) {
+  struct PathGen gen;
+  pathgenInit(&gen, pattern, 1);
+  gen.simd = simd;
+  struct MotionStep steps[PATHGEN_CHUNK];
+  int x = gen.lastX, y = gen.lastY;
+  long errors = 0;
+  for (long c = 0; c < chunks; ++c) {
+    pathgenSteps(&gen, scale, steps);
+    for (int i = 0; i < PATHGEN_CHUNK; ++i) {
+      const float sx = gen.x[i] * scale;
+      const float sy = gen.y[i] * scale;
+      const int rx = (int)(sx < 0 ? sx - 0.5f : sx + 0.5f);
+      const int ry = (int)(sy < 0 ? sy - 0.5f : sy + 0.5f);
+      x += steps[i].dx;
+      y += steps[i].dy;
+      if (x != rx || y != ry) {
+        ++errors;
+        x = rx;
+        y = ry;
+      }
+    }
+  }
+  return errors;
+}
+
+static void runPattern(enum PathPattern pattern, bool simd, long chunks) {
+  struct PathGen gen;
+  pathgenInit(&gen, pattern, 1);
+  gen.simd = simd;
+  struct MotionStep steps[PATHGEN_CHUNK];
+  /* the steps are summed up, which both keeps the compiler from optimizing
+   * the whole thing away and shows where the cursor would end up. */
+  long long sumX = 0, sumY = 0;
+  const long long start = benchClockNs();
+  for (long c = 0; c < chunks; ++c) {
+    pathgenSteps(&gen, 100, steps);
+    for (int i = 0; i < PATHGEN_CHUNK; ++i) {
+      sumX += steps[i].dx;
+      sumY += steps[i].dy;
+    }
+  }
+  const long long elapsed = benchClockNs() - start;
+  const double points = (double)chunks * PATHGEN_CHUNK;
+  printf("%-10s %-6s %14.0f %10.2f %10.1f  (%lld,%lld)\n",
+         patternNames[pattern], simd ? "sse2" : "scalar",
+         elapsed ? points / (elapsed / 1e9) : 0.0, elapsed / points,
+         (double)elapsed / chunks, sumX, sumY);
+}
+
+int main(int argc, char **argv) {
+  long chunks = 2000000;
+  if (argc == 3 && strcmp(argv[1], "--chunks") == 0) {
+    chunks = atol(argv[2]);
+  } else if (argc != 1) {
+    fprintf(stderr, "usage: %s [--chunks N]\n", argv[0]);
+    return 1;
+  }
+  if (chunks <= 0) {
+    fprintf(stderr, "usage: %s [--chunks N]\n", argv[0]);
+    return 1;
+  }
+
+  printf("%-10s %-6s %14s %10s %10s  %s\n", "pattern", "kernel", "points/s",
+         "ns/point", "ns/chunk", "final cursor");
+  for (int p = 0; p < PATHGEN_PATTERN_COUNT; ++p) {
+    if (pathgenHaveSimd()) {
+      runPattern((enum PathPattern)p, true, chunks);
+    }
+    runPattern((enum PathPattern)p, false, chunks);
+  }
+  if (pathgenHaveSimd()) {
+    printf("\n%-10s %s\n", "pattern", "max sse2/scalar difference");
+    for (int p = 0; p < PATHGEN_PATTERN_COUNT; ++p) {
+      printf("%-10s %g\n", patternNames[p],
+             compareKernels((enum PathPattern)p, 100000));
+    }
+  }
+  printf("\n%-10s %-6s %s\n", "pattern", "kernel",
+         "rounding errors at scale 100 / 2^22");
+  for (int p = 0; p < PATHGEN_PATTERN_COUNT; ++p) {
+    for (int simd = pathgenHaveSimd(); simd >= 0; --simd) {
+      printf("%-10s %-6s %ld / %ld\n", patternNames[p],
+             simd ? "sse2" : "scalar",
+             countRoundingErrors((enum PathPattern)p, simd, 100, 100000),
+             countRoundingErrors((enum PathPattern)p, simd, 1 << 22, 100000));
+    }
+  }
+  return 0;
+}
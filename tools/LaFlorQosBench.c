@@ -0,0 +1,415 @@
+/* measures what background mode costs and saves, by running La Flor in either
+ * mode next to a CPU-bound benchmark, which stands for the latency-sensitive
+ * application that La Flor shares the machine with :
+ *
+ *   LaFlorQosBench --interval 250 --seconds 10 build\Release\LaFlor.exe
+ *
+ * first, La Flor is started a few times in each mode, with the machine idle
+ * and then with the benchmark keeping every processor busy. the time that it
+ * takes to be ready (see tools/LaFlorFootprint.c) is reported, along with how
+ * late its first tick was. the ticks are on the grid that spreads them over
+ * the interval (see the README), so the first deadline comes anywhere from 0
+ * to an interval after startup, depending on where startup ended relative to
+ * the grid : that wait is reported on its own, and left out of the startup
+ * time, which is the time to be ready plus the lateness of the first tick.
+ *
+ * then, the benchmark runs on its own for a while, and with La Flor ticking
+ * in each mode : the rounds per second are compared to the ones without La
+ * Flor, and the lateness of the ticks which came during the benchmark is read
+ * from La Flor's telemetry.
+ *
+ * since La Flor only runs once per session, no other instance may be running
+ * in the meantime. every instance is asked to quit the regular way, which
+ * saves its settings as usual : the interval, enabled and the mode of the
+ * last run. */
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include "benchclock.h"
+#include "rootwindow.h"
+#include "sharedmem.h"
+#include "telemetry.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* how long La Flor gets to start up and run its first tick. */
+#define QOS_START_TIMEOUT_MS 10000
+
+/* the most ticks which are looked at for a single run : the whole ring. */
+#define QOS_MAX_RECORDS TELEMETRY_DEFAULT_CAPACITY
+
+static const char *const modeNames[] = {"foreground", "background"};
+
+/* a thread of the benchmark, which only writes to its own struct once it's
+ * been told to stop, so that the threads never share a cache line while
+ * they're running. */
+struct BurnThread {
+  HANDLE thread;
+  volatile LONG *stop;
+  uint32_t seed;
+  unsigned long long rounds;
+};
+
+struct Burn {
+  struct BurnThread *threads;
+  int count;
+  volatile LONG stop;
+  long long startNs;
+};
+
+struct Startup {
+  double readyMs;
+  /* from being ready to the deadline of the first tick. */
+  double gridWaitMs;
+  double lateMs;
+};
+
+struct Lateness {
+  uint32_t ticks;
+  long long p50Us;
+  long long p99Us;
+  long long maxUs;
+};
+
+static DWORD WINAPI burnThreadMain(void *param) {
+  struct BurnThread *thread = param;
+  uint32_t x = thread->seed;
+  unsigned long long rounds = 0;
+  while (!*thread->stop) {
+    for (int i = 0; i < 4096; ++i) {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+    }
+    ++rounds;
+  }
+  /* the seed is written back so that the loop can't be optimized away. */
+  thread->seed = x;
+  thread->rounds = rounds;
+  return 0;
+}
+
+static bool burnStart(struct Burn *burn, int count) {
+  burn->threads = calloc(count, sizeof(*burn->threads));
+  if (burn->threads == 0) {
+    return false;
+  }
+  burn->count = count;
+  burn->stop = 0;
+  burn->startNs = benchClockNs();
+  for (int i = 0; i < count; ++i) {
+    struct BurnThread *thread = &burn->threads[i];
+    thread->stop = &burn->stop;
+    thread->seed = 0x9e3779b9u * (i + 1);
+    thread->thread = CreateThread(0, 0, burnThreadMain, thread, 0, 0);
+  }
+  return true;
+}
+
+/* stops the benchmark, and returns its rounds per second. */
+static double burnStop(struct Burn *burn) {
+  InterlockedExchange(&burn->stop, 1);
+  unsigned long long rounds = 0;
+  for (int i = 0; i < burn->count; ++i) {
+    struct BurnThread *thread = &burn->threads[i];
+    if (thread->thread) {
+      WaitForSingleObject(thread->thread, INFINITE);
+      CloseHandle(thread->thread);
+      rounds += thread->rounds;
+    }
+  }
+  const long long elapsedNs = benchClockNs() - burn->startNs;
+  free(burn->threads);
+  return rounds * 1e9 / elapsedNs;
+}
+
+/* makes La Flor quit, and closes its handles. */
+static void quit(const PROCESS_INFORMATION *pi) {
+  quitLaFlor(pi);
+  CloseHandle(pi->hThread);
+  CloseHandle(pi->hProcess);
+}
+
+/* starts La Flor, ticking every "interval" milliseconds in the given mode,
+ * and waits until it's run its first tick, which "first" is set to. the
+ * telemetry stays attached, and must be closed before La Flor quits :
+ * otherwise, the next instance would find the mapping still there, and not
+ * record anything. */
+static bool start(const char *exe, int interval, int mode,
+                  PROCESS_INFORMATION *pi, struct SharedMem *mem,
+                  struct TelemetryRing *ring, struct Startup *out,
+                  struct TelemetryRecord *first) {
+  char cmdLine[MAX_PATH + 64];
+  snprintf(cmdLine, sizeof(cmdLine), "\"%s\" --interval %d --enable --%s", exe,
+           interval, modeNames[mode]);
+  STARTUPINFOA startup;
+  memset(&startup, 0, sizeof(startup));
+  startup.cb = sizeof(startup);
+  const long long startNs = benchClockNs();
+  if (!CreateProcessA(exe, cmdLine, 0, 0, FALSE, 0, 0, 0, &startup, pi)) {
+    fprintf(stderr, "couldn't start %s (error %lu)\n", exe, GetLastError());
+    return false;
+  }
+  if (WaitForInputIdle(pi->hProcess, QOS_START_TIMEOUT_MS) != 0) {
+    fprintf(stderr, "%s didn't finish starting up\n", exe);
+    quit(pi);
+    return false;
+  }
+  out->readyMs = (benchClockNs() - startNs) / 1e6;
+  /* the telemetry is set up before the window, so it's there by now, unless
+   * this instance just forwarded its command line to another one. */
+  if (!sharedMemOpen(mem, TELEMETRY_NAME)) {
+    fprintf(stderr, "couldn't attach to the telemetry : is La Flor already "
+                    "running?\n");
+    quit(pi);
+    return false;
+  }
+  if (!telemetryAttach(ring, mem->data, mem->size)) {
+    fprintf(stderr, "the telemetry isn't valid\n");
+    sharedMemClose(mem);
+    quit(pi);
+    return false;
+  }
+  /* the records are timestamped with the same performance counter as the
+   * benchmark clock, so the first one tells exactly when the tick ran : the
+   * polling only has to notice it. */
+  uint32_t cursor = 0;
+  unsigned long long lost = 0;
+  for (DWORD waitedMs = 0; waitedMs < QOS_START_TIMEOUT_MS; ++waitedMs) {
+    if (telemetryRead(ring, &cursor, first, 1, &lost) == 1) {
+      out->gridWaitMs =
+          (first->scheduledUs - startNs / 1000) / 1e3 - out->readyMs;
+      out->lateMs = (first->actualUs - first->scheduledUs) / 1e3;
+      return true;
+    }
+    Sleep(1);
+  }
+  fprintf(stderr, "La Flor didn't tick\n");
+  sharedMemClose(mem);
+  quit(pi);
+  return false;
+}
+
+static int compareLongLongs(const void *a, const void *b) {
+  const long long x = *(const long long *)a, y = *(const long long *)b;
+  return x < y ? -1 : x > y;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+  const double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+static double median(double *values, int count) {
+  qsort(values, count, sizeof(*values), compareDoubles);
+  return values[count / 2];
+}
+
+static long long percentileUs(const long long *sorted, uint32_t count,
+                              int pct) {
+  const uint32_t idx = (uint32_t)(((unsigned long long)count * pct + 99) / 100);
+  return sorted[idx == 0 ? 0 : idx - 1];
+}
+
+/* the lateness of the ticks from "cursor" on. ticks may fire a tiny bit
+ * early, which counts as on time. */
+static void readLateness(const struct TelemetryRing *ring, uint32_t cursor,
+                         struct TelemetryRecord *records, long long *lateUs,
+                         struct Lateness *out) {
+  unsigned long long lost = 0;
+  const uint32_t count =
+      telemetryRead(ring, &cursor, records, QOS_MAX_RECORDS, &lost);
+  for (uint32_t i = 0; i < count; ++i) {
+    const long long late = records[i].actualUs - records[i].scheduledUs;
+    lateUs[i] = late > 0 ? late : 0;
+  }
+  memset(out, 0, sizeof(*out));
+  out->ticks = count;
+  if (count) {
+    qsort(lateUs, count, sizeof(*lateUs), compareLongLongs);
+    out->p50Us = percentileUs(lateUs, count, 50);
+    out->p99Us = percentileUs(lateUs, count, 99);
+    out->maxUs = lateUs[count - 1];
+  }
+}
+
+/* the median startup over "runs" runs, with the benchmark running on
+ * "threads" threads if that's not 0. "samples" has room for 3 * "runs"
+ * values : the ones of each column are sorted on their own. */
+static bool measureStartup(const char *exe, int interval, int mode, int runs,
+                           int threads, double *samples, struct Startup *out) {
+  struct Burn burn;
+  if (threads && !burnStart(&burn, threads)) {
+    return false;
+  }
+  int run = 0;
+  for (; run < runs; ++run) {
+    PROCESS_INFORMATION pi;
+    struct SharedMem mem;
+    struct TelemetryRing ring;
+    struct TelemetryRecord first;
+    struct Startup startup;
+    if (!start(exe, interval, mode, &pi, &mem, &ring, &startup, &first)) {
+      break;
+    }
+    sharedMemClose(&mem);
+    quit(&pi);
+    samples[run] = startup.readyMs;
+    samples[runs + run] = startup.gridWaitMs;
+    samples[2 * runs + run] = startup.lateMs;
+  }
+  if (threads) {
+    burnStop(&burn);
+  }
+  if (run < runs) {
+    return false;
+  }
+  out->readyMs = median(samples, runs);
+  out->gridWaitMs = median(samples + runs, runs);
+  out->lateMs = median(samples + 2 * runs, runs);
+  return true;
+}
+
+/* runs the benchmark for "seconds" next to La Flor in the given mode, or
+ * without La Flor if "mode" is -1, and returns its rounds per second. */
+static double measureInterference(const char *exe, int interval, int mode,
+                                  int seconds, int threads,
+                                  struct TelemetryRecord *records,
+                                  long long *lateUs, struct Lateness *out) {
+  memset(out, 0, sizeof(*out));
+  PROCESS_INFORMATION pi;
+  struct SharedMem mem;
+  struct TelemetryRing ring;
+  struct Startup startup;
+  struct TelemetryRecord first;
+  if (mode >= 0 &&
+      !start(exe, interval, mode, &pi, &mem, &ring, &startup, &first)) {
+    return -1;
+  }
+  const uint32_t cursor = mode >= 0 ? ring.header->head : 0;
+  struct Burn burn;
+  double rv = -1;
+  if (burnStart(&burn, threads)) {
+    Sleep(seconds * 1000);
+    rv = burnStop(&burn);
+  }
+  if (mode >= 0) {
+    readLateness(&ring, cursor, records, lateUs, out);
+    sharedMemClose(&mem);
+    quit(&pi);
+  }
+  return rv;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--interval MS] [--seconds S] [--threads N] [--runs N] "
+          "EXE\n"
+          "  --interval MS  the interval that La Flor ticks at (default 250)\n"
+          "  --seconds S    how long the benchmark runs for (default 10)\n"
+          "  --threads N    the threads of the benchmark (default: one per\n"
+          "                 processor)\n"
+          "  --runs N       start La Flor N times for the startup (default "
+          "5)\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int interval = 250;
+  int seconds = 10;
+  int threads = (int)info.dwNumberOfProcessors;
+  int runs = 5;
+  int first = 1;
+  for (; first < argc && strncmp(argv[first], "--", 2) == 0; first += 2) {
+    if (first + 1 >= argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    const int value = atoi(argv[first + 1]);
+    if (strcmp(argv[first], "--interval") == 0) {
+      interval = value;
+    } else if (strcmp(argv[first], "--seconds") == 0) {
+      seconds = value;
+    } else if (strcmp(argv[first], "--threads") == 0) {
+      threads = value;
+    } else if (strcmp(argv[first], "--runs") == 0) {
+      runs = value;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (first + 1 != argc || interval <= 0 || seconds <= 0 || threads <= 0 ||
+      runs <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  const char *exe = argv[first];
+  if (FindWindowW(CONTROL_WINDOW_CLASS, 0)) {
+    fprintf(stderr, "La Flor is already running in this session : quit it "
+                    "first\n");
+    return 1;
+  }
+  double *samples = malloc(3 * runs * sizeof(*samples));
+  struct TelemetryRecord *records = malloc(QOS_MAX_RECORDS * sizeof(*records));
+  long long *lateUs = malloc(QOS_MAX_RECORDS * sizeof(*lateUs));
+  if (samples == 0 || records == 0 || lateUs == 0) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  printf("startup, median of %d runs, ticking every %d ms\n\n", runs,
+         interval);
+  printf("%-12s %-6s %10s %10s %10s %13s\n", "mode", "load", "ready ms",
+         "late ms", "startup ms", "grid wait ms");
+  int rv = 0;
+  for (int mode = 0; mode < 2; ++mode) {
+    for (int loaded = 0; loaded < 2; ++loaded) {
+      struct Startup startup;
+      if (!measureStartup(exe, interval, mode, runs, loaded ? threads : 0,
+                          samples, &startup)) {
+        rv = 1;
+        continue;
+      }
+      printf("%-12s %-6s %10.1f %10.2f %10.1f %13.1f\n", modeNames[mode],
+             loaded ? "busy" : "idle", startup.readyMs, startup.lateMs,
+             startup.readyMs + startup.lateMs, startup.gridWaitMs);
+    }
+  }
+
+  printf("\nbenchmark on %d thread(s) for %d s, next to La Flor ticking every "
+         "%d ms\n\n",
+         threads, seconds, interval);
+  printf("%-12s %14s %9s %7s %10s %10s %10s\n", "la flor", "rounds/s",
+         "relative", "ticks", "late p50us", "late p99us", "late maxus");
+  struct Lateness lateness;
+  const double baseline = measureInterference(exe, interval, -1, seconds,
+                                              threads, records, lateUs,
+                                              &lateness);
+  printf("%-12s %14.0f %8.2f%% %7s %10s %10s %10s\n", "none", baseline, 100.0,
+         "-", "-", "-", "-");
+  for (int mode = 0; mode < 2; ++mode) {
+    const double rounds =
+        measureInterference(exe, interval, mode, seconds, threads, records,
+                            lateUs, &lateness);
+    if (rounds < 0 || baseline <= 0) {
+      rv = 1;
+      continue;
+    }
+    printf("%-12s %14.0f %8.2f%% %7lu %10lld %10lld %10lld\n",
+           modeNames[mode], rounds, 100.0 * rounds / baseline,
+           (unsigned long)lateness.ticks, lateness.p50Us, lateness.p99Us,
+           lateness.maxUs);
+  }
+  free(lateUs);
+  free(records);
+  free(samples);
+  return rv;
+}
@@ -0,0 +1,221 @@
+/* measures what running a motion script costs : how long compiling it takes,
+ * how long each tick spends in the interpreter, and how long each statement
+ * takes on average. the plain bouncing done by the motion engine, which is
+ * what a tick costs without a script, is measured alongside as a reference.
+ * the input goes to a backend which only adds the moves up, so the figures
+ * are those of the interpreter alone, without SendInput() :
+ *
+ *   ./build/LaFlorScriptBench --ticks 1000000
+ *   ./build/LaFlorScriptBench --file LaFlor.script */
+
+#include "benchclock.h"
+#include "layout.h"
+#include "motion.h"
+#include "script.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct BenchScript {
+  const char *name;
+  const char *source;
+};
+
+static const struct BenchScript scripts[] = {
+    {"nudge", "move 3 0\n"
+              "wait 40s\n"
+              "scroll 1\n"
+              "home\n"
+              "wait 1min 10s\n"},
+    {"loops", "repeat 4\n"
+              "  glide 40 -20\n"
+              "  repeat 3\n"
+              "    move 1 1\n"
+              "    wait 250 50\n"
+              "  end\n"
+              "  scroll -1\n"
+              "end\n"
+              "home\n"
+              "wait 5s 1s\n"},
+    /* no waits at all : every tick runs SCRIPT_MAX_STATEMENTS_PER_TICK
+     * statements, which is as much as a tick can ever cost. */
+    {"busy", "repeat 1000\n"
+             "  move 1 0\n"
+             "  move -1 0\n"
+             "end\n"}};
+
+/* the backend only adds the moves up, which keeps the compiler from
+ * optimizing them away and shows where the cursor would end up. */
+struct BenchBackend {
+  int x;
+  int y;
+  long long wheel;
+  long long sends;
+};
+
+static void benchGetCursorPos(void *ctx, int *x, int *y) {
+  struct BenchBackend *bench = ctx;
+  *x = bench->x;
+  *y = bench->y;
+}
+
+static void benchSendMove(void *ctx, int dx, int dy) {
+  struct BenchBackend *bench = ctx;
+  bench->x += dx;
+  bench->y += dy;
+  ++bench->sends;
+}
+
+static void benchSendPath(void *ctx, const struct MotionStep *steps,
+                          int count) {
+  struct BenchBackend *bench = ctx;
+  for (int i = 0; i < count; ++i) {
+    bench->x += steps[i].dx;
+    bench->y += steps[i].dy;
+  }
+  ++bench->sends;
+}
+
+static void benchSendWheel(void *ctx, int notches) {
+  struct BenchBackend *bench = ctx;
+  bench->wheel += notches;
+  ++bench->sends;
+}
+
+static void initBackend(struct MotionBackend *backend,
+                        struct BenchBackend *bench) {
+  memset(bench, 0, sizeof(*bench));
+  bench->x = 960;
+  bench->y = 540;
+  memset(backend, 0, sizeof(*backend));
+  backend->ctx = bench;
+  backend->getCursorPos = benchGetCursorPos;
+  backend->sendMove = benchSendMove;
+  backend->sendPath = benchSendPath;
+  backend->sendWheel = benchSendWheel;
+}
+
+static void printRow(const char *name, long long elapsedNs, long ticks,
+                     unsigned long long statements,
+                     const struct BenchBackend *bench) {
+  printf("%-10s %10.1f %10.2f %10.2f %10.1f  (%d,%d)\n", name,
+         (double)elapsedNs / ticks,
+         statements ? (double)elapsedNs / statements : 0.0,
+         (double)statements / ticks, (double)bench->sends / ticks, bench->x,
+         bench->y);
+}
+
+static void runBounce(bool smooth, long ticks) {
+  struct BenchBackend bench;
+  struct MotionBackend backend;
+  initBackend(&backend, &bench);
+  struct ScreenLayout layout;
+  layoutInit(&layout);
+  layoutAddMonitor(&layout, 0, 0, 1920, 1080);
+  struct MotionState motion;
+  motionInit(&motion, &backend, 5);
+  motionSetLayout(&motion, &layout);
+  motion.smooth = smooth;
+  motionSetDelta(&motion, 5);
+  const long long start = benchClockNs();
+  for (long t = 0; t < ticks; ++t) {
+    motionTick(&motion);
+  }
+  printRow(smooth ? "smooth" : "bounce", benchClockNs() - start, ticks, 0,
+           &bench);
+}
+
+static bool runScript(const char *name, const char *source, size_t len,
+                      long ticks) {
+  static struct ScriptProgram program;
+  struct ScriptError err;
+  const long long compileStart = benchClockNs();
+  if (!scriptCompile(source, len, &program, &err)) {
+    fprintf(stderr, "%s, line %d : %s\n", name, err.line, err.message);
+    return false;
+  }
+  const long long compileNs = benchClockNs() - compileStart;
+
+  struct BenchBackend bench;
+  struct MotionBackend backend;
+  initBackend(&backend, &bench);
+  struct ScriptVm vm;
+  scriptInit(&vm, &program, &backend, 1);
+  /* the waits are added up as well, for the same reason as the moves. */
+  long long waitedMs = 0;
+  const long long start = benchClockNs();
+  for (long t = 0; t < ticks; ++t) {
+    const long waitMs = scriptTick(&vm);
+    waitedMs += waitMs > 0 ? waitMs : 0;
+  }
+  const long long elapsed = benchClockNs() - start;
+  printRow(name, elapsed, ticks, vm.statements, &bench);
+  printf("%-10s compiled %d statements into %lu bytes in %.1f us, %lld ms "
+         "waited\n",
+         "", program.statements, (unsigned long)program.len, compileNs / 1e3,
+         waitedMs);
+  return true;
+}
+
+/* reads a whole script file, which is at most SCRIPT_MAX_SOURCE bytes. */
+static char *readFile(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (f == 0) {
+    return 0;
+  }
+  char *buf = malloc(SCRIPT_MAX_SOURCE);
+  *len = buf ? fread(buf, 1, SCRIPT_MAX_SOURCE, f) : 0;
+  fclose(f);
+  return buf;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--ticks N] [--file SCRIPT]\n", argv0);
+}
+
+int main(int argc, char **argv) {
+  long ticks = 1000000;
+  const char *file = 0;
+  for (int i = 1; i < argc; i += 2) {
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    if (strcmp(argv[i], "--ticks") == 0) {
+      ticks = atol(argv[i + 1]);
+    } else if (strcmp(argv[i], "--file") == 0) {
+      file = argv[i + 1];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (ticks <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  printf("%-10s %10s %10s %10s %10s  %s\n", "script", "ns/tick", "ns/stmt",
+         "stmts/tick", "sends/tick", "final cursor");
+  runBounce(false, ticks);
+  runBounce(true, ticks);
+  if (file) {
+    size_t len;
+    char *source = readFile(file, &len);
+    if (source == 0) {
+      fprintf(stderr, "couldn't read %s\n", file);
+      return 1;
+    }
+    const bool ok = runScript(file, source, len, ticks);
+    free(source);
+    return ok ? 0 : 1;
+  }
+  for (size_t i = 0; i < sizeof(scripts) / sizeof(scripts[0]); ++i) {
+    if (!runScript(scripts[i].name, scripts[i].source,
+                   strlen(scripts[i].source), ticks)) {
+      return 1;
+    }
+  }
+  return 0;
+}
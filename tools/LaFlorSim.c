@@ -0,0 +1,480 @@
+/* headless simulator for the motion engine. it runs the very same code that
+ * moves the cursor in the Windows application, but against a virtual cursor
+ * and a virtual screen, in virtual time : no timers are ever waited on, so
+ * millions of ticks (weeks' worth of a real La Flor session) can be simulated
+ * in a couple of seconds. the output is meant to be a reproducible measure of
+ * the cost of the tick path, so that any change to it can be compared against
+ * the previous numbers. */
+
+#include "benchclock.h"
+#include "motion.h"
+#include "scheduler.h"
+#include "sharedmem.h"
+#include "telemetry.h"
+#include "trace.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_MAX_MONITORS 4
+
+struct SimLayout {
+  const char *name;
+  int count;
+  struct ScreenRect monitors[SIM_MAX_MONITORS];
+};
+
+static const struct SimLayout simLayouts[] = {
+    {"tiny", 1, {{0, 0, 32, 24}}},
+    {"vga", 1, {{0, 0, 640, 480}}},
+    {"1080p", 1, {{0, 0, 1920, 1080}}},
+    {"dual-1080p", 2, {{0, 0, 1920, 1080}, {1920, 0, 3840, 1080}}},
+    {"4k", 1, {{0, 0, 3840, 2160}}},
+    {"triple-1440p",
+     3,
+     {{0, 0, 2560, 1440}, {2560, 0, 5120, 1440}, {5120, 0, 7680, 1440}}},
+    /* a taller secondary monitor to the left of the primary one, i.e. at
+     * negative coordinates. */
+    {"left-of-primary", 2, {{0, 0, 1920, 1080}, {-2560, -360, 0, 1080}}},
+    /* three monitors arranged in an L, with the bottom right corner of the
+     * virtual screen not covered by anything. */
+    {"l-shape",
+     3,
+     {{0, 0, 1920, 1080}, {1920, 0, 3840, 1080}, {0, 1080, 1920, 2160}}},
+};
+
+/* the simulated "operating system" : it owns the virtual cursor and counts
+ * everything that the engine asked it to do. */
+struct SimBackend {
+  struct ScreenLayout layout;
+  int hint;
+  int x;
+  int y;
+  unsigned long long cursorQueries;
+  unsigned long long moves;
+  unsigned long long paths;
+  unsigned long long pathSteps;
+  /* the number of moves which tried to take the cursor off the screen. */
+  unsigned long long clipped;
+};
+
+static int clampInt(int val, int lo, int hi) {
+  return val < lo ? lo : (val > hi ? hi : val);
+}
+
+static void simGetCursorPos(void *ctx, int *x, int *y) {
+  struct SimBackend *sim = ctx;
+  ++sim->cursorQueries;
+  *x = sim->x;
+  *y = sim->y;
+}
+
+static void simMoveBy(struct SimBackend *sim, int dx, int dy) {
+  /* just like the real thing, the cursor can't ever leave the screen : a move
+   * which would take it off all monitors is clipped to the edges of the
+   * monitor that it's currently on. */
+  const int x = sim->x + dx;
+  const int y = sim->y + dy;
+  if (layoutFind(&sim->layout, x, y, &sim->hint) != -1) {
+    sim->x = x;
+    sim->y = y;
+    return;
+  }
+  ++sim->clipped;
+  const int current = layoutFind(&sim->layout, sim->x, sim->y, &sim->hint);
+  if (current != -1) {
+    const struct ScreenRect *rect = &sim->layout.monitors[current];
+    sim->x = clampInt(x, rect->left, rect->right - 1);
+    sim->y = clampInt(y, rect->top, rect->bottom - 1);
+  }
+}
+
+static void simSendMove(void *ctx, int dx, int dy) {
+  struct SimBackend *sim = ctx;
+  ++sim->moves;
+  simMoveBy(sim, dx, dy);
+}
+
+static void simSendPath(void *ctx, const struct MotionStep *steps,
+                        int count) {
+  struct SimBackend *sim = ctx;
+  ++sim->paths;
+  sim->pathSteps += count;
+  for (int i = 0; i < count; ++i) {
+    simMoveBy(sim, steps[i].dx, steps[i].dy);
+  }
+}
+
+static void simMoveTo(struct SimBackend *sim, int x, int y) {
+  simMoveBy(sim, x - sim->x, y - sim->y);
+}
+
+static void simSendMoveTo(void *ctx, int x, int y) {
+  struct SimBackend *sim = ctx;
+  ++sim->moves;
+  simMoveTo(sim, x, y);
+}
+
+static void simSendPathTo(void *ctx, int fromX, int fromY,
+                          const struct MotionStep *steps, int count) {
+  struct SimBackend *sim = ctx;
+  ++sim->paths;
+  sim->pathSteps += count;
+  int x = fromX, y = fromY;
+  for (int i = 0; i < count; ++i) {
+    x += steps[i].dx;
+    y += steps[i].dy;
+    simMoveTo(sim, x, y);
+  }
+}
+
+/* scrolling doesn't move the cursor, so there's nothing to simulate. */
+static void simSendWheel(void *ctx, int notches) {}
+
+struct SimOptions {
+  long long ticks;
+  int interval;
+  int delta;
+  const char *layout;
+  int latencyUs;
+  bool smooth;
+  bool absolute;
+  int reconcileEvery;
+  const char *telemetry;
+  const char *replay;
+  const char *record;
+};
+
+/* the traces that the simulated ticks replay or record, if any. */
+struct SimTraces {
+  struct TraceReader *replay;
+  struct TraceWriter *record;
+};
+
+/* xorshift64 : the simulator needs to be reproducible, so all randomness comes
+ * from a fixed seed. */
+static unsigned long long simRandom(unsigned long long *seed) {
+  unsigned long long x = *seed;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return *seed = x;
+}
+
+/* how late the simulated OS delivers a timer tick : a uniformly random latency
+ * up to the given maximum, plus a rare stall of a couple of periods, as
+ * happens when the message loop is busy with something else. */
+static long long simTickLatency(unsigned long long *seed, int maxLatencyUs,
+                                long long periodUs) {
+  const unsigned long long r = simRandom(seed);
+  long long latency = maxLatencyUs ? (long long)(r % maxLatencyUs) : 0;
+  if ((r >> 32) % 1000 == 0) {
+    latency += 2 * periodUs;
+  }
+  return latency;
+}
+
+static void printSchedulerLine(const char *name, const struct TickStats *stats,
+                               long long ticks, long long driftUs) {
+  printf("%-16s %12lld %10.2f %10.2f %10.2f %8lld %12.1f\n", name, ticks,
+         stats->ticks ? stats->jitterSumUs / 1000.0 / stats->ticks : 0.0,
+         schedulerJitterPercentileUs(stats, 99) / 1000.0,
+         stats->jitterMaxUs / 1000.0, stats->missed, driftUs / 1000.0);
+}
+
+/* compares scheduling every tick relative to when the previous one fired (what
+ * SetTimer() does) with absolute deadlines, over the same span of virtual time
+ * and the same sequence of latencies. */
+static void runScheduler(const struct SimOptions *opts) {
+  const long long periodUs = opts->interval * 1000LL;
+  const long long spanUs = opts->ticks * periodUs;
+
+  struct TickScheduler relative;
+  schedulerInit(&relative);
+  schedulerStart(&relative, 0, periodUs);
+  unsigned long long seed = 0x5eed;
+  long long relativeTicks = 0;
+  long long now = 0;
+  while (relative.nextDeadlineUs < spanUs) {
+    now = relative.nextDeadlineUs +
+          simTickLatency(&seed, opts->latencyUs, periodUs);
+    schedulerOnFire(&relative, now);
+    schedulerStart(&relative, now, periodUs);
+    ++relativeTicks;
+  }
+  /* the drift is how far behind a perfectly punctual timer the last tick
+   * was. */
+  printSchedulerLine("relative", &relative.stats, relativeTicks,
+                     now - relativeTicks * periodUs);
+
+  struct TickScheduler absolute;
+  schedulerInit(&absolute);
+  schedulerStart(&absolute, 0, periodUs);
+  seed = 0x5eed;
+  long long absoluteTicks = 0;
+  long long lastDeadline = 0;
+  while (absolute.nextDeadlineUs < spanUs) {
+    lastDeadline = absolute.nextDeadlineUs;
+    now = lastDeadline + simTickLatency(&seed, opts->latencyUs, periodUs);
+    schedulerOnFire(&absolute, now);
+    ++absoluteTicks;
+  }
+  printSchedulerLine("absolute", &absolute.stats, absoluteTicks,
+                     lastDeadline - (absoluteTicks + absolute.stats.missed) *
+                                        periodUs);
+}
+
+/* runs the motion of a single tick : either the next segment of the replayed
+ * trace, sent as a single path just like the application does, or a step of
+ * the bouncing motion. */
+static void runTick(struct MotionState *motion, struct TraceReader *replay,
+                    int interval) {
+  if (replay) {
+    struct MotionStep steps[MOTION_MAX_PATH_STEPS];
+    const int count =
+        traceNextSegment(replay, interval, steps, MOTION_MAX_PATH_STEPS);
+    motion->backend->sendPath(motion->backend->ctx, steps, count);
+  } else {
+    motionTick(motion);
+  }
+}
+
+/* runs a single tick and records it, the same way the application does. the
+ * simulated tick was due at "scheduledUs" of virtual time, and fired at
+ * "actualUs". */
+static void runRecordedTick(struct MotionState *motion, struct SimBackend *sim,
+                            struct TraceReader *replay, int interval,
+                            struct TelemetryRing *ring, long long scheduledUs,
+                            long long actualUs) {
+  const long long start = benchClockNs();
+  const unsigned long long queries = sim->cursorQueries;
+  const unsigned long long events = sim->moves + sim->pathSteps;
+  runTick(motion, replay, interval);
+
+  struct TelemetryRecord *rec = telemetryNext(ring);
+  rec->scheduledUs = scheduledUs;
+  rec->actualUs = actualUs;
+  /* the simulated system never refuses any input. */
+  rec->requested = rec->sent =
+      (uint16_t)(sim->moves + sim->pathSteps - events);
+  rec->x = sim->x;
+  rec->y = sim->y;
+  rec->flags = sim->cursorQueries != queries ? TELEMETRY_CURSOR_QUERIED : 0;
+  rec->reserved = 0;
+  rec->pathNs = (uint32_t)(benchClockNs() - start);
+  telemetryCommit(ring);
+}
+
+static void runLayout(const struct SimOptions *opts,
+                      const struct SimLayout *layout,
+                      struct TelemetryRing *telemetry,
+                      const struct SimTraces *traces) {
+  struct SimBackend sim;
+  memset(&sim, 0, sizeof(sim));
+  layoutInit(&sim.layout);
+  for (int i = 0; i < layout->count; ++i) {
+    const struct ScreenRect *rect = &layout->monitors[i];
+    layoutAddMonitor(&sim.layout, rect->left, rect->top, rect->right,
+                     rect->bottom);
+  }
+  /* the cursor starts in the middle of the primary monitor. */
+  sim.x = (layout->monitors[0].left + layout->monitors[0].right) / 2;
+  sim.y = (layout->monitors[0].top + layout->monitors[0].bottom) / 2;
+
+  const struct MotionBackend backend = {
+      &sim,          simGetCursorPos, simSendMove, simSendPath,
+      simSendMoveTo, simSendPathTo,   simSendWheel};
+  struct MotionState motion;
+  motionInit(&motion, &backend, opts->delta);
+  motionSetLayout(&motion, &sim.layout);
+  motion.smooth = opts->smooth;
+  motion.absolute = opts->absolute;
+  motion.reconcileEvery = opts->reconcileEvery;
+  motionSetDelta(&motion, opts->delta);
+  /* every layout replays the trace from its beginning. */
+  struct TraceReader *replay = traces->replay;
+  if (replay) {
+    replay->pos = replay->start;
+  }
+
+  /* virtual time only ever moves forward by whole intervals, which is exactly
+   * what a perfectly punctual timer would do. */
+  long long virtualMs = 0;
+  unsigned long long seed = 0x5eed;
+  const long long start = benchClockNs();
+  for (long long i = 0; i < opts->ticks; ++i) {
+    const int x = sim.x, y = sim.y;
+    if (telemetry) {
+      const long long due = virtualMs * 1000;
+      const long long latency =
+          simTickLatency(&seed, opts->latencyUs, opts->interval * 1000LL);
+      runRecordedTick(&motion, &sim, replay, opts->interval, telemetry, due,
+                      due + latency);
+    } else {
+      runTick(&motion, replay, opts->interval);
+    }
+    if (traces->record) {
+      traceWriterAdd(traces->record, (uint32_t)virtualMs, sim.x - x,
+                     sim.y - y);
+    }
+    virtualMs += opts->interval;
+  }
+  const long long elapsed = benchClockNs() - start;
+
+  const double secs = elapsed / 1e9;
+  printf("%-16s %12lld %10.1f %14.0f %9.2f %10.1f %8llu %9.3f  (%d,%d)\n",
+         layout->name, opts->ticks, elapsed / 1e6,
+         secs > 0 ? opts->ticks / secs : 0.0,
+         opts->ticks ? (double)elapsed / opts->ticks : 0.0,
+         virtualMs / 3600000.0, sim.clipped,
+         (double)sim.cursorQueries / opts->ticks, sim.x, sim.y);
+  if (sim.moves + sim.paths != (unsigned long long)opts->ticks) {
+    fprintf(stderr, "%s: expected %lld moves, got %llu\n", layout->name,
+            opts->ticks, sim.moves + sim.paths);
+  }
+  if (sim.paths) {
+    printf("%-16s %12.1f steps/path, %.2f ns/step\n", "",
+           (double)sim.pathSteps / sim.paths, (double)elapsed / sim.pathSteps);
+  }
+}
+
+static void writeTraceChunk(void *ctx, const void *data, size_t len) {
+  fwrite(data, 1, len, ctx);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--ticks N] [--interval MS] [--delta PX] "
+          "[--layout NAME] [--latency US] [--smooth]\n"
+          "          [--absolute] [--reconcile TICKS] [--telemetry NAME]\n"
+          "          [--replay FILE] [--record FILE --layout NAME]\n"
+          "layouts :",
+          argv0);
+  for (size_t i = 0; i < sizeof(simLayouts) / sizeof(simLayouts[0]); ++i) {
+    fprintf(stderr, " %s", simLayouts[i].name);
+  }
+  fprintf(stderr,
+          "\nwith --telemetry, every tick is also recorded into the shared "
+          "memory\n"
+          "called NAME, which is left behind for LaFlorStats to look at.\n"
+          "--replay moves the cursor along a recorded trace instead of "
+          "bouncing it,\n"
+          "while --record writes the simulated motion out as a trace.\n");
+}
+
+int main(int argc, char **argv) {
+  struct SimOptions opts = {
+      10000000, 1000, 1, 0, 2000, false, false, MOTION_DEFAULT_RECONCILE_EVERY,
+      0,        0,    0};
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *val = (i + 1 < argc) ? argv[i + 1] : 0;
+    if (strcmp(arg, "--smooth") == 0) {
+      opts.smooth = true;
+      continue;
+    }
+    if (strcmp(arg, "--absolute") == 0) {
+      opts.absolute = true;
+      continue;
+    }
+    if (val && strcmp(arg, "--ticks") == 0) {
+      opts.ticks = strtoll(val, 0, 10);
+    } else if (val && strcmp(arg, "--interval") == 0) {
+      opts.interval = atoi(val);
+    } else if (val && strcmp(arg, "--delta") == 0) {
+      opts.delta = atoi(val);
+    } else if (val && strcmp(arg, "--layout") == 0) {
+      opts.layout = val;
+    } else if (val && strcmp(arg, "--latency") == 0) {
+      opts.latencyUs = atoi(val);
+    } else if (val && strcmp(arg, "--reconcile") == 0) {
+      opts.reconcileEvery = atoi(val);
+    } else if (val && strcmp(arg, "--telemetry") == 0) {
+      opts.telemetry = val;
+    } else if (val && strcmp(arg, "--replay") == 0) {
+      opts.replay = val;
+    } else if (val && strcmp(arg, "--record") == 0) {
+      opts.record = val;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+    ++i;
+  }
+  if (opts.ticks <= 0 || opts.interval <= 0 || opts.delta <= 0 ||
+      opts.latencyUs < 0 || opts.reconcileEvery <= 0 ||
+      (opts.record && opts.layout == 0)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  struct SharedMem mem;
+  struct TelemetryRing ring;
+  struct TelemetryRing *telemetry = 0;
+  if (opts.telemetry) {
+    const size_t size = telemetrySize(TELEMETRY_DEFAULT_CAPACITY);
+    if (!sharedMemCreate(&mem, opts.telemetry, size) ||
+        !telemetryInit(&ring, mem.data, size, TELEMETRY_DEFAULT_CAPACITY)) {
+      fprintf(stderr, "%s: can't create the telemetry \"%s\"\n", argv[0],
+              opts.telemetry);
+      return 1;
+    }
+    telemetry = &ring;
+  }
+
+  struct SimTraces traces = {0, 0};
+  struct SharedMem replayMem;
+  struct TraceReader replay;
+  if (opts.replay) {
+    if (!sharedMemMapFile(&replayMem, opts.replay) ||
+        !traceReaderInit(&replay, replayMem.data, replayMem.size)) {
+      fprintf(stderr, "%s: \"%s\" isn't a trace\n", argv[0], opts.replay);
+      return 1;
+    }
+    traces.replay = &replay;
+    printf("replaying %zu bytes of trace\n\n", replayMem.size);
+  }
+  FILE *recordFile = 0;
+  struct TraceWriter record;
+  if (opts.record) {
+    recordFile = fopen(opts.record, "wb");
+    if (recordFile == 0) {
+      fprintf(stderr, "%s: can't create \"%s\"\n", argv[0], opts.record);
+      return 1;
+    }
+    traceWriterInit(&record, writeTraceChunk, recordFile);
+    traces.record = &record;
+  }
+
+  printf("%-16s %12s %10s %14s %9s %10s %8s %9s  %s\n", "layout", "ticks",
+         "wall ms", "ticks/s", "ns/tick", "virtual h", "clipped",
+         "queries/t", "final cursor");
+  int ran = 0;
+  for (size_t i = 0; i < sizeof(simLayouts) / sizeof(simLayouts[0]); ++i) {
+    if (opts.layout == 0 || strcmp(opts.layout, simLayouts[i].name) == 0) {
+      runLayout(&opts, &simLayouts[i], telemetry, &traces);
+      ran = 1;
+    }
+  }
+  if (!ran) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  printf("\n%-16s %12s %10s %10s %10s %8s %12s\n", "scheduling", "ticks",
+         "avg ms", "p99 ms", "max ms", "missed", "drift ms");
+  runScheduler(&opts);
+  if (telemetry) {
+    sharedMemClose(&mem);
+  }
+  if (traces.replay) {
+    sharedMemClose(&replayMem);
+  }
+  if (recordFile) {
+    traceWriterFinish(&record);
+    fclose(recordFile);
+  }
+  return 0;
+}
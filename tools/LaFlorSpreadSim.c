@@ -0,0 +1,220 @@
+/* simulates many instances of La Flor ticking on the same machine, such as one
+ * in every session of a terminal server, all with the same interval, and
+ * measures how evenly their wakeups are spread over time : the time is cut
+ * into buckets, and the busiest bucket is compared to the average one. a
+ * ratio of 1 is a perfectly even load, while a ratio equal to the number of
+ * buckets per interval means that every instance wakes up at once.
+ *
+ * the instances run the very same scheduler as the Windows application, the
+ * way it does outside of precise mode, in virtual time, with a little random
+ * latency on every wakeup. they're all started within "--start-ms" of each
+ * other, as happens when they all log on at once, or all reload the same
+ * configuration file. this is run without phase spreading, then with the
+ * consecutive session IDs that a terminal server hands out, and then with
+ * random ones. a last case ticks the way precise mode does, with random
+ * session IDs, and with one tick in ten postponed by half a period to three
+ * periods, as pausing while the user is active or a script's wait would : no
+ * tick should count as missed, nor come right after a postponed one :
+ *
+ *   ./build/LaFlorSpreadSim --instances 500 --interval 1000 --minutes 10 */
+
+#include "scheduler.h"
+#include "timerwheel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct SimInstance {
+  struct WheelTimer timer;
+  struct TickScheduler scheduler;
+  long long lastWakeupUs;
+};
+
+struct SpreadRun {
+  struct TimerWheel wheel;
+  struct SimInstance *instances;
+  int count;
+  long long periodUs;
+  int latencyUs;
+  uint32_t rng;
+  /* the wakeups counted in each bucket, from "startUs" on. */
+  unsigned *buckets;
+  long long bucketCount;
+  long long bucketUs;
+  long long startUs;
+  unsigned long long wakeups;
+  /* the longest and shortest times between two ticks of the same
+   * instance. */
+  long long maxGapUs;
+  long long minGapUs;
+  /* the percentage of the ticks which are postponed, in precise mode, or 0
+   * outside of it. */
+  int postponePercent;
+};
+
+static uint32_t rngNext(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static void onWakeup(void *ctx, struct WheelTimer *timer) {
+  struct SpreadRun *run = ctx;
+  struct SimInstance *instance = (struct SimInstance *)timer;
+  const long long nowUs = instance->scheduler.nextDeadlineUs +
+                          (run->latencyUs ? rngNext(&run->rng) %
+                                                (uint32_t)run->latencyUs
+                                          : 0);
+  const long long bucket = (nowUs - run->startUs) / run->bucketUs;
+  if (bucket >= 0 && bucket < run->bucketCount) {
+    ++run->buckets[bucket];
+    ++run->wakeups;
+    const long long gapUs = nowUs - instance->lastWakeupUs;
+    run->maxGapUs = gapUs > run->maxGapUs ? gapUs : run->maxGapUs;
+    run->minGapUs = gapUs < run->minGapUs ? gapUs : run->minGapUs;
+  }
+  instance->lastWakeupUs = nowUs;
+  schedulerOnFire(&instance->scheduler, nowUs);
+  if (run->postponePercent == 0) {
+    /* outside of precise mode, every tick starts a new series, just like
+     * SetTimer() would. */
+    schedulerStart(&instance->scheduler, nowUs, run->periodUs);
+  } else if ((int)(rngNext(&run->rng) % 100) < run->postponePercent) {
+    const long long delayUs =
+        run->periodUs / 2 +
+        rngNext(&run->rng) % (uint32_t)(run->periodUs * 5 / 2);
+    schedulerPostpone(&instance->scheduler, nowUs, delayUs);
+  }
+  wheelSchedule(&run->wheel, timer, instance->scheduler.nextDeadlineUs);
+}
+
+/* "seeds" is 0 without phase spreading, 1 for consecutive session IDs and 2
+ * for random ones. */
+static void runCase(struct SpreadRun *run, const char *name, int seeds,
+                    int postponePercent, int startMs, long long spanUs) {
+  /* the clock of the machine is nowhere near 0, nor on a round number. */
+  const long long originUs = 987654321;
+  uint32_t rng = 0x2545f491;
+  run->rng = 0x9e3779b9;
+  run->wakeups = 0;
+  run->maxGapUs = 0;
+  run->minGapUs = spanUs;
+  run->postponePercent = postponePercent;
+  /* the first couple of intervals aren't counted, since the instances all
+   * start with a partial interval. */
+  run->startUs = originUs + startMs * 1000LL + 2 * run->periodUs;
+  memset(run->buckets, 0, run->bucketCount * sizeof(*run->buckets));
+  wheelInit(&run->wheel, originUs, 1000);
+  for (int i = 0; i < run->count; ++i) {
+    struct SimInstance *instance = &run->instances[i];
+    const long long startUs =
+        originUs + (startMs ? rngNext(&rng) % (startMs * 1000u) : 0);
+    schedulerInit(&instance->scheduler);
+    if (seeds) {
+      schedulerSetSpread(&instance->scheduler, true,
+                         seeds == 1 ? (uint32_t)i + 1 : rngNext(&rng));
+    }
+    schedulerStart(&instance->scheduler, startUs, run->periodUs);
+    instance->lastWakeupUs = startUs;
+    wheelTimerInit(&instance->timer, onWakeup, run);
+    wheelSchedule(&run->wheel, &instance->timer,
+                  instance->scheduler.nextDeadlineUs);
+  }
+  const long long endUs = run->startUs + spanUs;
+  for (;;) {
+    const long long deadlineUs = wheelNextDeadlineUs(&run->wheel);
+    if (deadlineUs < 0 || deadlineUs >= endUs) {
+      break;
+    }
+    wheelAdvance(&run->wheel, deadlineUs);
+  }
+
+  unsigned peak = 0;
+  for (long long i = 0; i < run->bucketCount; ++i) {
+    peak = run->buckets[i] > peak ? run->buckets[i] : peak;
+  }
+  long long missed = 0;
+  for (int i = 0; i < run->count; ++i) {
+    missed += run->instances[i].scheduler.stats.missed;
+  }
+  const double mean = (double)run->wakeups / run->bucketCount;
+  printf("%-12s %12llu %8u %10.2f %10.1f %10.1f %10.1f %8lld\n", name,
+         run->wakeups, peak, mean, mean > 0 ? peak / mean : 0.0,
+         100.0 * run->minGapUs / run->periodUs,
+         100.0 * run->maxGapUs / run->periodUs, missed);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--instances N] [--interval MS] [--minutes M] "
+          "[--bucket-ms MS]\n"
+          "          [--start-ms MS] [--latency US]\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  int count = 500;
+  int interval = 1000;
+  int minutes = 10;
+  int bucketMs = 10;
+  int startMs = 0;
+  int latencyUs = 500;
+  for (int i = 1; i < argc; i += 2) {
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    const int value = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "--instances") == 0) {
+      count = value;
+    } else if (strcmp(argv[i], "--interval") == 0) {
+      interval = value;
+    } else if (strcmp(argv[i], "--minutes") == 0) {
+      minutes = value;
+    } else if (strcmp(argv[i], "--bucket-ms") == 0) {
+      bucketMs = value;
+    } else if (strcmp(argv[i], "--start-ms") == 0) {
+      startMs = value;
+    } else if (strcmp(argv[i], "--latency") == 0) {
+      latencyUs = value;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (count <= 0 || interval <= 0 || minutes <= 0 || bucketMs <= 0 ||
+      startMs < 0 || latencyUs < 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  struct SpreadRun run;
+  memset(&run, 0, sizeof(run));
+  run.count = count;
+  run.periodUs = interval * 1000LL;
+  run.latencyUs = latencyUs;
+  run.bucketUs = bucketMs * 1000LL;
+  const long long spanUs = minutes * 60000000LL;
+  run.bucketCount = spanUs / run.bucketUs;
+  run.instances = malloc(count * sizeof(*run.instances));
+  run.buckets = malloc(run.bucketCount * sizeof(*run.buckets));
+  if (run.instances == 0 || run.buckets == 0) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  printf("%d instances ticking every %d ms, started within %d ms, %d "
+         "minute(s) in %d ms buckets\n\n",
+         count, interval, startMs, minutes, bucketMs);
+  printf("%-12s %12s %8s %10s %10s %10s %10s %8s\n", "spreading", "wakeups",
+         "peak", "mean", "peak/mean", "min gap %", "max gap %", "missed");
+  runCase(&run, "off", 0, 0, startMs, spanUs);
+  runCase(&run, "sessions", 1, 0, startMs, spanUs);
+  runCase(&run, "random", 2, 0, startMs, spanUs);
+  runCase(&run, "postponed", 2, 10, startMs, spanUs);
+  free(run.buckets);
+  free(run.instances);
+  return 0;
+}
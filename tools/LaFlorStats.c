@@ -0,0 +1,175 @@
+/* attaches to the telemetry exported by a running La Flor (or by the simulator
+ * with --telemetry) and prints what the ticks have been doing : how late they
+ * were, how long the tick path took, and how much of the injected input the
+ * system actually accepted. the records are read straight from the shared
+ * memory, and the producer never waits for this tool : if it doesn't keep up,
+ * it just reports the records it lost. */
+
+#include "sharedmem.h"
+#include "telemetry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+static void sleepMs(int ms) { Sleep(ms); }
+#else
+#include <time.h>
+
+static void sleepMs(int ms) {
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+  nanosleep(&ts, 0);
+}
+#endif
+
+/* counters accumulated over the whole run of the tool. */
+struct StatsTotals {
+  unsigned long long records;
+  unsigned long long lost;
+  unsigned long long postponed;
+  unsigned long long cursorQueries;
+  /* ticks for which the system inserted fewer events than we asked for. */
+  unsigned long long failed;
+};
+
+static int compareLongLong(const void *a, const void *b) {
+  const long long x = *(const long long *)a;
+  const long long y = *(const long long *)b;
+  return (x > y) - (x < y);
+}
+
+/* the value below which the given percentile (0-1000, i.e. in tenths of a
+ * percent) of the sorted values lie. */
+static long long percentile(const long long *sorted, uint32_t count,
+                            int perMille) {
+  const uint32_t idx = (uint32_t)(((unsigned long long)count * perMille + 999) /
+                                   1000);
+  return sorted[idx == 0 ? 0 : idx - 1];
+}
+
+/* prints a single line about a batch of records, and adds them to the
+ * totals. "scratch" must have room for "count" values. */
+static void reportBatch(const struct TelemetryRecord *records, uint32_t count,
+                        long long *scratch, struct StatsTotals *totals) {
+  unsigned long long pathSumNs = 0;
+  uint32_t pathMaxNs = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    const struct TelemetryRecord *rec = &records[i];
+    /* ticks are allowed to fire a tiny bit early : these count as on time,
+     * just like in the application's own statistics. */
+    const long long jitter = rec->actualUs - rec->scheduledUs;
+    scratch[i] = jitter > 0 ? jitter : 0;
+    pathSumNs += rec->pathNs;
+    if (rec->pathNs > pathMaxNs) {
+      pathMaxNs = rec->pathNs;
+    }
+    totals->postponed += (rec->flags & TELEMETRY_POSTPONED) != 0;
+    totals->cursorQueries += (rec->flags & TELEMETRY_CURSOR_QUERIED) != 0;
+    totals->failed += rec->sent < rec->requested;
+  }
+  totals->records += count;
+
+  if (count == 0) {
+    printf("%8s %9s %9s %9s %9s %9s %9s %9s | %10llu %8llu %9llu %8llu\n", "-",
+           "-", "-", "-", "-", "-", "-", "-", totals->records, totals->lost,
+           totals->postponed, totals->failed);
+    return;
+  }
+  qsort(scratch, count, sizeof(*scratch), compareLongLong);
+  const struct TelemetryRecord *last = &records[count - 1];
+  printf("%8u %9.3f %9.3f %9.3f %9.3f %9.3f %9.2f %9.2f | %10llu %8llu %9llu "
+         "%8llu  (%d,%d)\n",
+         count, percentile(scratch, count, 500) / 1000.0,
+         percentile(scratch, count, 900) / 1000.0,
+         percentile(scratch, count, 990) / 1000.0,
+         percentile(scratch, count, 999) / 1000.0,
+         scratch[count - 1] / 1000.0, (double)pathSumNs / count / 1000.0,
+         pathMaxNs / 1000.0, totals->records, totals->lost, totals->postponed,
+         totals->failed, last->x, last->y);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--name NAME] [--refresh MS] [--once]\n"
+          "prints the jitter percentiles (in ms) and tick path times (in us)\n"
+          "of the ticks recorded since the previous line, followed by running\n"
+          "totals.\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  const char *name = TELEMETRY_NAME;
+  int refreshMs = 1000;
+  int once = 0;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *val = (i + 1 < argc) ? argv[i + 1] : 0;
+    if (strcmp(arg, "--once") == 0) {
+      once = 1;
+      continue;
+    }
+    if (val && strcmp(arg, "--name") == 0) {
+      name = val;
+    } else if (val && strcmp(arg, "--refresh") == 0) {
+      refreshMs = atoi(val);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+    ++i;
+  }
+  if (refreshMs <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  struct SharedMem mem;
+  if (!sharedMemOpen(&mem, name)) {
+    fprintf(stderr,
+            "%s: can't open the telemetry \"%s\", is La Flor running?\n",
+            argv[0], name);
+    return 1;
+  }
+  struct TelemetryRing ring;
+  if (!telemetryAttach(&ring, mem.data, mem.size)) {
+    fprintf(stderr, "%s: \"%s\" doesn't contain any telemetry we understand\n",
+            argv[0], name);
+    sharedMemClose(&mem);
+    return 1;
+  }
+
+  /* the buffers are allocated once, big enough for a whole ring, which is the
+   * most that a single read can ever return. */
+  const uint32_t capacity = ring.mask + 1;
+  struct TelemetryRecord *records = malloc(capacity * sizeof(*records));
+  long long *scratch = malloc(capacity * sizeof(*scratch));
+  if (records == 0 || scratch == 0) {
+    fprintf(stderr, "%s: out of memory\n", argv[0]);
+    return 1;
+  }
+
+  printf("%8s %9s %9s %9s %9s %9s %9s %9s | %10s %8s %9s %8s  %s\n", "ticks",
+         "p50 ms", "p90 ms", "p99 ms", "p99.9 ms", "max ms", "avg us",
+         "max us", "total", "lost", "postponed", "failed", "cursor");
+  /* the first line covers everything that's still in the ring. */
+  struct StatsTotals totals;
+  memset(&totals, 0, sizeof(totals));
+  uint32_t cursor = telemetryOldest(&ring);
+  for (;;) {
+    const uint32_t count =
+        telemetryRead(&ring, &cursor, records, capacity, &totals.lost);
+    reportBatch(records, count, scratch, &totals);
+    fflush(stdout);
+    if (once) {
+      break;
+    }
+    sleepMs(refreshMs);
+  }
+
+  printf("%llu cursor queries\n", totals.cursorQueries);
+  free(scratch);
+  free(records);
+  sharedMemClose(&mem);
+  return 0;
+}
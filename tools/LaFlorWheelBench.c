@@ -0,0 +1,215 @@
+/* measures what the timer wheel costs with thousands of periodic actions, and
+ * how many times the thread driving them wakes up. each action has its own
+ * period, between 50ms and 7 minutes, and schedules itself again whenever it
+ * fires. the thread sleeps until the earliest deadline and then advances the
+ * wheel, just like the injection thread does, in virtual time : the figures
+ * are those of the wheel alone.
+ *
+ * the same actions are also run off a plain array which is scanned for the
+ * earliest deadline on every wakeup, as a reference, and once with some slack
+ * allowed on every wakeup, the way coalescable timers do it :
+ *
+ *   ./build/LaFlorWheelBench --timers 5000 --minutes 10 */
+
+#include "benchclock.h"
+#include "timerwheel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct BenchAction {
+  struct WheelTimer timer;
+  long long periodUs;
+  long long deadlineUs;
+  unsigned long fired;
+};
+
+struct BenchRun {
+  struct TimerWheel wheel;
+  struct BenchAction *actions;
+  int count;
+  long long nowUs;
+  unsigned long long fired;
+  /* how late the actions fired, in total. */
+  long long latenessUs;
+};
+
+static uint32_t rngNext(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+/* the periods are spread evenly on a logarithmic scale, which is closer to
+ * what a mix of quick nudges and slow housekeeping looks like than an even
+ * spread would be. */
+static long long randomPeriodUs(uint32_t *rng) {
+  long long periodUs = 50000;
+  const uint32_t doublings = rngNext(rng) % 13;
+  for (uint32_t i = 0; i < doublings; ++i) {
+    periodUs *= 2;
+  }
+  return periodUs + rngNext(rng) % periodUs;
+}
+
+static void onFire(void *ctx, struct WheelTimer *timer) {
+  struct BenchRun *run = ctx;
+  struct BenchAction *action = (struct BenchAction *)timer;
+  ++action->fired;
+  ++run->fired;
+  run->latenessUs += run->nowUs - action->deadlineUs;
+  action->deadlineUs += action->periodUs;
+  wheelSchedule(&run->wheel, timer, action->deadlineUs);
+}
+
+static void initActions(struct BenchRun *run, int count, bool wheel) {
+  uint32_t rng = 0x2545f491;
+  memset(run->actions, 0, count * sizeof(*run->actions));
+  run->count = count;
+  run->nowUs = 0;
+  run->fired = 0;
+  run->latenessUs = 0;
+  wheelInit(&run->wheel, 0, 1000);
+  for (int i = 0; i < count; ++i) {
+    struct BenchAction *action = &run->actions[i];
+    action->periodUs = randomPeriodUs(&rng);
+    /* the phases are spread as well, rather than having every action start
+     * at once. */
+    action->deadlineUs = rngNext(&rng) % action->periodUs;
+    wheelTimerInit(&action->timer, onFire, run);
+    if (wheel) {
+      wheelSchedule(&run->wheel, &action->timer, action->deadlineUs);
+    }
+  }
+}
+
+static void printRow(const char *name, const struct BenchRun *run,
+                     long long elapsedNs, unsigned long wakeups,
+                     double hours) {
+  printf("%-10s %10.1f %10.1f %12.0f %12.0f %10.2f\n", name,
+         (double)elapsedNs / wakeups, (double)elapsedNs / run->fired,
+         run->fired / hours, wakeups / hours,
+         (double)run->latenessUs / run->fired / 1000.0);
+}
+
+static void runWheel(struct BenchRun *run, int count, long long endUs,
+                     long long slackUs, double hours) {
+  initActions(run, count, true);
+  unsigned long wakeups = 0;
+  const long long start = benchClockNs();
+  for (;;) {
+    const long long deadlineUs = wheelNextDeadlineUs(&run->wheel);
+    if (deadlineUs < 0 || deadlineUs + slackUs > endUs) {
+      break;
+    }
+    run->nowUs = deadlineUs + slackUs;
+    wheelAdvance(&run->wheel, run->nowUs);
+    ++wakeups;
+  }
+  const long long elapsed = benchClockNs() - start;
+  char name[32];
+  if (slackUs) {
+    snprintf(name, sizeof(name), "wheel+%lldms", slackUs / 1000);
+  } else {
+    snprintf(name, sizeof(name), "wheel");
+  }
+  printRow(name, run, elapsed, wakeups, hours);
+}
+
+static void runScan(struct BenchRun *run, int count, long long endUs,
+                    double hours) {
+  initActions(run, count, false);
+  unsigned long wakeups = 0;
+  const long long start = benchClockNs();
+  for (;;) {
+    long long deadlineUs = -1;
+    for (int i = 0; i < count; ++i) {
+      const long long d = run->actions[i].deadlineUs;
+      deadlineUs = deadlineUs < 0 || d < deadlineUs ? d : deadlineUs;
+    }
+    if (deadlineUs < 0 || deadlineUs > endUs) {
+      break;
+    }
+    run->nowUs = deadlineUs;
+    for (int i = 0; i < count; ++i) {
+      struct BenchAction *action = &run->actions[i];
+      if (action->deadlineUs <= run->nowUs) {
+        ++action->fired;
+        ++run->fired;
+        action->deadlineUs += action->periodUs;
+      }
+    }
+    ++wakeups;
+  }
+  printRow("scan", run, benchClockNs() - start, wakeups, hours);
+}
+
+/* scheduling and cancelling, on their own, with the wheel already holding
+ * "count" timers. */
+static void runScheduleCancel(struct BenchRun *run, int count, long ops) {
+  initActions(run, count, true);
+  struct WheelTimer extra;
+  wheelTimerInit(&extra, onFire, run);
+  uint32_t rng = 0x9e3779b9;
+  const long long start = benchClockNs();
+  for (long i = 0; i < ops; ++i) {
+    wheelSchedule(&run->wheel, &extra, randomPeriodUs(&rng));
+    wheelCancel(&run->wheel, &extra);
+  }
+  const long long elapsed = benchClockNs() - start;
+  printf("schedule + cancel : %.1f ns, with %d timers in the wheel\n",
+         (double)elapsed / ops, count);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--timers N] [--minutes M]\n", argv0);
+}
+
+int main(int argc, char **argv) {
+  int count = 5000;
+  int minutes = 1;
+  for (int i = 1; i < argc; i += 2) {
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    if (strcmp(argv[i], "--timers") == 0) {
+      count = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--minutes") == 0) {
+      minutes = atoi(argv[i + 1]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (count <= 0 || minutes <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  struct BenchRun *run = malloc(sizeof(*run));
+  if (run) {
+    run->actions = malloc(count * sizeof(*run->actions));
+  }
+  if (run == 0 || run->actions == 0) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  const long long endUs = minutes * 60000000LL;
+  const double hours = minutes / 60.0;
+  printf("%d actions, %d minute(s) of virtual time\n\n", count, minutes);
+  printf("%-10s %10s %10s %12s %12s %10s\n", "driver", "ns/wakeup",
+         "ns/fire", "fires/h", "wakeups/h", "late ms");
+  runWheel(run, count, endUs, 0, hours);
+  runWheel(run, count, endUs, 1000, hours);
+  runWheel(run, count, endUs, 50000, hours);
+  runScan(run, count, endUs, hours);
+  printf("\n");
+  runScheduleCancel(run, count, 10000000);
+  free(run->actions);
+  free(run);
+  return 0;
+}
@@ -0,0 +1,112 @@
+/* measures how fast the X11 backend injects input, against a real X server :
+ * the ticks run back to back, for each kind of motion, once with every tick
+ * queued and flushed at once, the way LaFlorX11 does it, and once waiting for
+ * the server after every event. it reports the events injected per second and
+ * the round trips to the server per tick. in absolute mode, where the engine
+ * knows where the cursor should end up, the real position is checked at the
+ * end, and the exit status is nonzero if it's not right.
+ *
+ * it's meant to be run against a virtual X server, see tools/x11-bench.sh :
+ *
+ *   tools/x11-bench.sh --ticks 10000 */
+
+#include "benchclock.h"
+#include "motion.h"
+#include "x11backend.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct BenchCase {
+  const char *name;
+  bool smooth;
+  bool absolute;
+};
+
+static const struct BenchCase cases[] = {{"bounce", false, false},
+                                         {"smooth", true, false},
+                                         {"abs", false, true},
+                                         {"abs-smooth", true, true}};
+
+static bool runCase(struct X11Backend *x11, const struct ScreenLayout *layout,
+                    const struct BenchCase *bench, bool syncEachEvent,
+                    long ticks) {
+  struct MotionBackend backend;
+  x11InitMotionBackend(&backend, x11);
+  struct MotionState motion;
+  motionInit(&motion, &backend, 5);
+  motionSetLayout(&motion, layout);
+  motion.smooth = bench->smooth;
+  motion.absolute = bench->absolute;
+  x11->syncEachEvent = syncEachEvent;
+  x11->events = x11->roundTrips = x11->flushes = 0;
+
+  const long long start = benchClockNs();
+  for (long t = 0; t < ticks; ++t) {
+    x11BeginTick(x11);
+    motionTick(&motion);
+    x11EndTick(x11);
+  }
+  /* the time only counts once the server has handled every event. */
+  XSync(x11->display, False);
+  ++x11->roundTrips;
+  const long long elapsed = benchClockNs() - start;
+
+  bool ok = true;
+  if (bench->absolute) {
+    x11BeginTick(x11);
+    int x, y;
+    backend.getCursorPos(x11, &x, &y);
+    ok = x == motion.x && y == motion.y;
+  }
+  printf("%-10s %-8s %12.0f %12.2f %10.1f  %s\n", bench->name,
+         syncEachEvent ? "sync" : "batched", x11->events * 1e9 / elapsed,
+         (double)x11->roundTrips / ticks, (double)elapsed / ticks / 1000.0,
+         bench->absolute ? (ok ? "ok" : "WRONG") : "-");
+  return ok;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--ticks N] [--display NAME]\n", argv0);
+}
+
+int main(int argc, char **argv) {
+  long ticks = 10000;
+  const char *display = 0;
+  for (int i = 1; i < argc; i += 2) {
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    if (strcmp(argv[i], "--ticks") == 0) {
+      ticks = atol(argv[i + 1]);
+    } else if (strcmp(argv[i], "--display") == 0) {
+      display = argv[i + 1];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (ticks <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  struct X11Backend x11;
+  if (!x11Open(&x11, display)) {
+    return 1;
+  }
+  struct ScreenLayout layout;
+  x11QueryLayout(&x11, &layout);
+  printf("%d monitor(s), %ld ticks per run\n\n", layout.count, ticks);
+  printf("%-10s %-8s %12s %12s %10s  %s\n", "motion", "mode", "events/s",
+         "trips/tick", "us/tick", "cursor");
+  bool ok = true;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    ok &= runCase(&x11, &layout, &cases[i], false, ticks);
+    ok &= runCase(&x11, &layout, &cases[i], true, ticks);
+  }
+  x11Close(&x11);
+  return ok ? 0 : 1;
+}
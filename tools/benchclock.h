@@ -0,0 +1,33 @@
+#ifndef LAFLOR_BENCHCLOCK_H
+#define LAFLOR_BENCHCLOCK_H
+
+/* a monotonic wall clock with nanosecond resolution, used by the benchmark and
+ * simulator tools to measure how long the code under test actually took to
+ * run. it is deliberately kept out of the engine itself, which only ever deals
+ * with virtual time handed to it by its caller. */
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+static long long benchClockNs(void) {
+  LARGE_INTEGER freq, now;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  /* split into whole seconds and the remainder in order not to overflow the
+   * multiplication for large counter values. */
+  const long long secs = now.QuadPart / freq.QuadPart;
+  const long long rem = now.QuadPart % freq.QuadPart;
+  return secs * 1000000000LL + rem * 1000000000LL / freq.QuadPart;
+}
+#else
+#include <time.h>
+
+static long long benchClockNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+#endif
+
+#endif
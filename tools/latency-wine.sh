@@ -0,0 +1,25 @@
+#!/bin/sh
+# cross-builds LaFlorLatency with MinGW-w64 and runs it under Wine, on a
+# virtual X server, so that injection latency can be checked on a Linux box
+# without any Windows around. needs cmake, the MinGW-w64 cross compiler, wine
+# and xvfb-run. the arguments are passed on to LaFlorLatency, e.g.
+#
+#   tools/latency-wine.sh --ticks 100 --max-p99-us 5000
+#
+# and the exit status is LaFlorLatency's, which makes it usable as a check.
+# BUILD_DIR, WINE and WINEPREFIX can be set in order to override the
+# defaults.
+set -e
+
+src=$(cd "$(dirname "$0")/.." && pwd)
+build=${BUILD_DIR:-$src/_mingw_build}
+
+cmake -S "$src" -B "$build" -DCMAKE_BUILD_TYPE=Release \
+  -DCMAKE_TOOLCHAIN_FILE="$src/cmake/mingw-w64.cmake"
+cmake --build "$build" --target LaFlorLatency
+
+# a prefix of its own keeps the benchmark away from any other Wine setup, and
+# the debug channels only add noise.
+export WINEPREFIX="${WINEPREFIX:-$build/wineprefix}"
+export WINEDEBUG=-all
+exec xvfb-run -a "${WINE:-wine}" "$build/LaFlorLatency.exe" "$@"
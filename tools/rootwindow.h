@@ -0,0 +1,40 @@
+#ifndef LAFLOR_ROOTWINDOW_H
+#define LAFLOR_ROOTWINDOW_H
+
+/* finding and closing the root window of a La Flor process started by one of
+ * the Windows tools, which is how they make it quit cleanly. */
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include "control.h"
+
+#include <stdio.h>
+
+static HWND findRootWindow(DWORD pid) {
+  HWND wnd = 0;
+  while ((wnd = FindWindowExW(0, wnd, CONTROL_WINDOW_CLASS, 0)) != 0) {
+    DWORD wndPid;
+    GetWindowThreadProcessId(wnd, &wndPid);
+    if (wndPid == pid) {
+      return wnd;
+    }
+  }
+  return 0;
+}
+
+/* asks La Flor to quit, the way the "Exit" menu item does, and terminates it
+ * if it didn't within a few seconds. the handles are left open. */
+static void quitLaFlor(const PROCESS_INFORMATION *pi) {
+  HWND wnd = findRootWindow(pi->dwProcessId);
+  if (wnd) {
+    PostMessageW(wnd, WM_CLOSE, 0, 0);
+  }
+  if (WaitForSingleObject(pi->hProcess, 5000) != WAIT_OBJECT_0) {
+    fprintf(stderr, "La Flor didn't quit, terminating it\n");
+    TerminateProcess(pi->hProcess, 1);
+    WaitForSingleObject(pi->hProcess, INFINITE);
+  }
+}
+
+#endif
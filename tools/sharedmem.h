@@ -0,0 +1,165 @@
+#ifndef LAFLOR_SHAREDMEM_H
+#define LAFLOR_SHAREDMEM_H
+
+/* named shared memory for the tools, used to attach to the telemetry exported
+ * by the application, or to export the simulator's own. on Windows, this is a
+ * named file mapping in the session's "Local\" namespace, which is where the
+ * application creates its own. elsewhere, it's a POSIX shared memory object,
+ * which on Linux shows up in /dev/shm. plain files, such as motion traces, can
+ * be mapped as well. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct SharedMem {
+  void *data;
+  size_t size;
+#ifdef _WIN32
+  HANDLE mapping;
+#endif
+};
+
+static inline void sharedMemName(char *buf, size_t bufLen, const char *name) {
+#ifdef _WIN32
+  snprintf(buf, bufLen, "Local\\%s", name);
+#else
+  snprintf(buf, bufLen, "/%s", name);
+#endif
+}
+
+/* creates the shared memory, or reuses it if it already exists. */
+static inline bool sharedMemCreate(struct SharedMem *mem, const char *name,
+                                   size_t size) {
+  char fullName[256];
+  sharedMemName(fullName, sizeof(fullName), name);
+  mem->size = size;
+#ifdef _WIN32
+  mem->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, 0,
+                                    (DWORD)size, fullName);
+  if (mem->mapping == 0) {
+    return false;
+  }
+  mem->data = MapViewOfFile(mem->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  if (mem->data == 0) {
+    CloseHandle(mem->mapping);
+    return false;
+  }
+  return true;
+#else
+  const int fd = shm_open(fullName, O_RDWR | O_CREAT, 0600);
+  if (fd == -1) {
+    return false;
+  }
+  if (ftruncate(fd, (off_t)size) != 0) {
+    close(fd);
+    return false;
+  }
+  mem->data = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  return mem->data != MAP_FAILED;
+#endif
+}
+
+static inline void sharedMemClose(struct SharedMem *mem) {
+#ifdef _WIN32
+  UnmapViewOfFile(mem->data);
+  CloseHandle(mem->mapping);
+#else
+  munmap(mem->data, mem->size);
+#endif
+}
+
+/* opens existing shared memory, as a whole. the memory is mapped read-only :
+ * readers have no business writing to it. */
+static inline bool sharedMemOpen(struct SharedMem *mem, const char *name) {
+  char fullName[256];
+  sharedMemName(fullName, sizeof(fullName), name);
+#ifdef _WIN32
+  mem->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, fullName);
+  if (mem->mapping == 0) {
+    return false;
+  }
+  mem->data = MapViewOfFile(mem->mapping, FILE_MAP_READ, 0, 0, 0);
+  if (mem->data == 0) {
+    CloseHandle(mem->mapping);
+    return false;
+  }
+  MEMORY_BASIC_INFORMATION info;
+  if (VirtualQuery(mem->data, &info, sizeof(info)) == 0) {
+    sharedMemClose(mem);
+    return false;
+  }
+  /* this is rounded up to whole pages, which is fine : the contents tell how
+   * much of it is actually used. */
+  mem->size = info.RegionSize;
+  return true;
+#else
+  const int fd = shm_open(fullName, O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  mem->size = (size_t)st.st_size;
+  mem->data = mmap(0, mem->size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  return mem->data != MAP_FAILED;
+#endif
+}
+
+/* maps a whole existing file, read-only. the mapping is released with
+ * sharedMemClose(), just like named shared memory. */
+static inline bool sharedMemMapFile(struct SharedMem *mem, const char *path) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0,
+                            OPEN_EXISTING, 0, 0);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  /* the mapping keeps the file open by itself. */
+  mem->size = GetFileSize(file, 0);
+  mem->mapping = mem->size == 0 || mem->size == INVALID_FILE_SIZE
+                     ? 0
+                     : CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+  CloseHandle(file);
+  if (mem->mapping == 0) {
+    return false;
+  }
+  mem->data = MapViewOfFile(mem->mapping, FILE_MAP_READ, 0, 0, 0);
+  if (mem->data == 0) {
+    CloseHandle(mem->mapping);
+    return false;
+  }
+  return true;
+#else
+  const int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  mem->size = (size_t)st.st_size;
+  mem->data = mmap(0, mem->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return mem->data != MAP_FAILED;
+#endif
+}
+
+#endif
@@ -0,0 +1,20 @@
+#!/bin/sh
+# builds LaFlorX11Bench and runs it on a virtual X server, so that the X11
+# backend can be measured without any desktop around. needs cmake, the
+# development files of Xlib, XTest and RandR, and xvfb-run. the arguments are
+# passed on to LaFlorX11Bench, e.g.
+#
+#   tools/x11-bench.sh --ticks 10000
+#
+# and the exit status is LaFlorX11Bench's, which makes it usable as a check.
+# BUILD_DIR and SCREEN can be set in order to override the defaults.
+set -e
+
+src=$(cd "$(dirname "$0")/.." && pwd)
+build=${BUILD_DIR:-$src/_x11_build}
+
+cmake -S "$src" -B "$build" -DCMAKE_BUILD_TYPE=Release -DLAFLOR_X11=ON
+cmake --build "$build" --target LaFlorX11Bench
+
+exec xvfb-run -a -s "-screen 0 ${SCREEN:-1920x1080x24}" \
+  "$build/LaFlorX11Bench" "$@"
@@ -0,0 +1,45 @@
+#!/bin/sh
+# builds LaFlorX11 and runs a single copy of it against more and more virtual
+# X servers at once, in order to see what each display costs : the memory
+# that LaFlorX11 keeps resident per display, and its CPU time per 1000 ticks.
+# needs cmake, the development files of Xlib, XTest and RandR, and Xvfb.
+#
+#   tools/x11-daemon-bench.sh
+#
+# COUNTS (default "1 2 4 8 16"), DURATION (in seconds, default 10), INTERVAL
+# (in ms, default 20), FIRST_DISPLAY (default 100), BUILD_DIR and SCREEN can be
+# set in order to override the defaults. the default BUILD_DIR is _x11_build,
+# which is shared with tools/x11-bench.sh, and ignored by git.
+set -e
+
+src=$(cd "$(dirname "$0")/.." && pwd)
+build=${BUILD_DIR:-$src/_x11_build}
+first=${FIRST_DISPLAY:-100}
+
+cmake -S "$src" -B "$build" -DCMAKE_BUILD_TYPE=Release -DLAFLOR_X11=ON
+cmake --build "$build" --target LaFlorX11
+
+pids=
+cleanup() {
+  [ -z "$pids" ] || kill $pids 2>/dev/null || true
+  pids=
+}
+trap cleanup EXIT INT TERM
+
+for n in ${COUNTS:-1 2 4 8 16}; do
+  args=
+  i=0
+  while [ $i -lt "$n" ]; do
+    Xvfb ":$((first + i))" -screen 0 "${SCREEN:-1920x1080x24}" -nolisten tcp \
+      >/dev/null 2>&1 &
+    pids="$pids $!"
+    args="$args --display :$((first + i))"
+    i=$((i + 1))
+  done
+  # the servers need a moment before they accept connections.
+  sleep 1
+  "$build/LaFlorX11" --seconds "${DURATION:-10}" --interval "${INTERVAL:-20}" \
+    $args
+  cleanup
+  wait 2>/dev/null || true
+done
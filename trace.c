@@ -0,0 +1,185 @@
+#include "trace.h"
+
+#include <string.h>
+
+static size_t encodeVarint(unsigned char *out, uint32_t val) {
+  size_t len = 0;
+  while (val >= 0x80) {
+    out[len++] = (unsigned char)(val | 0x80);
+    val >>= 7;
+  }
+  out[len++] = (unsigned char)val;
+  return len;
+}
+
+/* maps signed values to unsigned ones so that values close to 0, whatever
+ * their sign, are encoded in few bytes : 0, -1, 1, -2, 2... become 0, 1, 2,
+ * 3, 4... */
+static uint32_t zigzag(int val) {
+  return ((uint32_t)val << 1) ^ (uint32_t)(val < 0 ? -1 : 0);
+}
+
+static int unzigzag(uint32_t val) {
+  return (int)(val >> 1) ^ -(int)(val & 1);
+}
+
+size_t traceEncode(unsigned char *out, const struct TraceRecord *rec) {
+  size_t len = encodeVarint(out, rec->dtMs);
+  len += encodeVarint(out + len, zigzag(rec->dx));
+  len += encodeVarint(out + len, zigzag(rec->dy));
+  return len;
+}
+
+/* decodes a variable length integer, without reading past "end". returns
+ * false if it's truncated or longer than 32 bits can hold. */
+static bool decodeVarint(const unsigned char **pos, const unsigned char *end,
+                         uint32_t *val) {
+  uint32_t rv = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (*pos == end) {
+      return false;
+    }
+    const unsigned char byte = *(*pos)++;
+    rv |= (uint32_t)(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      *val = rv;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool decodeRecord(const unsigned char **pos, const unsigned char *end,
+                         struct TraceRecord *rec) {
+  uint32_t dx, dy;
+  if (!decodeVarint(pos, end, &rec->dtMs) || !decodeVarint(pos, end, &dx) ||
+      !decodeVarint(pos, end, &dy)) {
+    return false;
+  }
+  rec->dx = unzigzag(dx);
+  rec->dy = unzigzag(dy);
+  return true;
+}
+
+/* the same as decodeRecord(), for records which have already been checked by
+ * traceReaderInit(). this is what runs on the tick path. */
+static void decodeChecked(const unsigned char **pos, struct TraceRecord *rec) {
+  uint32_t vals[3];
+  for (int i = 0; i < 3; ++i) {
+    uint32_t val = 0;
+    int shift = 0;
+    unsigned char byte;
+    do {
+      byte = *(*pos)++;
+      val |= (uint32_t)(byte & 0x7f) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    vals[i] = val;
+  }
+  rec->dtMs = vals[0];
+  rec->dx = unzigzag(vals[1]);
+  rec->dy = unzigzag(vals[2]);
+}
+
+void traceWriterInit(struct TraceWriter *writer,
+                     void (*flush)(void *ctx, const void *data, size_t len),
+                     void *ctx) {
+  memset(writer, 0, sizeof(*writer));
+  writer->flush = flush;
+  writer->ctx = ctx;
+  memcpy(writer->buf, TRACE_MAGIC, 4);
+  writer->buf[4] = TRACE_VERSION;
+  writer->len = TRACE_HEADER_SIZE;
+}
+
+static void writePending(struct TraceWriter *writer) {
+  if (sizeof(writer->buf) - writer->len < TRACE_MAX_RECORD_SIZE) {
+    writer->flush(writer->ctx, writer->buf, writer->len);
+    writer->len = 0;
+  }
+  /* the very first record doesn't have anything to be relative to. */
+  struct TraceRecord rec;
+  rec.dtMs = writer->started ? writer->pendingMs - writer->lastMs : 0;
+  rec.dx = writer->pendingDx;
+  rec.dy = writer->pendingDy;
+  writer->len += traceEncode(writer->buf + writer->len, &rec);
+  writer->started = true;
+  writer->lastMs = writer->pendingMs;
+  writer->pending = false;
+}
+
+void traceWriterAdd(struct TraceWriter *writer, uint32_t timeMs, int dx,
+                    int dy) {
+  /* a record covers the moves made within TRACE_MIN_RECORD_MS of the first
+   * one, and is timestamped with the time of that first move. it's only
+   * written once a move comes which doesn't belong to it anymore, so that a
+   * single move followed by a long pause still gets a record of its own. */
+  if (writer->pending && timeMs - writer->pendingMs >= TRACE_MIN_RECORD_MS) {
+    writePending(writer);
+  }
+  if (!writer->pending) {
+    writer->pending = true;
+    writer->pendingMs = timeMs;
+    writer->pendingDx = writer->pendingDy = 0;
+  }
+  writer->pendingDx += dx;
+  writer->pendingDy += dy;
+}
+
+void traceWriterFinish(struct TraceWriter *writer) {
+  if (writer->pending) {
+    writePending(writer);
+  }
+  if (writer->len) {
+    writer->flush(writer->ctx, writer->buf, writer->len);
+    writer->len = 0;
+  }
+}
+
+bool traceReaderInit(struct TraceReader *reader, const void *data,
+                     size_t size) {
+  const unsigned char *bytes = data;
+  if (size < TRACE_HEADER_SIZE || memcmp(bytes, TRACE_MAGIC, 4) != 0 ||
+      bytes[4] != TRACE_VERSION) {
+    return false;
+  }
+  const unsigned char *start = bytes + TRACE_HEADER_SIZE;
+  const unsigned char *end = bytes + size;
+  const unsigned char *pos = start;
+  const unsigned char *lastComplete = start;
+  struct TraceRecord rec;
+  while (pos != end && decodeRecord(&pos, end, &rec)) {
+    lastComplete = pos;
+  }
+  if (lastComplete == start) {
+    return false;
+  }
+  reader->start = reader->pos = start;
+  reader->end = lastComplete;
+  return true;
+}
+
+int traceNextSegment(struct TraceReader *reader, uint32_t windowMs,
+                     struct MotionStep *steps, int maxSteps) {
+  int count = 0;
+  uint32_t elapsedMs = 0;
+  while (count < maxSteps) {
+    if (reader->pos == reader->end) {
+      reader->pos = reader->start;
+    }
+    const unsigned char *pos = reader->pos;
+    struct TraceRecord rec;
+    decodeChecked(&pos, &rec);
+    if (count > 0) {
+      elapsedMs += rec.dtMs;
+      if (elapsedMs >= windowMs) {
+        break;
+      }
+    }
+    reader->pos = pos;
+    steps[count].dx = rec.dx;
+    steps[count].dy = rec.dy;
+    ++count;
+  }
+  return count;
+}
@@ -0,0 +1,98 @@
+#ifndef LAFLOR_TRACE_H
+#define LAFLOR_TRACE_H
+
+#include "motion.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* a trace is a recording of real mouse movement, which La Flor can replay
+ * instead of bouncing the cursor around. the file starts with an 8-byte
+ * header :
+ *
+ *   magic (4 bytes, "LFTR"), version (1 byte), 3 reserved bytes
+ *
+ * followed by the records, back to back, each of which is three variable
+ * length integers (7 bits per byte, least significant group first, the high
+ * bit set on every byte but the last) :
+ *
+ *   the milliseconds since the previous record, the x delta, the y delta
+ *
+ * with the deltas zigzag-encoded, so that small negative values stay small.
+ * a typical record takes 3 or 4 bytes, and moves happening less than
+ * TRACE_MIN_RECORD_MS apart are merged into a single record : an hour of
+ * continuous movement takes up about 1.5MB, and time spent without moving the
+ * mouse doesn't take up anything. */
+#define TRACE_MAGIC "LFTR"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 8
+#define TRACE_MAX_RECORD_SIZE 15
+#define TRACE_MIN_RECORD_MS 8
+
+struct TraceRecord {
+  uint32_t dtMs;
+  int dx;
+  int dy;
+};
+
+/* encodes a single record into "out", which must have room for
+ * TRACE_MAX_RECORD_SIZE bytes. returns the number of bytes written. */
+size_t traceEncode(unsigned char *out, const struct TraceRecord *rec);
+
+/* accumulates raw mouse moves into records, and hands the encoded file to
+ * "flush" in chunks, the first of which starts with the header. nothing is
+ * ever allocated. */
+struct TraceWriter {
+  void (*flush)(void *ctx, const void *data, size_t len);
+  void *ctx;
+  unsigned char buf[4096];
+  size_t len;
+  /* the time of the last record written, if there's one. */
+  bool started;
+  uint32_t lastMs;
+  /* the moves merged into the record that's not written yet. */
+  bool pending;
+  uint32_t pendingMs;
+  int pendingDx;
+  int pendingDy;
+};
+
+void traceWriterInit(struct TraceWriter *writer,
+                     void (*flush)(void *ctx, const void *data, size_t len),
+                     void *ctx);
+
+/* adds a move by (dx, dy) which happened at "timeMs", on a 32-bit wrapping
+ * millisecond counter such as GetTickCount(). */
+void traceWriterAdd(struct TraceWriter *writer, uint32_t timeMs, int dx,
+                    int dy);
+
+/* writes the last record, if any, and flushes everything. */
+void traceWriterFinish(struct TraceWriter *writer);
+
+/* reads the records of a trace straight from memory, typically a file mapping,
+ * over and over again. */
+struct TraceReader {
+  const unsigned char *start;
+  const unsigned char *end;
+  const unsigned char *pos;
+};
+
+/* checks the header and every record, once. returns false if the data isn't a
+ * trace, or doesn't contain any records. a truncated last record, as left
+ * behind by a recording that was interrupted, is just ignored. since all the
+ * records have been checked by this, the functions below never need to check
+ * anything again. */
+bool traceReaderInit(struct TraceReader *reader, const void *data,
+                     size_t size);
+
+/* fills "steps" with the moves of the next segment of the trace : the next
+ * record, whatever the time elapsed before it, followed by the records which
+ * come less than "windowMs" after it, up to "maxSteps" records in total. the
+ * pauses between segments are skipped. once the end of the trace is reached,
+ * it starts over from the beginning. returns the number of steps written,
+ * which is never 0. */
+int traceNextSegment(struct TraceReader *reader, uint32_t windowMs,
+                     struct MotionStep *steps, int maxSteps);
+
+#endif
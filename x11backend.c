@@ -0,0 +1,187 @@
+#include "x11backend.h"
+
+#include <X11/extensions/XTest.h>
+#include <X11/extensions/Xrandr.h>
+
+#include <stdio.h>
+#include <string.h>
+
+/* the buttons which the wheel is made of : turning it away from the user is
+ * button 4, and towards the user button 5. */
+#define WHEEL_UP_BUTTON 4
+#define WHEEL_DOWN_BUTTON 5
+
+static void queued(struct X11Backend *x11) {
+  ++x11->events;
+  if (x11->syncEachEvent) {
+    XSync(x11->display, False);
+    ++x11->roundTrips;
+  }
+}
+
+static void x11GetCursorPos(void *ctx, int *x, int *y) {
+  struct X11Backend *x11 = ctx;
+  if (!x11->cursorKnown) {
+    Window root, child;
+    int winX, winY;
+    unsigned int mask;
+    XQueryPointer(x11->display, x11->root, &root, &child, &x11->cursorX,
+                  &x11->cursorY, &winX, &winY, &mask);
+    ++x11->roundTrips;
+    x11->cursorKnown = true;
+  }
+  *x = x11->cursorX;
+  *y = x11->cursorY;
+}
+
+static void x11SendMove(void *ctx, int dx, int dy) {
+  struct X11Backend *x11 = ctx;
+  XTestFakeRelativeMotionEvent(x11->display, dx, dy, CurrentTime);
+  x11->cursorX += dx;
+  x11->cursorY += dy;
+  queued(x11);
+}
+
+static void x11SendPath(void *ctx, const struct MotionStep *steps, int count) {
+  for (int i = 0; i < count; ++i) {
+    x11SendMove(ctx, steps[i].dx, steps[i].dy);
+  }
+}
+
+static void x11SendMoveTo(void *ctx, int x, int y) {
+  /* -1 stands for the screen that the cursor is on. */
+  struct X11Backend *x11 = ctx;
+  XTestFakeMotionEvent(x11->display, -1, x, y, CurrentTime);
+  x11->cursorX = x;
+  x11->cursorY = y;
+  queued(x11);
+}
+
+static void x11SendPathTo(void *ctx, int fromX, int fromY,
+                          const struct MotionStep *steps, int count) {
+  int x = fromX;
+  int y = fromY;
+  for (int i = 0; i < count; ++i) {
+    x += steps[i].dx;
+    y += steps[i].dy;
+    x11SendMoveTo(ctx, x, y);
+  }
+}
+
+static void x11SendWheel(void *ctx, int notches) {
+  struct X11Backend *x11 = ctx;
+  const unsigned int button = notches > 0 ? WHEEL_UP_BUTTON : WHEEL_DOWN_BUTTON;
+  for (int i = notches > 0 ? notches : -notches; i > 0; --i) {
+    XTestFakeButtonEvent(x11->display, button, True, CurrentTime);
+    XTestFakeButtonEvent(x11->display, button, False, CurrentTime);
+    queued(x11);
+  }
+}
+
+#ifdef LAFLOR_HAVE_IO_ERROR_EXIT_HANDLER
+static void onConnectionLost(Display *display, void *ctx) {
+  struct X11Backend *x11 = ctx;
+  x11->lost = true;
+}
+#endif
+
+bool x11Open(struct X11Backend *x11, const char *name) {
+  memset(x11, 0, sizeof(*x11));
+  x11->display = XOpenDisplay(name);
+  if (x11->display == 0) {
+    fprintf(stderr, "couldn't open display %s\n", XDisplayName(name));
+    return false;
+  }
+  int eventBase, errorBase, major, minor;
+  if (!XTestQueryExtension(x11->display, &eventBase, &errorBase, &major,
+                           &minor)) {
+    fprintf(stderr, "the display doesn't support XTest\n");
+    XCloseDisplay(x11->display);
+    x11->display = 0;
+    return false;
+  }
+  x11->root = DefaultRootWindow(x11->display);
+#ifdef LAFLOR_HAVE_IO_ERROR_EXIT_HANDLER
+  XSetIOErrorExitHandler(x11->display, onConnectionLost, x11);
+#endif
+  /* the server tells us about any change of the monitors from then on, so
+   * that they never have to be polled. */
+  if (XRRQueryExtension(x11->display, &x11->randrEventBase, &errorBase)) {
+    XRRSelectInput(x11->display, x11->root, RRScreenChangeNotifyMask);
+  } else {
+    x11->randrEventBase = -1;
+  }
+  return true;
+}
+
+void x11Close(struct X11Backend *x11) {
+  if (x11->display) {
+    XCloseDisplay(x11->display);
+    x11->display = 0;
+  }
+}
+
+void x11InitMotionBackend(struct MotionBackend *backend,
+                          struct X11Backend *x11) {
+  memset(backend, 0, sizeof(*backend));
+  backend->ctx = x11;
+  backend->getCursorPos = x11GetCursorPos;
+  backend->sendMove = x11SendMove;
+  backend->sendPath = x11SendPath;
+  backend->sendMoveTo = x11SendMoveTo;
+  backend->sendPathTo = x11SendPathTo;
+  backend->sendWheel = x11SendWheel;
+}
+
+void x11QueryLayout(struct X11Backend *x11, struct ScreenLayout *layout) {
+  /* RandR 1.5 describes every monitor with a single request. otherwise, or if
+   * there are no monitors at all, e.g. with everything switched off, the
+   * cursor bounces around the whole screen. */
+  layoutInit(layout);
+  int major = 0, minor = 0;
+  if (x11->randrEventBase >= 0 &&
+      XRRQueryVersion(x11->display, &major, &minor) &&
+      (major > 1 || (major == 1 && minor >= 5))) {
+    int count = 0;
+    XRRMonitorInfo *monitors =
+        XRRGetMonitors(x11->display, x11->root, True, &count);
+    for (int i = 0; i < count; ++i) {
+      layoutAddMonitor(layout, monitors[i].x, monitors[i].y,
+                       monitors[i].x + monitors[i].width,
+                       monitors[i].y + monitors[i].height);
+    }
+    if (monitors) {
+      XRRFreeMonitors(monitors);
+    }
+    x11->roundTrips += 2;
+  }
+  if (layout->count == 0) {
+    const int screen = DefaultScreen(x11->display);
+    layoutAddMonitor(layout, 0, 0, DisplayWidth(x11->display, screen),
+                     DisplayHeight(x11->display, screen));
+  }
+}
+
+bool x11ProcessEvents(struct X11Backend *x11) {
+  bool changed = false;
+  while (!x11->lost && XPending(x11->display)) {
+    XEvent event;
+    XNextEvent(x11->display, &event);
+    if (x11->randrEventBase >= 0 &&
+        event.type == x11->randrEventBase + RRScreenChangeNotify) {
+      /* this keeps the screen size known to Xlib up to date. */
+      XRRUpdateConfiguration(&event);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+void x11BeginTick(struct X11Backend *x11) {
+  x11->cursorKnown = false;
+}
+
+void x11EndTick(struct X11Backend *x11) {
+  XFlush(x11->display);
+  ++x11->flushes;
+}
@@ -0,0 +1,70 @@
+#ifndef LAFLOR_X11BACKEND_H
+#define LAFLOR_X11BACKEND_H
+
+#include "layout.h"
+#include "motion.h"
+
+#include <X11/Xlib.h>
+
+#include <stdbool.h>
+
+/* the X11 counterpart of the Windows application's injector : input is
+ * injected with the XTest extension, the cursor position comes from
+ * XQueryPointer() and the monitors from RandR. see LaFlorX11.c.
+ *
+ * Xlib queues requests in its output buffer until it's flushed, so injecting
+ * doesn't cost any round trips to the server by itself : every event of a
+ * tick is queued, and the whole tick goes out with a single flush in
+ * x11EndTick(). the only round trips left are the cursor position queries,
+ * which the motion engine only makes once per tick at most, and none at all
+ * in absolute mode between reconciliations, and the monitor queries, which
+ * are only made again when RandR says that something changed. */
+struct X11Backend {
+  Display *display;
+  Window root;
+  /* set once the connection to the server is lost, after which Xlib doesn't
+   * talk to the server anymore. without XSetIOErrorExitHandler(), which
+   * appeared in libX11 1.7, Xlib exits the process instead. */
+  bool lost;
+  int randrEventBase;
+  /* the cursor position, once queried during the current tick, kept up to
+   * date with the moves queued since then. */
+  bool cursorKnown;
+  int cursorX;
+  int cursorY;
+  /* when set, the server is waited for after every single event, the way
+   * XTest is often used. this is only meant for benchmarking the
+   * difference. */
+  bool syncEachEvent;
+  /* what the backend has cost so far. every request which waits for the
+   * server's answer is a round trip. */
+  unsigned long long events;
+  unsigned long long roundTrips;
+  unsigned long long flushes;
+};
+
+/* connects to the given display, or to $DISPLAY if "name" is 0. returns false,
+ * after printing why, if the display can't be opened or lacks the XTest
+ * extension. RandR is optional : without it, the whole screen is a single
+ * monitor. */
+bool x11Open(struct X11Backend *x11, const char *name);
+
+void x11Close(struct X11Backend *x11);
+
+void x11InitMotionBackend(struct MotionBackend *backend,
+                          struct X11Backend *x11);
+
+/* queries the monitors making up the screen. */
+void x11QueryLayout(struct X11Backend *x11, struct ScreenLayout *layout);
+
+/* handles whatever events the server has sent, without waiting for any.
+ * returns true if the monitors changed, in which case the layout should be
+ * queried again. */
+bool x11ProcessEvents(struct X11Backend *x11);
+
+/* a tick starts without knowing where the cursor is, as the user might have
+ * moved it in the meantime, and ends by sending everything that it queued. */
+void x11BeginTick(struct X11Backend *x11);
+void x11EndTick(struct X11Backend *x11);
+
+#endif